@@ -6,7 +6,11 @@ add_requires("spdlog")
 
 target("Example")
     set_kind("binary")
-    set_languages("c++17")
+    if has_config("coroutine") then
+        set_languages("c++20")
+    else
+        set_languages("c++17")
+    end
     add_files("main.cpp")
     add_rules("mode.debug", "mode.release")
     add_deps("KSMediaCodec")
@@ -0,0 +1,392 @@
+#ifndef KSMediaCodec_AsyncExecutor_hpp
+#define KSMediaCodec_AsyncExecutor_hpp
+
+#if defined(KSMediaCodec_ENABLE_COROUTINE) && defined(__cpp_impl_coroutine)
+
+#include <coroutine>
+#include <exception>
+#include <future>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <Foundation/Foundation.hpp>
+#include "defs.hpp"
+#include "ThreadPool.hpp"
+
+namespace ks
+{
+	/**
+	 * Lazily started coroutine returning T. Awaiting it starts it and resumes the awaiter on whichever
+	 * thread it completes on. Use runAsync to start a task from non-coroutine code.
+	 */
+	template<typename T>
+	class AsyncTask;
+
+	namespace AsyncTaskPromise
+	{
+		template<typename T>
+		struct Base
+		{
+			struct FinalAwaiter
+			{
+				bool await_ready() const noexcept
+				{
+					return false;
+				}
+
+				template<typename Promise>
+				std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept
+				{
+					std::coroutine_handle<> continuation = handle.promise().continuation;
+					return continuation ? continuation : std::noop_coroutine();
+				}
+
+				void await_resume() const noexcept
+				{
+				}
+			};
+
+			std::coroutine_handle<> continuation;
+			std::exception_ptr exception;
+
+			std::suspend_always initial_suspend() const noexcept
+			{
+				return {};
+			}
+
+			FinalAwaiter final_suspend() const noexcept
+			{
+				return {};
+			}
+
+			/**
+			 * Kept for the awaiter, which rethrows it from await_resume.
+			 */
+			void unhandled_exception() noexcept
+			{
+				exception = std::current_exception();
+			}
+
+			void rethrowIfFailed() const
+			{
+				if (exception)
+				{
+					std::rethrow_exception(exception);
+				}
+			}
+		};
+	}
+
+	template<typename T>
+	class AsyncTask
+	{
+	public:
+		struct promise_type : public AsyncTaskPromise::Base<T>
+		{
+			std::optional<T> value;
+
+			AsyncTask get_return_object() noexcept
+			{
+				return AsyncTask(std::coroutine_handle<promise_type>::from_promise(*this));
+			}
+
+			template<typename Value>
+			void return_value(Value&& returnValue)
+			{
+				value.emplace(std::forward<Value>(returnValue));
+			}
+		};
+
+	public:
+		AsyncTask(AsyncTask&& other) noexcept
+			: handle(std::exchange(other.handle, nullptr))
+		{
+		}
+
+		AsyncTask& operator=(AsyncTask&& other) noexcept
+		{
+			if (this != &other)
+			{
+				if (handle)
+				{
+					handle.destroy();
+				}
+				handle = std::exchange(other.handle, nullptr);
+			}
+			return *this;
+		}
+
+		AsyncTask(const AsyncTask&) = delete;
+		AsyncTask& operator=(const AsyncTask&) = delete;
+
+		~AsyncTask()
+		{
+			if (handle)
+			{
+				handle.destroy();
+			}
+		}
+
+		bool await_ready() const noexcept
+		{
+			return false;
+		}
+
+		std::coroutine_handle<> await_suspend(std::coroutine_handle<> continuation) noexcept
+		{
+			handle.promise().continuation = continuation;
+			return handle;
+		}
+
+		T await_resume()
+		{
+			handle.promise().rethrowIfFailed();
+			return std::move(*handle.promise().value);
+		}
+
+	private:
+		explicit AsyncTask(std::coroutine_handle<promise_type> handle)
+			: handle(handle)
+		{
+		}
+
+		std::coroutine_handle<promise_type> handle;
+	};
+
+	template<>
+	class AsyncTask<void>
+	{
+	public:
+		struct promise_type : public AsyncTaskPromise::Base<void>
+		{
+			AsyncTask get_return_object() noexcept
+			{
+				return AsyncTask(std::coroutine_handle<promise_type>::from_promise(*this));
+			}
+
+			void return_void() const noexcept
+			{
+			}
+		};
+
+	public:
+		AsyncTask(AsyncTask&& other) noexcept
+			: handle(std::exchange(other.handle, nullptr))
+		{
+		}
+
+		AsyncTask& operator=(AsyncTask&& other) noexcept
+		{
+			if (this != &other)
+			{
+				if (handle)
+				{
+					handle.destroy();
+				}
+				handle = std::exchange(other.handle, nullptr);
+			}
+			return *this;
+		}
+
+		AsyncTask(const AsyncTask&) = delete;
+		AsyncTask& operator=(const AsyncTask&) = delete;
+
+		~AsyncTask()
+		{
+			if (handle)
+			{
+				handle.destroy();
+			}
+		}
+
+		bool await_ready() const noexcept
+		{
+			return false;
+		}
+
+		std::coroutine_handle<> await_suspend(std::coroutine_handle<> continuation) noexcept
+		{
+			handle.promise().continuation = continuation;
+			return handle;
+		}
+
+		void await_resume() const
+		{
+			handle.promise().rethrowIfFailed();
+		}
+
+	private:
+		explicit AsyncTask(std::coroutine_handle<promise_type> handle)
+			: handle(handle)
+		{
+		}
+
+		std::coroutine_handle<promise_type> handle;
+	};
+
+	/**
+	 * Suspends the awaiting coroutine while function runs on threadPool, then resumes it on that thread
+	 * with function's result, or rethrows what function threw. No thread is held while the function is queued.
+	 */
+	template<typename Function>
+	class ThreadPoolAwaitable
+	{
+	public:
+		using Result = std::invoke_result_t<Function>;
+
+		ThreadPoolAwaitable(ThreadPool& threadPool, Function function)
+			: threadPool(threadPool), function(std::move(function))
+		{
+		}
+
+		bool await_ready() const noexcept
+		{
+			return false;
+		}
+
+		void await_suspend(std::coroutine_handle<> handle)
+		{
+			threadPool.submit([this, handle]()
+			{
+				try
+				{
+					if constexpr (std::is_void_v<Result>)
+					{
+						function();
+					}
+					else
+					{
+						result.emplace(function());
+					}
+				}
+				catch (...)
+				{
+					exception = std::current_exception();
+				}
+				handle.resume();
+			});
+		}
+
+		Result await_resume()
+		{
+			if (exception)
+			{
+				std::rethrow_exception(exception);
+			}
+			if constexpr (std::is_void_v<Result> == false)
+			{
+				return std::move(*result);
+			}
+		}
+
+	private:
+		ThreadPool& threadPool;
+		Function function;
+		std::conditional_t<std::is_void_v<Result>, bool, std::optional<Result>> result{};
+		std::exception_ptr exception;
+	};
+
+	/**
+	 * Two small thread pools shared by any number of coroutine jobs: one for opening files and muxing,
+	 * one for decoding, conversion and encoding. Jobs only occupy a thread while an operation runs.
+	 */
+	class KSMediaCodec_API AsyncExecutor : public noncopyable
+	{
+	public:
+		/**
+		 * 0 compute threads uses one per hardware thread.
+		 */
+		explicit AsyncExecutor(const unsigned int ioThreadCount = 2, const unsigned int computeThreadCount = 0);
+		~AsyncExecutor();
+
+		template<typename Function>
+		ThreadPoolAwaitable<std::decay_t<Function>> runIO(Function&& function)
+		{
+			return ThreadPoolAwaitable<std::decay_t<Function>>(ioPool, std::forward<Function>(function));
+		}
+
+		template<typename Function>
+		ThreadPoolAwaitable<std::decay_t<Function>> runCompute(Function&& function)
+		{
+			return ThreadPoolAwaitable<std::decay_t<Function>>(computePool, std::forward<Function>(function));
+		}
+
+		unsigned int ioThreadCount() const;
+		unsigned int computeThreadCount() const;
+
+	private:
+		ThreadPool ioPool;
+		ThreadPool computePool;
+	};
+
+	namespace AsyncTaskPromise
+	{
+		struct Detached
+		{
+			struct promise_type
+			{
+				Detached get_return_object() const noexcept
+				{
+					return {};
+				}
+
+				std::suspend_never initial_suspend() const noexcept
+				{
+					return {};
+				}
+
+				std::suspend_never final_suspend() const noexcept
+				{
+					return {};
+				}
+
+				void return_void() const noexcept
+				{
+				}
+
+				void unhandled_exception() const noexcept
+				{
+					std::terminate();
+				}
+			};
+		};
+
+		template<typename T>
+		Detached runDetached(AsyncTask<T> task, std::promise<T> promise)
+		{
+			try
+			{
+				if constexpr (std::is_void_v<T>)
+				{
+					co_await task;
+					promise.set_value();
+				}
+				else
+				{
+					promise.set_value(co_await task);
+				}
+			}
+			catch (...)
+			{
+				promise.set_exception(std::current_exception());
+			}
+		}
+	}
+
+	/**
+	 * Starts task on the calling thread and returns a future for its result, or for the exception it threw.
+	 * The task keeps itself alive until it completes, so the future may be dropped.
+	 */
+	template<typename T>
+	std::future<T> runAsync(AsyncTask<T> task)
+	{
+		std::promise<T> promise;
+		std::future<T> future = promise.get_future();
+		AsyncTaskPromise::runDetached(std::move(task), std::move(promise));
+		return future;
+	}
+}
+
+#endif // KSMediaCodec_ENABLE_COROUTINE
+
+#endif // KSMediaCodec_AsyncExecutor_hpp
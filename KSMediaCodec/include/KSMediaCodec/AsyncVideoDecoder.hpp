@@ -0,0 +1,58 @@
+#ifndef KSMediaCodec_AsyncVideoDecoder_hpp
+#define KSMediaCodec_AsyncVideoDecoder_hpp
+
+#if defined(KSMediaCodec_ENABLE_COROUTINE) && defined(__cpp_impl_coroutine)
+
+#include <string>
+#include <memory>
+#include <Foundation/Foundation.hpp>
+#include "defs.hpp"
+#include "AsyncExecutor.hpp"
+#include "VideoDecoder.hpp"
+
+namespace ks
+{
+	/**
+	 * Coroutine front end for VideoDecoder. Every operation runs on the executor and resumes the caller
+	 * on the executor's thread. Operations on one decoder must be awaited one at a time.
+	 */
+	class KSMediaCodec_API AsyncVideoDecoder : public noncopyable
+	{
+	public:
+		struct Frame
+		{
+			std::unique_ptr<ks::PixelBuffer> pixelBuffer;
+			MediaTime pts = MediaTime::zero;
+		};
+
+	public:
+		/**
+		 * Opens filePath on the executor's I/O threads, nullptr if VideoDecoder::New fails.
+		 */
+		static AsyncTask<std::unique_ptr<AsyncVideoDecoder>> open(AsyncExecutor& executor,
+			std::string filePath,
+			ks::PixelBuffer::FormatType formatType,
+			DecoderOpenOptions options = DecoderOpenOptions());
+
+		~AsyncVideoDecoder();
+
+		/**
+		 * pixelBuffer is nullptr at the end of the stream.
+		 */
+		AsyncTask<Frame> nextFrame();
+		AsyncTask<Frame> frameAt(MediaTime time);
+		AsyncTask<bool> seek(MediaTime time);
+
+		VideoDecoder& getDecoder();
+
+	private:
+		AsyncVideoDecoder(AsyncExecutor& executor, std::unique_ptr<VideoDecoder> decoder);
+
+		AsyncExecutor& executor;
+		std::unique_ptr<VideoDecoder> decoder;
+	};
+}
+
+#endif // KSMediaCodec_ENABLE_COROUTINE
+
+#endif // KSMediaCodec_AsyncVideoDecoder_hpp
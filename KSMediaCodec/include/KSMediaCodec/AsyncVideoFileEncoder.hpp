@@ -0,0 +1,49 @@
+#ifndef KSMediaCodec_AsyncVideoFileEncoder_hpp
+#define KSMediaCodec_AsyncVideoFileEncoder_hpp
+
+#if defined(KSMediaCodec_ENABLE_COROUTINE) && defined(__cpp_impl_coroutine)
+
+#include <string>
+#include <memory>
+#include <Foundation/Foundation.hpp>
+#include "defs.hpp"
+#include "AsyncExecutor.hpp"
+#include "VideoFileEncoder.hpp"
+
+namespace ks
+{
+	/**
+	 * Coroutine front end for VideoFileEncoder. Operations on one encoder must be awaited one at a time;
+	 * buffers are shared so they stay alive while the executor encodes them.
+	 */
+	class KSMediaCodec_API AsyncVideoFileEncoder : public noncopyable
+	{
+	public:
+		/**
+		 * Opens outputPath on the executor's I/O threads, nullptr if VideoFileEncoder::New fails.
+		 */
+		static AsyncTask<std::unique_ptr<AsyncVideoFileEncoder>> open(AsyncExecutor& executor,
+			std::string outputPath,
+			VideoFileEncoder::VideoEncodeAttribute videoEncodeAttribute,
+			VideoFileEncoder::AudioEncodeAttribute audioEncodeAttribute,
+			ks::AudioFormat outputAudioFormat);
+
+		~AsyncVideoFileEncoder();
+
+		AsyncTask<void> encode(std::shared_ptr<const ks::PixelBuffer> pixelBuffer, ks::MediaTime pts);
+		AsyncTask<void> encode(std::shared_ptr<const ks::AudioPCMBuffer> pcmBuffer, ks::MediaTime pts);
+		AsyncTask<void> encodeTail();
+
+		VideoFileEncoder& getEncoder();
+
+	private:
+		AsyncVideoFileEncoder(AsyncExecutor& executor, std::unique_ptr<VideoFileEncoder> encoder);
+
+		AsyncExecutor& executor;
+		std::unique_ptr<VideoFileEncoder> encoder;
+	};
+}
+
+#endif // KSMediaCodec_ENABLE_COROUTINE
+
+#endif // KSMediaCodec_AsyncVideoFileEncoder_hpp
@@ -8,13 +8,14 @@
 #include "FFmpeg.h"
 #include <Foundation/Foundation.hpp>
 #include "MediaTimeMapping.hpp"
+#include "DecoderOpenOptions.hpp"
 
 namespace ks
 {
 	class KSMediaCodec_API AudioDecoder : public noncopyable
 	{
 	public:
-		static AudioDecoder* New(const std::string& filePath, const ks::AudioFormat& format);
+		static AudioDecoder* New(const std::string& filePath, const ks::AudioFormat& format, const DecoderOpenOptions& options = DecoderOpenOptions());
 
 		~AudioDecoder();
 
@@ -24,10 +25,25 @@ namespace ks
 
 		int seek(MediaTime time);
 
+		/**
+		 * Fills outBuffer with the samples of timeRange, trimmed to its first sample, up to the buffer's length.
+		 * Consecutive ranges continue decoding without seeking; otherwise the decoder seeks with preroll.
+		 * The resampler is drained at the end of the stream. Returns the samples written per channel,
+		 * fewer than requested only at the end of the stream, or a negative AVERROR.
+		 */
+		int readSamples(const MediaTimeRange& timeRange, ks::AudioPCMBuffer& outBuffer);
+
 		MediaTime lastDecodedAudioChunkDisplayTime() const;
 
 		MediaTime fps() const;
 
+		MediaTime openDuration() const;
+
+		/**
+		 * Wall-clock time from the start of New until the first chunk was decoded, negative until then.
+		 */
+		MediaTime timeToFirstFrame() const;
+
 	private:
 		ks::AudioFormat outputAudioFormat;
 
@@ -41,10 +57,27 @@ namespace ks
 		AVCodecContext *audioCodecCtx = nullptr;
 		AVCodec *codec = nullptr;
 		int audioStreamIndex = -1;
+		int64_t openStartTime = 0;
+		int64_t openEndTime = 0;
+		int64_t firstFrameTime = AV_NOPTS_VALUE;
+
+		AVAudioFifo *sampleFifo = nullptr;
+		int64_t sampleFifoStartSample = AV_NOPTS_VALUE;
+		bool isSampleFifoValid = false;
+		bool isSampleDecoderDraining = false;
+		bool isSampleStreamFinished = false;
+		std::vector<uint8_t*> convertedSamples;
+		int convertedSamplesCapacity = 0;
 
 	private:
 		ks::AudioPCMBuffer* newDecodedPCMBuffer(AVCodecContext* audioCodecCtx, AVFrame* frame, const AVPacket* packet, MediaTimeRange& outTimeRange);
 
+		int seekSamples(const int64_t sampleIndex);
+		int decodeSamples();
+		bool canConvertDirectly(const AVFrame* frame) const;
+		void appendConvertedSamples(const AVFrame* frame);
+		void discardSamplesBefore(const int64_t sampleIndex);
+
 	public:
 		static AVSampleFormat getAVSampleFormat(const ks::AudioFormat& format) noexcept;
 	};
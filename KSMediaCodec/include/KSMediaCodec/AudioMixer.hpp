@@ -0,0 +1,85 @@
+#ifndef KSMediaCodec_AudioMixer_hpp
+#define KSMediaCodec_AudioMixer_hpp
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <Foundation/Foundation.hpp>
+#include "defs.hpp"
+#include "FFmpeg.h"
+#include "MediaTimeMapping.hpp"
+#include "AudioDecoder.hpp"
+#include "ThreadPool.hpp"
+
+namespace ks
+{
+	/**
+	 * Mixes the audio of several files into one track. Each source plays at normal speed from its
+	 * source start over its target range, scaled by its gain and linear fade in and fade out ramps.
+	 * Sources are decoded in parallel and summed in 32-bit float.
+	 */
+	class KSMediaCodec_API AudioMixer : public noncopyable
+	{
+	public:
+		struct Source
+		{
+			std::string filePath;
+			MediaTimeMapping timeMapping;
+			float gain = 1.0f;
+			MediaTime fadeInDuration = MediaTime::zero;
+			MediaTime fadeOutDuration = MediaTime::zero;
+		};
+
+	public:
+		/**
+		 * audioFormat must be 32-bit float, planar or interleaved. 0 threads uses one per hardware thread,
+		 * 1 decodes every source on the calling thread.
+		 */
+		static AudioMixer* New(const std::vector<Source>& sources, const ks::AudioFormat& audioFormat, const unsigned int threadCount = 0);
+		~AudioMixer();
+
+		/**
+		 * Mixes timeRange into outBuffer, which must use the mixer's format, up to the buffer's length.
+		 * Samples no source covers are silent. Returns the samples written per channel.
+		 */
+		int mix(const MediaTimeRange& timeRange, ks::AudioPCMBuffer& outBuffer);
+
+		/**
+		 * Takes effect from the next mix call.
+		 */
+		void setGain(const size_t sourceIndex, const float gain);
+
+		size_t sourceCount() const;
+		const ks::AudioFormat& getAudioFormat() const;
+
+	private:
+		struct SourceState
+		{
+			Source source;
+			std::unique_ptr<AudioDecoder> decoder;
+			std::unique_ptr<ks::AudioPCMBuffer> samples;
+			int64_t targetStartSample = 0;
+			int64_t targetEndSample = 0;
+			int64_t sourceStartSample = 0;
+			int64_t fadeInSamples = 0;
+			int64_t fadeOutSamples = 0;
+			int64_t readStartSample = 0;
+			int readSampleCount = 0;
+		};
+
+		ks::AudioFormat audioFormat;
+		ks::AudioFormat decoderFormat;
+		bool isNonInterleaved = true;
+		std::vector<std::unique_ptr<SourceState>> sources;
+		std::unique_ptr<ThreadPool> threadPool;
+		std::vector<std::vector<float>> mixPlanes;
+
+	private:
+		int64_t sampleOf(const MediaTime& time) const;
+		float envelopeAt(const SourceState& state, const int64_t sample) const;
+		void readSource(SourceState& state, const int64_t startSample, const int sampleCount);
+		void mixSource(const SourceState& state, const int64_t blockStartSample, float* const* outPlanes) const;
+	};
+}
+
+#endif // KSMediaCodec_AudioMixer_hpp
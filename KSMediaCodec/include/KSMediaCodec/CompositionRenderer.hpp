@@ -0,0 +1,115 @@
+#ifndef KSMediaCodec_CompositionRenderer_hpp
+#define KSMediaCodec_CompositionRenderer_hpp
+
+#include <string>
+#include <vector>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <future>
+#include <unordered_map>
+#include <Foundation/Foundation.hpp>
+#include "defs.hpp"
+#include "FFmpeg.h"
+#include "MediaTimeline.hpp"
+#include "VideoDecoder.hpp"
+#include "AudioDecoder.hpp"
+#include "VideoFileEncoder.hpp"
+
+namespace ks
+{
+	struct KSMediaCodec_API CompositionClip
+	{
+	public:
+		CompositionClip();
+		CompositionClip(const std::string& filePath, const MediaTimeMapping& timeMapping);
+
+	public:
+		std::string filePath;
+		MediaTimeMapping timeMapping;
+	};
+
+	class KSMediaCodec_API CompositionRenderer : public noncopyable
+	{
+	public:
+		/**
+		 * Decoders stay open for at most maxOpenSources source files, at least two so the next clip can be
+		 * prefetched; the least recently used file is closed first.
+		 */
+		static CompositionRenderer* New(const std::vector<CompositionClip>& clips,
+			const ks::PixelBuffer::FormatType& formatType,
+			const ks::AudioFormat& audioFormat,
+			const size_t maxOpenSources = 4);
+
+		~CompositionRenderer();
+
+		/**
+		 * Encodes the target time range of every clip at fps. Ticks that no clip covers are skipped and
+		 * filled with silence. Audio is read sample-accurately from each clip's source start; clips whose source
+		 * and target durations differ have it resampled to the target duration, which shifts its pitch.
+		 * The caller still owns encodeTail.
+		 */
+		bool render(VideoFileEncoder& encoder, const MediaTime& fps);
+
+		const MediaTimeline& getTimeline() const;
+		size_t openSourceCount();
+
+	private:
+		struct SourceDecoders
+		{
+			std::unique_ptr<VideoDecoder> videoDecoder;
+			std::unique_ptr<AudioDecoder> audioDecoder;
+		};
+
+		std::vector<CompositionClip> clips;
+		MediaTimeline timeline;
+		ks::PixelBuffer::FormatType formatType;
+		ks::AudioFormat audioFormat;
+		AVSampleFormat sampleFormat = AV_SAMPLE_FMT_NONE;
+
+		struct SourceEntry
+		{
+			std::string filePath;
+			std::shared_ptr<SourceDecoders> decoders;
+		};
+
+		/**
+		 * Most recently used first. Evicted decoders stay alive while a clip still holds them.
+		 */
+		std::list<SourceEntry> decoderPool;
+		std::unordered_map<std::string, std::list<SourceEntry>::iterator> decoderPoolIndex;
+		size_t maxOpenSources = 2;
+		std::mutex decoderPoolMutex;
+		std::future<void> prefetchTask;
+
+		AVAudioFifo *outputAudioFifo = nullptr;
+		std::shared_ptr<SourceDecoders> currentAudioSources;
+		int currentAudioClipIndex = -1;
+
+		/**
+		 * Output of speedSwrContext for the current clip, set only while the clip's speed is not 1.
+		 */
+		SwrContext *speedSwrContext = nullptr;
+		AVAudioFifo *clipAudioFifo = nullptr;
+		bool isClipAudioFinished = false;
+		int64_t nextSourceAudioSample = 0;
+		int64_t outputAudioSamples = 0;
+		int64_t encodedAudioSamples = 0;
+
+	private:
+		std::shared_ptr<SourceDecoders> sourceDecoders(const std::string& filePath);
+		void prefetch(const int clipIndex, const int currentClipIndex);
+		void waitPrefetch();
+
+		int64_t audioSampleOf(const MediaTime& time) const;
+		void renderAudio(VideoFileEncoder& encoder, const int64_t targetEndSample);
+		void readClipAudio(const int clipIndex, const MediaTime& targetTime, const int sampleCount);
+		bool resetSpeedResampler(const MediaTimeMapping& timeMapping);
+		int readSpeedChangedAudio(AudioDecoder* audioDecoder, const int sampleCount);
+		void appendSpeedChangedSamples(const uint8_t** samples, const int sampleCount);
+		void writeSilence(AVAudioFifo* fifo, const int sampleCount);
+		void encodeAudio(VideoFileEncoder& encoder, const bool isFlushing);
+	};
+}
+
+#endif // KSMediaCodec_CompositionRenderer_hpp
@@ -0,0 +1,63 @@
+#ifndef KSMediaCodec_DecodedVideoFrame_hpp
+#define KSMediaCodec_DecodedVideoFrame_hpp
+
+#include <Foundation/Foundation.hpp>
+#include "defs.hpp"
+#include "FFmpeg.h"
+#include "MediaTime.hpp"
+
+namespace ks
+{
+	/**
+	 * A reference to the codec's own picture, exposed without conversion or copy.
+	 * Holding it keeps the underlying buffer, e.g. a FramePool buffer, out of reuse.
+	 */
+	class KSMediaCodec_API DecodedVideoFrame : public noncopyable
+	{
+	public:
+		/**
+		 * Takes a new reference to frame's buffers. nullptr if frame does not hold reference-counted buffers.
+		 */
+		static DecodedVideoFrame* New(const AVFrame* frame, const MediaTime& pts);
+		~DecodedVideoFrame();
+
+		int getWidth() const;
+		int getHeight() const;
+		AVPixelFormat getPixelFormat() const;
+		MediaTime getPts() const;
+
+		/**
+		 * Whether the planes already use the layout of formatType, so no conversion is needed to consume them.
+		 */
+		bool hasFormatType(const ks::PixelBuffer::FormatType& formatType) const;
+
+		int planeCount() const;
+		const uint8_t* planeData(const int plane) const;
+		int lineSize(const int plane) const;
+
+		/**
+		 * Size of plane in pixels, e.g. half the frame size for the chroma planes of yuv420p.
+		 */
+		int planeWidth(const int plane) const;
+		int planeHeight(const int plane) const;
+
+		/**
+		 * Whether plane holds one 8-bit component per byte and so can be read or copied as gray8.
+		 */
+		bool isPlaneCopyable(const int plane) const;
+
+		/**
+		 * Copies plane into a gray8 PixelBuffer with one strided pass, keeping every decimation-th pixel
+		 * of every decimation-th row for a decimation of 2 or 4. nullptr if the plane is not copyable.
+		 */
+		ks::PixelBuffer* newPlaneBuffer(const int plane, const int decimation = 1) const;
+
+		const AVFrame* getAVFrame() const;
+
+	private:
+		AVFrame* frame = nullptr;
+		MediaTime pts;
+	};
+}
+
+#endif // KSMediaCodec_DecodedVideoFrame_hpp
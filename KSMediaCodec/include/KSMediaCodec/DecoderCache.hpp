@@ -0,0 +1,76 @@
+#ifndef KSMediaCodec_DecoderCache_hpp
+#define KSMediaCodec_DecoderCache_hpp
+
+#include <string>
+#include <vector>
+#include <list>
+#include <mutex>
+#include <memory>
+#include <unordered_map>
+#include <Foundation/Foundation.hpp>
+#include "defs.hpp"
+#include "VideoDecoder.hpp"
+
+namespace ks
+{
+	/**
+	 * Thread-safe pool of open VideoDecoders keyed by file path and output format.
+	 * Idle decoders are evicted least recently used first once maxOpenDecoders or maxMemoryBytes is exceeded.
+	 * Checked out decoders count towards both limits but are never evicted.
+	 */
+	class KSMediaCodec_API DecoderCache : public noncopyable
+	{
+	public:
+		struct Statistics
+		{
+			unsigned long long hits = 0;
+			unsigned long long misses = 0;
+			unsigned long long evictions = 0;
+			size_t idleDecoders = 0;
+			size_t checkedOutDecoders = 0;
+			long long memoryUsage = 0;
+		};
+
+	public:
+		DecoderCache(const size_t maxOpenDecoders, const long long maxMemoryBytes);
+		~DecoderCache();
+
+		/**
+		 * Returns an idle decoder for filePath or opens a new one, nullptr if the file cannot be opened.
+		 * The decoder keeps its previous position; seek before reading.
+		 */
+		VideoDecoder* checkout(const std::string& filePath, const ks::PixelBuffer::FormatType& formatType);
+		void checkin(VideoDecoder* decoder);
+
+		void warmUp(const std::vector<std::string>& filePaths, const ks::PixelBuffer::FormatType& formatType);
+		void clear();
+
+		Statistics statistics();
+
+	private:
+		struct Entry
+		{
+			std::string key;
+			std::unique_ptr<VideoDecoder> decoder;
+			long long memoryUsage = 0;
+		};
+
+		std::mutex mutex;
+		size_t maxOpenDecoders;
+		long long maxMemoryBytes;
+
+		std::list<Entry> idleEntries;
+		std::unordered_multimap<std::string, std::list<Entry>::iterator> idleEntriesByKey;
+		std::unordered_map<VideoDecoder*, long long> checkedOutDecoders;
+		long long memoryUsage = 0;
+		Statistics _statistics;
+
+	private:
+		static std::string makeKey(const std::string& filePath, const ks::PixelBuffer::FormatType& formatType);
+		void insertIdle(std::unique_ptr<VideoDecoder> decoder, const long long decoderMemoryUsage);
+		std::unique_ptr<VideoDecoder> evictLeastRecentlyUsed();
+		std::vector<std::unique_ptr<VideoDecoder>> evictOverLimit(const size_t reservedDecoders, const long long reservedMemory);
+	};
+}
+
+#endif // KSMediaCodec_DecoderCache_hpp
@@ -0,0 +1,64 @@
+#ifndef KSMediaCodec_DecoderOpenOptions_hpp
+#define KSMediaCodec_DecoderOpenOptions_hpp
+
+#include <string>
+#include "defs.hpp"
+#include "FFmpeg.h"
+
+namespace ks
+{
+	class FramePool;
+
+	struct KSMediaCodec_API DecoderOpenOptions
+	{
+		enum class StreamInfoProbing
+		{
+			always,
+			whenNeeded,
+			never,
+		};
+
+		/**
+		 * Bytes read while probing, 0 keeps the FFmpeg default.
+		 */
+		long long probeSize = 0;
+
+		/**
+		 * Microseconds of media analyzed while probing, 0 keeps the FFmpeg default.
+		 */
+		long long analyzeDuration = 0;
+
+		/**
+		 * -1 selects the first stream of the decoder's media type.
+		 */
+		int streamIndex = -1;
+
+		/**
+		 * When not empty only streams whose language tag equals it are selected, e.g. "eng".
+		 */
+		std::string language = "";
+
+		/**
+		 * AV_DISPOSITION_* bits the selected stream must have, 0 accepts any stream.
+		 */
+		int disposition = 0;
+
+		/**
+		 * whenNeeded skips avformat_find_stream_info when codecParameters is set or the container
+		 * header already describes the selected stream.
+		 */
+		StreamInfoProbing streamInfoProbing = StreamInfoProbing::always;
+
+		/**
+		 * Copied onto the selected stream before the codec is opened. Not owned.
+		 */
+		const AVCodecParameters* codecParameters = nullptr;
+
+		/**
+		 * Video decoders allocate their pictures from it when set. Not owned; must outlive the decoder.
+		 */
+		FramePool* framePool = nullptr;
+	};
+}
+
+#endif // KSMediaCodec_DecoderOpenOptions_hpp
@@ -0,0 +1,67 @@
+#ifndef KSMediaCodec_FramePool_hpp
+#define KSMediaCodec_FramePool_hpp
+
+#include <memory>
+#include <Foundation/Foundation.hpp>
+#include "defs.hpp"
+#include "FFmpeg.h"
+
+namespace ks
+{
+	/**
+	 * Recycles 64-byte aligned picture buffers handed to a codec through AVCodecContext::get_buffer2.
+	 * Released buffers return to the pool by size; frames still referencing the pool keep it alive.
+	 * With useHugePages, large buffers are backed by transparent huge pages where the platform supports it.
+	 */
+	class KSMediaCodec_API FramePool : public noncopyable
+	{
+	public:
+		struct Statistics
+		{
+			long long allocatedBytes = 0;
+			long long inUseBytes = 0;
+			size_t idleBuffers = 0;
+			size_t buffersInUse = 0;
+			unsigned long long allocations = 0;
+			unsigned long long reuses = 0;
+		};
+
+		static const int alignment = 64;
+
+	public:
+		/**
+		 * maxIdleBytes 0 keeps every released buffer for reuse.
+		 */
+		explicit FramePool(const long long maxIdleBytes = 0, const bool useHugePages = false);
+		~FramePool();
+
+		/**
+		 * Installs the pool as the codec's picture allocator. Call before avcodec_open2; the pool must outlive the codec.
+		 * Codecs without AV_CODEC_CAP_DR1 and hardware or paletted formats fall back to the default allocator.
+		 */
+		void attach(AVCodecContext* codecContext);
+
+		/**
+		 * Frees idle buffers.
+		 */
+		void trim();
+
+		Statistics statistics() const;
+
+		/**
+		 * Whether frame's pixels live in a buffer handed out by this pool.
+		 */
+		bool owns(const AVFrame* frame) const;
+
+	private:
+		struct State;
+		struct BufferOwner;
+		std::shared_ptr<State> state;
+
+	private:
+		static int getBuffer(AVCodecContext* codecContext, AVFrame* frame, int flags);
+		static void releaseBuffer(void* opaque, uint8_t* data);
+	};
+}
+
+#endif // KSMediaCodec_FramePool_hpp
@@ -0,0 +1,76 @@
+#ifndef KSMediaCodec_FrameRateConverter_hpp
+#define KSMediaCodec_FrameRateConverter_hpp
+
+#include <memory>
+#include <Foundation/Foundation.hpp>
+#include "defs.hpp"
+#include "MediaTime.hpp"
+#include "VideoDecoder.hpp"
+
+namespace ks
+{
+	/**
+	 * Maps a decoder's frames onto a constant output frame rate. Every output tick shows the source frame
+	 * whose pts is nearest to it. Source frames between ticks are dropped unconverted, and a frame shown
+	 * on several ticks is converted once and shared.
+	 */
+	class KSMediaCodec_API FrameRateConverter : public noncopyable
+	{
+	public:
+		struct Frame
+		{
+			std::shared_ptr<const ks::PixelBuffer> pixelBuffer;
+
+			/**
+			 * Output tick time, startTime + index / fps.
+			 */
+			MediaTime pts = MediaTime::zero;
+			MediaTime sourcePts = MediaTime::zero;
+			bool isDuplicate = false;
+		};
+
+		struct Statistics
+		{
+			unsigned long long outputFrames = 0;
+			unsigned long long convertedFrames = 0;
+			unsigned long long duplicateFrames = 0;
+			unsigned long long elidedFrames = 0;
+		};
+
+	public:
+		/**
+		 * decoder is not owned and should not be used by anyone else until conversion ends. fps is frames per
+		 * second as a rational, e.g. MediaTime(30000, 1001). With isDuplicateElided, nextFrame skips repeated
+		 * frames so the encoder extends the previous frame's duration by timestamp instead of encoding it
+		 * again. The final tick is still returned so the output keeps its duration.
+		 */
+		static FrameRateConverter* New(VideoDecoder* decoder,
+			const MediaTime& fps,
+			const MediaTime& startTime,
+			const bool isDuplicateElided);
+
+		/**
+		 * False once the output passes the last source frame by one source frame duration.
+		 */
+		bool nextFrame(Frame& outFrame);
+
+		MediaTime getFps() const;
+		Statistics statistics() const;
+
+	private:
+		VideoDecoder* decoder = nullptr;
+		MediaTime fps;
+		MediaTime startTime;
+		MediaTime sourceFrameDuration;
+		bool isDuplicateElided = false;
+
+		int frameIndex = 0;
+		bool isFinished = false;
+		std::shared_ptr<const ks::PixelBuffer> lastPixelBuffer;
+		MediaTime lastSourcePts;
+		std::unique_ptr<Frame> pendingDuplicate;
+		Statistics _statistics;
+	};
+}
+
+#endif // KSMediaCodec_FrameRateConverter_hpp
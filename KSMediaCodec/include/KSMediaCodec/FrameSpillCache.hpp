@@ -0,0 +1,89 @@
+#ifndef KSMediaCodec_FrameSpillCache_hpp
+#define KSMediaCodec_FrameSpillCache_hpp
+
+#include <string>
+#include <mutex>
+#include <memory>
+#include <Foundation/Foundation.hpp>
+#include "defs.hpp"
+#include "MappedFile.hpp"
+#include "VideoDecoder.hpp"
+
+namespace ks
+{
+	/**
+	 * Converted frames of one file spilled to a memory-mapped cache file of fixed-stride slots with a pts index.
+	 * Frames are decoded once, in order, as requests reach them; later requests are served as views into the
+	 * mapping. The cache file never grows past maxDiskBytes; frames beyond it are decoded on demand.
+	 * A cache file left by an earlier run is reused while its source file is unchanged; its frames are dropped
+	 * when that run did not close the cache.
+	 */
+	class KSMediaCodec_API FrameSpillCache : public noncopyable
+	{
+	public:
+		struct FrameView
+		{
+			MediaTime pts = MediaTime::zero;
+			int width = 0;
+			int height = 0;
+			const uint8_t* planeData[4] = { nullptr, nullptr, nullptr, nullptr };
+			int lineSize[4] = { 0, 0, 0, 0 };
+
+			/**
+			 * Set only for frames past the disk budget, which keeps their planes alive. Planes of mapped frames
+			 * stay valid for the lifetime of the cache.
+			 */
+			std::shared_ptr<const ks::PixelBuffer> pixelBuffer;
+		};
+
+		struct Statistics
+		{
+			unsigned long long hits = 0;
+			unsigned long long spilledFrames = 0;
+			unsigned long long overflowFrames = 0;
+			size_t frameCount = 0;
+			size_t capacity = 0;
+			long long diskUsage = 0;
+			bool isComplete = false;
+		};
+
+	public:
+		static FrameSpillCache* New(const std::string& filePath,
+			const std::string& cachePath,
+			const ks::PixelBuffer::FormatType& formatType,
+			const long long maxDiskBytes);
+		~FrameSpillCache();
+
+		/**
+		 * The frame displayed at time, false when the file has no frames.
+		 */
+		bool frameAt(const MediaTime& time, FrameView& outView);
+
+		/**
+		 * Decodes the remaining frames into the cache until the end of the file or the disk budget.
+		 * True if the whole file is cached.
+		 */
+		bool populate();
+
+		Statistics statistics();
+
+	private:
+		struct FileHeader;
+
+		std::string filePath;
+		ks::PixelBuffer::FormatType formatType;
+		std::unique_ptr<MappedFile> mappedFile;
+		std::unique_ptr<VideoDecoder> decoder;
+		std::mutex mutex;
+		Statistics _statistics;
+
+	private:
+		FileHeader& header();
+		MediaTime indexTime(const size_t index);
+		void viewSlot(const size_t index, FrameView& outView);
+		bool spillNextFrame();
+		static bool isReusableHeader(const FileHeader& fileHeader, const AVPixelFormat pixelFormat, const uint64_t maxDiskBytes);
+	};
+}
+
+#endif // KSMediaCodec_FrameSpillCache_hpp
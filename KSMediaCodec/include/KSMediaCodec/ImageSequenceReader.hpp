@@ -0,0 +1,68 @@
+#ifndef KSMediaCodec_ImageSequenceReader_hpp
+#define KSMediaCodec_ImageSequenceReader_hpp
+
+#include <string>
+#include <map>
+#include <future>
+#include <memory>
+#include <Foundation/Foundation.hpp>
+#include "defs.hpp"
+#include "MediaTime.hpp"
+#include "ThreadPool.hpp"
+
+namespace ks
+{
+	/**
+	 * Presents a numbered still-image sequence like a VideoDecoder. Images following the read position
+	 * are decoded ahead on a thread pool.
+	 */
+	class KSMediaCodec_API ImageSequenceReader : public noncopyable
+	{
+	public:
+		/**
+		 * filePattern is numbered like "frame_%05d.png"; the sequence ends at the first missing number.
+		 * threadCount 0 uses one thread per hardware thread, readAheadFrames 0 reads two images per thread ahead.
+		 */
+		static ImageSequenceReader* New(const std::string& filePattern,
+			const ks::PixelBuffer::FormatType& formatType,
+			const MediaTime& fps,
+			const int startNumber = 0,
+			const unsigned int threadCount = 0,
+			const unsigned int readAheadFrames = 0);
+		~ImageSequenceReader();
+
+		int frameCount() const;
+		int getWidth() const;
+		int getHeight() const;
+
+		ks::PixelBuffer* newFrame(MediaTime& outPts);
+		ks::PixelBuffer* newFrameAt(const MediaTime& time, MediaTime& outPts);
+		bool seek(const MediaTime& time);
+
+		MediaTime lastDecodedImageDisplayTime();
+		MediaTime fps();
+
+	private:
+		std::string filePattern = "";
+		ks::PixelBuffer::FormatType outputFormatType;
+		MediaTime _fps;
+		int startNumber = 0;
+		int _frameCount = 0;
+		int width = 0;
+		int height = 0;
+		int nextIndex = 0;
+		unsigned int readAheadFrames = 0;
+		MediaTime _lastDecodedImageDisplayTime = MediaTime::zero;
+		std::unique_ptr<ThreadPool> threadPool;
+		std::map<int, std::future<ks::PixelBuffer*>> pendingFrames;
+
+	private:
+		int indexAt(const MediaTime& time) const;
+		MediaTime timeAt(const int index) const;
+		void scheduleReadAhead();
+		void discardPendingOutside(const int firstIndex, const int endIndex);
+		static ks::PixelBuffer* decodeImage(const std::string& filePath, const ks::PixelBuffer::FormatType& formatType);
+	};
+}
+
+#endif // KSMediaCodec_ImageSequenceReader_hpp
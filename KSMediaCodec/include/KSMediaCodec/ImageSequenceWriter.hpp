@@ -0,0 +1,61 @@
+#ifndef KSMediaCodec_ImageSequenceWriter_hpp
+#define KSMediaCodec_ImageSequenceWriter_hpp
+
+#include <string>
+#include <deque>
+#include <future>
+#include <memory>
+#include <atomic>
+#include <Foundation/Foundation.hpp>
+#include "defs.hpp"
+#include "FFmpeg.h"
+#include "ThreadPool.hpp"
+
+namespace ks
+{
+	/**
+	 * Encodes frames to numbered still images on a thread pool. Numbers follow the order of write
+	 * whichever image finishes first.
+	 */
+	class KSMediaCodec_API ImageSequenceWriter : public noncopyable
+	{
+	public:
+		/**
+		 * filePattern is numbered like "frame_%05d.png"; its extension selects the image codec.
+		 * threadCount 0 uses one thread per hardware thread.
+		 */
+		static ImageSequenceWriter* New(const std::string& filePattern, const int startNumber = 0, const unsigned int threadCount = 0);
+
+		/**
+		 * Waits for queued images.
+		 */
+		~ImageSequenceWriter();
+
+		/**
+		 * Queues pixelBuffer as the next image, blocking while two images per thread are already queued.
+		 */
+		void write(std::unique_ptr<ks::PixelBuffer> pixelBuffer);
+
+		/**
+		 * Waits for queued images, false if any image since New failed to encode or write.
+		 */
+		bool finish();
+
+		int writtenCount() const;
+
+	private:
+		std::string filePattern = "";
+		AVCodecID codecId = AV_CODEC_ID_NONE;
+		int nextNumber = 0;
+		size_t maxPendingImages = 0;
+		std::unique_ptr<ThreadPool> threadPool;
+		std::deque<std::future<bool>> pendingImages;
+		std::atomic<int> _writtenCount = { 0 };
+		bool hasFailed = false;
+
+	private:
+		static bool encodeImage(const std::string& filePath, const AVCodecID codecId, const ks::PixelBuffer& pixelBuffer);
+	};
+}
+
+#endif // KSMediaCodec_ImageSequenceWriter_hpp
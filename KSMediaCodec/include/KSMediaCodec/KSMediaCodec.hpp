@@ -2,12 +2,36 @@
 #define KSMediaCodec_KSMediaCodec_hpp
 
 #include "defs.hpp"
+#include "DecoderOpenOptions.hpp"
 #include "AudioDecoder.hpp"
+#include "AudioMixer.hpp"
+#include "FramePool.hpp"
+#include "DecodedVideoFrame.hpp"
 #include "VideoDecoder.hpp"
+#include "MultiStreamDecoder.hpp"
 #include "MediaTime.hpp"
 #include "MediaTimeMapping.hpp"
 #include "MediaTimeRange.hpp"
+#include "MediaTimeline.hpp"
+#include "MediaPacket.hpp"
+#include "PacketReader.hpp"
 #include "VideoFileEncoder.hpp"
+#include "MultiRenditionEncoder.hpp"
+#include "CompositionRenderer.hpp"
+#include "DecoderCache.hpp"
+#include "VideoFrameCache.hpp"
+#include "FrameSpillCache.hpp"
+#include "FrameRateConverter.hpp"
+#include "ReverseVideoDecoder.hpp"
+#include "ThreadPool.hpp"
+#include "MappedFile.hpp"
+#include "WaveformPyramid.hpp"
+#include "ImageSequenceWriter.hpp"
+#include "ImageSequenceReader.hpp"
+#include "TranscodeScheduler.hpp"
+#include "AsyncExecutor.hpp"
+#include "AsyncVideoDecoder.hpp"
+#include "AsyncVideoFileEncoder.hpp"
 #include "Util.hpp"
 
 #endif // !KSMediaCodec_KSMediaCodec_hpp
\ No newline at end of file
@@ -0,0 +1,52 @@
+#ifndef KSMediaCodec_MappedFile_hpp
+#define KSMediaCodec_MappedFile_hpp
+
+#include <string>
+#include <Foundation/Foundation.hpp>
+#include "defs.hpp"
+
+namespace ks
+{
+	class KSMediaCodec_API MappedFile : public noncopyable
+	{
+	public:
+		/**
+		 * Maps an existing file read-only.
+		 */
+		static MappedFile* Open(const std::string& filePath);
+
+		/**
+		 * Maps filePath read-write, creating it or resizing it to size. Existing contents within size are kept;
+		 * new space reads as zeros and is allocated lazily where the file system supports sparse files.
+		 */
+		static MappedFile* Create(const std::string& filePath, const size_t size);
+
+		~MappedFile();
+
+		const unsigned char* data() const;
+
+		/**
+		 * nullptr for read-only mappings.
+		 */
+		unsigned char* mutableData();
+		size_t size() const;
+
+		/**
+		 * Writes the pages covering [offset, offset + length) of a writable mapping back to disk and waits for them.
+		 */
+		bool flush(const size_t offset, const size_t length);
+
+	private:
+		unsigned char* _data = nullptr;
+		size_t _size = 0;
+		bool isWritable = false;
+#ifdef _WIN32
+		void* fileHandle = nullptr;
+		void* mappingHandle = nullptr;
+#else
+		int fileDescriptor = -1;
+#endif
+	};
+}
+
+#endif // KSMediaCodec_MappedFile_hpp
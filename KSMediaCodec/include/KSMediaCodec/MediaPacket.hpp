@@ -0,0 +1,54 @@
+#ifndef KSMediaCodec_MediaPacket_hpp
+#define KSMediaCodec_MediaPacket_hpp
+
+#include <Foundation/Foundation.hpp>
+#include "defs.hpp"
+#include "FFmpeg.h"
+#include "MediaTime.hpp"
+
+namespace ks
+{
+	/**
+	 * A reference to one compressed packet and the time base of its timestamps.
+	 * newReference shares the payload instead of copying it, so packets can be handed to other threads cheaply.
+	 */
+	class KSMediaCodec_API MediaPacket : public noncopyable
+	{
+	public:
+		/**
+		 * References packet, or copies it when its payload is not ref-counted.
+		 */
+		static MediaPacket* New(const AVPacket* packet, const AVRational timeBase);
+		~MediaPacket();
+
+		MediaPacket* newReference() const;
+
+		int getStreamIndex() const;
+		AVRational getTimeBase() const;
+
+		/**
+		 * AV_NOPTS_VALUE when unknown.
+		 */
+		int64_t getPts() const;
+		int64_t getDts() const;
+		int64_t getDuration() const;
+
+		MediaTime ptsTime() const;
+		MediaTime dtsTime() const;
+
+		bool isKeyframe() const;
+		const uint8_t* data() const;
+		int size() const;
+
+		const AVPacket* getAVPacket() const;
+
+	private:
+		AVPacket* packet = nullptr;
+		AVRational timeBase;
+
+	private:
+		MediaTime timestampTime(const int64_t timestamp) const;
+	};
+}
+
+#endif // KSMediaCodec_MediaPacket_hpp
@@ -12,6 +12,8 @@ namespace ks
 		MediaTimeMapping();
 		MediaTimeMapping(const MediaTimeRange source, const MediaTimeRange target);
 
+		MediaTime sourceTime(const MediaTime& targetTime) const;
+
 		//private:
 		MediaTimeRange source;
 		MediaTimeRange target;
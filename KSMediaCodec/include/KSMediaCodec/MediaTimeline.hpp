@@ -0,0 +1,66 @@
+#ifndef KSMediaCodec_MediaTimeline_hpp
+#define KSMediaCodec_MediaTimeline_hpp
+
+#include <vector>
+#include "defs.hpp"
+
+#include "MediaTimeMapping.hpp"
+
+namespace ks
+{
+	/**
+	 * Mappings ordered by target start time. Every lookup treats a target range as [start, end).
+	 * Overlapping target ranges are allowed; point lookups prefer the mapping that starts last.
+	 */
+	class KSMediaCodec_API MediaTimeline
+	{
+	public:
+		MediaTimeline();
+
+		/**
+		 * O(n) when mappings are already sorted by target start, O(n log n) otherwise.
+		 */
+		MediaTimeline(const std::vector<MediaTimeMapping>& mappings);
+
+	public:
+		void insert(const MediaTimeMapping& mapping);
+		void clear();
+
+		size_t count() const;
+		bool isEmpty() const;
+		const MediaTimeMapping& mappingAt(const size_t index) const;
+		const std::vector<MediaTimeMapping>& getMappings() const;
+		MediaTimeRange targetTimeRange() const;
+
+		/**
+		 * Returns -1 when no mapping covers targetTime. O(log n).
+		 */
+		int indexOf(const MediaTime& targetTime) const;
+		bool sourceTime(const MediaTime& targetTime, MediaTime& outSourceTime) const;
+
+		/**
+		 * Indices of every mapping whose target range overlaps targetTimeRange, in ascending order.
+		 * O(log n) per index returned.
+		 */
+		std::vector<size_t> indicesOverlapping(const MediaTimeRange& targetTimeRange) const;
+		std::vector<MediaTimeMapping> mappingsOverlapping(const MediaTimeRange& targetTimeRange) const;
+
+	private:
+		std::vector<MediaTimeMapping> mappings;
+
+		/**
+		 * Segment tree over mappings by index, each node holding the latest target end of its range.
+		 * Node 1 covers every mapping; node i has children 2i and 2i + 1.
+		 */
+		std::vector<MediaTime> maxTargetEnds;
+
+		void rebuildMaxTargetEnds();
+		void buildNode(const size_t node, const size_t first, const size_t last);
+		int lastIndexEndingAfter(const size_t node, const size_t first, const size_t last, const size_t endIndex, const MediaTime& time) const;
+		void collectIndicesEndingAfter(const size_t node, const size_t first, const size_t last, const size_t endIndex, const MediaTime& time, std::vector<size_t>& outIndices) const;
+		size_t upperBound(const MediaTime& time) const;
+		size_t lowerBound(const MediaTime& time) const;
+	};
+}
+
+#endif // KSMediaCodec_MediaTimeline_hpp
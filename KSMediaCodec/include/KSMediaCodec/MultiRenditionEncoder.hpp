@@ -0,0 +1,108 @@
+#ifndef KSMediaCodec_MultiRenditionEncoder_hpp
+#define KSMediaCodec_MultiRenditionEncoder_hpp
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <Foundation/Foundation.hpp>
+#include "defs.hpp"
+#include "VideoFileEncoder.hpp"
+#include "MediaPacket.hpp"
+
+namespace ks
+{
+	/**
+	 * Encodes one stream of frames into several renditions at once, e.g. an ABR ladder.
+	 * Renditions are ordered from largest to smallest; the largest is scaled from the source frames and each
+	 * other one from the rendition above it. Every rendition encodes on its own thread. Audio is encoded once
+	 * per group of outputs whose containers need the same codec setup, and its packets are muxed into the other
+	 * outputs of the group, which open no audio encoder. If New fails, the outputs it opened are removed.
+	 */
+	class KSMediaCodec_API MultiRenditionEncoder : public noncopyable
+	{
+	public:
+		struct Rendition
+		{
+			std::string outputPath;
+			VideoFileEncoder::VideoEncodeAttribute videoEncodeAttribute;
+		};
+
+	public:
+		static MultiRenditionEncoder* New(const std::vector<Rendition>& renditions,
+			const VideoFileEncoder::AudioEncodeAttribute& audioEncodeAttribute,
+			const ks::AudioFormat& outputAudioFormat,
+			VideoFileEncoder::Error* error);
+
+		/**
+		 * Calls encodeTail if it has not been called.
+		 */
+		~MultiRenditionEncoder();
+
+		/**
+		 * Queues a frame for every rendition. Blocks while the largest rendition is maxQueuedFrames behind.
+		 */
+		void encode(std::shared_ptr<const ks::PixelBuffer> pixelBuffer, const ks::MediaTime& pts);
+		void encode(const ks::AudioPCMBuffer& pcmBuffer, const ks::MediaTime& pts);
+
+		/**
+		 * Flushes every rendition and writes the trailers, returning once all outputs are complete.
+		 */
+		void encodeTail();
+
+		unsigned int getAudioSamples();
+		size_t renditionCount() const;
+
+	private:
+		struct WorkItem
+		{
+			enum class Type
+			{
+				video,
+				audio,
+				packet,
+				tail,
+			};
+
+			Type type = Type::video;
+			std::shared_ptr<const ks::PixelBuffer> pixelBuffer;
+			std::shared_ptr<const ks::AudioPCMBuffer> pcmBuffer;
+			std::shared_ptr<const MediaPacket> packet;
+			ks::MediaTime pts;
+		};
+
+		struct RenditionWorker
+		{
+			Rendition rendition;
+			std::unique_ptr<VideoFileEncoder> encoder;
+			RenditionWorker* nextWorker = nullptr;
+			struct SwsContext* swsContext = nullptr;
+			bool encodesAudio = false;
+			RenditionWorker* audioOwner = nullptr;
+			std::vector<RenditionWorker*> audioTargets;
+
+			std::thread thread;
+			std::mutex mutex;
+			std::condition_variable condition;
+			std::deque<WorkItem> items;
+			size_t queuedFrames = 0;
+			bool isFinished = false;
+		};
+
+		std::vector<std::unique_ptr<RenditionWorker>> workers;
+		bool hasEncodedTail = false;
+
+		static const size_t maxQueuedFrames = 8;
+
+	private:
+		static void push(RenditionWorker& worker, WorkItem item);
+		static void workerLoop(RenditionWorker* worker);
+		static std::shared_ptr<const ks::PixelBuffer> newScaledFrame(RenditionWorker& worker, std::shared_ptr<const ks::PixelBuffer> source);
+		static void waitUntilFinished(RenditionWorker& worker);
+	};
+}
+
+#endif // KSMediaCodec_MultiRenditionEncoder_hpp
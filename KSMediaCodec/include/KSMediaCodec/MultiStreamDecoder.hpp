@@ -0,0 +1,98 @@
+#ifndef KSMediaCodec_MultiStreamDecoder_hpp
+#define KSMediaCodec_MultiStreamDecoder_hpp
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <Foundation/Foundation.hpp>
+#include "defs.hpp"
+#include "FFmpeg.h"
+#include "MediaTimeRange.hpp"
+#include "DecoderOpenOptions.hpp"
+
+namespace ks
+{
+	/**
+	 * Decodes every selected audio and video stream of one file from a single demux pass.
+	 * Frames are returned in demux order, each tagged with the stream it belongs to.
+	 */
+	class KSMediaCodec_API MultiStreamDecoder : public noncopyable
+	{
+	public:
+		/**
+		 * Selects every stream of mediaType matching the index, language and disposition of options.
+		 * Probing and codec parameter fields of options are ignored. mediaType must be audio or video.
+		 */
+		struct StreamSelection
+		{
+			AVMediaType mediaType = AVMEDIA_TYPE_AUDIO;
+			DecoderOpenOptions options;
+		};
+
+		struct StreamInfo
+		{
+			int streamIndex = -1;
+			AVMediaType mediaType = AVMEDIA_TYPE_UNKNOWN;
+			std::string language = "";
+			int disposition = 0;
+		};
+
+		struct Frame
+		{
+			int streamIndex = -1;
+			AVMediaType mediaType = AVMEDIA_TYPE_UNKNOWN;
+			MediaTimeRange timeRange;
+			std::unique_ptr<ks::PixelBuffer> pixelBuffer;
+			std::unique_ptr<ks::AudioPCMBuffer> pcmBuffer;
+		};
+
+	public:
+		static MultiStreamDecoder* New(const std::string& filePath,
+			const std::vector<StreamSelection>& selections,
+			const ks::PixelBuffer::FormatType& formatType,
+			const ks::AudioFormat& audioFormat);
+		~MultiStreamDecoder();
+
+		std::vector<StreamInfo> streams() const;
+
+		/**
+		 * Moves the next decoded frame of any selected stream into outFrame, false once every stream is drained.
+		 */
+		bool nextFrame(Frame& outFrame);
+
+		bool seek(const MediaTime& time);
+
+	private:
+		struct DecodedStream
+		{
+			StreamInfo info;
+			AVStream* stream = nullptr;
+			AVCodecContext* codecContext = nullptr;
+			SwsContext* swsContext = nullptr;
+			SwrContext* swrContext = nullptr;
+			std::vector<uint8_t*> convertedSamples;
+			int convertedSamplesCapacity = 0;
+			int64_t nextStartSample = 0;
+		};
+
+		std::string filePath = "";
+		ks::PixelBuffer::FormatType outputFormatType;
+		ks::AudioFormat outputAudioFormat;
+		AVFormatContext* formatContext = nullptr;
+		std::vector<std::unique_ptr<DecodedStream>> decodedStreams;
+		std::vector<int> decodedStreamIndices;
+		std::deque<Frame> pendingFrames;
+		AVFrame* frame = nullptr;
+		AVPacket* packet = nullptr;
+		bool isDraining = false;
+
+	private:
+		static void freeDecodedStream(DecodedStream& decodedStream);
+		void decodePacket(DecodedStream& decodedStream, const AVPacket* packet);
+		bool convertVideoFrame(DecodedStream& decodedStream, Frame& outFrame);
+		bool convertAudioFrame(DecodedStream& decodedStream, const uint8_t** samples, const int sampleCount, Frame& outFrame);
+	};
+}
+
+#endif // KSMediaCodec_MultiStreamDecoder_hpp
@@ -0,0 +1,55 @@
+#ifndef KSMediaCodec_PacketReader_hpp
+#define KSMediaCodec_PacketReader_hpp
+
+#include <string>
+#include <Foundation/Foundation.hpp>
+#include "defs.hpp"
+#include "FFmpeg.h"
+#include "MediaTime.hpp"
+#include "MediaPacket.hpp"
+#include "DecoderOpenOptions.hpp"
+
+namespace ks
+{
+	/**
+	 * Demuxes compressed packets without decoding them, for indexing, stream copy and forwarding.
+	 */
+	class KSMediaCodec_API PacketReader : public noncopyable
+	{
+	public:
+		/**
+		 * Only the probing fields of options are used.
+		 */
+		static PacketReader* New(const std::string& filePath, const DecoderOpenOptions& options = DecoderOpenOptions());
+		~PacketReader();
+
+		std::string getFilePath() const;
+
+		int streamCount() const;
+		AVMediaType mediaType(const int streamIndex) const;
+		AVRational timeBase(const int streamIndex) const;
+		const AVCodecParameters* codecParameters(const int streamIndex) const;
+
+		/**
+		 * Disabled streams are dropped by the demuxer and never returned.
+		 */
+		void setStreamEnabled(const int streamIndex, const bool isEnabled);
+
+		/**
+		 * Next packet of any enabled stream in file order, nullptr at the end of the file or on error.
+		 */
+		MediaPacket* newPacket();
+
+		/**
+		 * Seeks every stream to the keyframe at or before time.
+		 */
+		bool seek(const MediaTime& time);
+
+	private:
+		std::string filePath = "";
+		AVFormatContext* formatContext = nullptr;
+		AVPacket* packet = nullptr;
+	};
+}
+
+#endif // KSMediaCodec_PacketReader_hpp
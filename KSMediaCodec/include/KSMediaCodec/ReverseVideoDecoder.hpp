@@ -0,0 +1,91 @@
+#ifndef KSMediaCodec_ReverseVideoDecoder_hpp
+#define KSMediaCodec_ReverseVideoDecoder_hpp
+
+#include <string>
+#include <deque>
+#include <mutex>
+#include <memory>
+#include <thread>
+#include <condition_variable>
+#include <Foundation/Foundation.hpp>
+#include "defs.hpp"
+#include "VideoDecoder.hpp"
+
+namespace ks
+{
+	/**
+	 * Returns the frames of one file in reverse presentation order. Each GOP is decoded forward once into a
+	 * buffer and handed out back to front, while a background decoder fills the buffer for the GOP before it.
+	 * The two buffers never hold more than maxMemoryBytes of converted frames; a GOP longer than one buffer
+	 * is split, and its earlier part is decoded again from the keyframe.
+	 */
+	class KSMediaCodec_API ReverseVideoDecoder : public noncopyable
+	{
+	public:
+		struct Statistics
+		{
+			unsigned long long returnedFrames = 0;
+			unsigned long long decodedFrames = 0;
+			unsigned long long segments = 0;
+
+			/**
+			 * Calls of newFrame that had to wait for the background decoder.
+			 */
+			unsigned long long waits = 0;
+		};
+
+	public:
+		/**
+		 * The first frame returned is the one displayed at startTime.
+		 */
+		static ReverseVideoDecoder* New(const std::string& filePath,
+			const ks::PixelBuffer::FormatType& formatType,
+			const MediaTime& startTime,
+			const long long maxMemoryBytes);
+		~ReverseVideoDecoder();
+
+		/**
+		 * The frame before the one returned last, nullptr after the first frame of the file.
+		 */
+		ks::PixelBuffer* newFrame(MediaTime& outPts);
+
+		int getWidth() const;
+		int getHeight() const;
+		Statistics statistics();
+
+	private:
+		struct Frame
+		{
+			std::unique_ptr<ks::PixelBuffer> pixelBuffer;
+			MediaTime pts;
+		};
+
+		std::unique_ptr<VideoDecoder> decoder;
+		int width = 0;
+		int height = 0;
+		size_t segmentFrameCount = 1;
+		MediaTime startTime;
+		MediaTime streamStartTime;
+
+		/**
+		 * Learned the first time a segment is decoded from streamStartTime, on the decode thread.
+		 */
+		MediaTime firstFramePts;
+		bool isFirstFrameKnown = false;
+		std::deque<Frame> currentSegment;
+
+		std::mutex mutex;
+		std::condition_variable condition;
+		std::unique_ptr<std::deque<Frame>> readySegment;
+		bool isFinished = false;
+		bool isStopping = false;
+		Statistics _statistics;
+		std::thread decodeThread;
+
+	private:
+		bool decodeSegment(const MediaTime& endTime, const bool isEndIncluded, std::deque<Frame>& outFrames);
+		void decodeLoop();
+	};
+}
+
+#endif // KSMediaCodec_ReverseVideoDecoder_hpp
@@ -0,0 +1,57 @@
+#ifndef KSMediaCodec_ThreadPool_hpp
+#define KSMediaCodec_ThreadPool_hpp
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <type_traits>
+#include <Foundation/Foundation.hpp>
+#include "defs.hpp"
+
+namespace ks
+{
+	class KSMediaCodec_API ThreadPool : public noncopyable
+	{
+	public:
+		/**
+		 * 0 uses one thread per hardware thread.
+		 */
+		explicit ThreadPool(const unsigned int threadCount = 0);
+		~ThreadPool();
+
+		template<typename Function>
+		std::future<std::invoke_result_t<Function>> submit(Function&& function)
+		{
+			using Result = std::invoke_result_t<Function>;
+			std::shared_ptr<std::packaged_task<Result()>> task = std::make_shared<std::packaged_task<Result()>>(std::forward<Function>(function));
+			std::future<Result> future = task->get_future();
+			post([task]()
+			{
+				(*task)();
+			});
+			return future;
+		}
+
+		unsigned int threadCount() const;
+
+		static unsigned int defaultThreadCount();
+
+	private:
+		std::vector<std::thread> threads;
+		std::deque<std::function<void()>> tasks;
+		std::mutex mutex;
+		std::condition_variable condition;
+		bool isStopping = false;
+
+	private:
+		void post(std::function<void()> task);
+		void workerLoop();
+	};
+}
+
+#endif // KSMediaCodec_ThreadPool_hpp
@@ -0,0 +1,110 @@
+#ifndef KSMediaCodec_TranscodeScheduler_hpp
+#define KSMediaCodec_TranscodeScheduler_hpp
+
+#include <string>
+#include <deque>
+#include <mutex>
+#include <memory>
+#include <functional>
+#include <condition_variable>
+#include <Foundation/Foundation.hpp>
+#include "defs.hpp"
+#include "VideoFileEncoder.hpp"
+
+namespace ks
+{
+	class WorkStealingPool;
+
+	/**
+	 * Runs many transcode jobs on one work-stealing pool. Each job is split into an open stage, decode and
+	 * encode stages per chunk of frames that run pipelined on different workers, and a finish stage.
+	 * Jobs start in submission order once their memory estimate and open files fit the global budgets;
+	 * a job that exceeds a budget on its own still runs when nothing else is running.
+	 */
+	class KSMediaCodec_API TranscodeScheduler : public noncopyable
+	{
+	public:
+		struct Job
+		{
+			std::string inputPath;
+			std::string outputPath;
+
+			/**
+			 * Frames are decoded in videoEncodeAttribute.pixelBufferFormatType and audio in audioFormat.
+			 * Inputs without an audio stream are transcoded video only.
+			 */
+			VideoFileEncoder::VideoEncodeAttribute videoEncodeAttribute;
+			VideoFileEncoder::AudioEncodeAttribute audioEncodeAttribute;
+			ks::AudioFormat audioFormat;
+
+			/**
+			 * Bytes reserved from the memory budget while the job runs, 0 estimates them from the frame size.
+			 */
+			long long estimatedMemoryBytes = 0;
+
+			/**
+			 * Called on a worker thread once the job has finished or failed.
+			 */
+			std::function<void(bool isSucceeded)> completion;
+		};
+
+		struct Statistics
+		{
+			size_t pendingJobs = 0;
+			size_t runningJobs = 0;
+			unsigned long long completedJobs = 0;
+			unsigned long long failedJobs = 0;
+			unsigned long long encodedVideoFrames = 0;
+			unsigned long long encodedAudioFrames = 0;
+			long long reservedMemory = 0;
+			int openFiles = 0;
+
+			/**
+			 * Wall-clock time spent with at least one job pending or running.
+			 */
+			double busySeconds = 0.0;
+			double videoFramesPerSecond = 0.0;
+			double jobsPerSecond = 0.0;
+		};
+
+	public:
+		/**
+		 * 0 threads uses one per hardware thread. Every running job holds three open files.
+		 */
+		TranscodeScheduler(const unsigned int threadCount, const long long maxMemoryBytes, const int maxOpenFiles);
+		~TranscodeScheduler();
+
+		void submit(const Job& job);
+
+		/**
+		 * Blocks until every submitted job has finished.
+		 */
+		void waitAll();
+
+		Statistics statistics();
+
+	private:
+		struct JobState;
+
+		std::unique_ptr<WorkStealingPool> pool;
+		long long maxMemoryBytes;
+		int maxOpenFiles;
+
+		std::mutex mutex;
+		std::condition_variable idleCondition;
+		std::deque<std::shared_ptr<JobState>> pendingJobs;
+		size_t runningJobs = 0;
+		Statistics _statistics;
+		int64_t busyStartTime = 0;
+		int64_t busyTime = 0;
+
+	private:
+		void admitJobs();
+		void openJob(std::shared_ptr<JobState> state);
+		void decodeChunk(std::shared_ptr<JobState> state);
+		void encodeChunk(std::shared_ptr<JobState> state);
+		void finishJob(std::shared_ptr<JobState> state, const bool isSucceeded);
+	};
+}
+
+#endif // KSMediaCodec_TranscodeScheduler_hpp
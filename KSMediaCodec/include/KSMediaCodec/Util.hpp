@@ -7,6 +7,11 @@
 namespace ks
 {
 	std::string KSMediaCodec_API ffmpegErrorDescription(int errorCode) noexcept;
+
+	/**
+	 * Expands the single %d (optionally %0Nd) of an image sequence pattern such as "frame_%05d.png", empty on failure.
+	 */
+	std::string KSMediaCodec_API imageSequenceFilePath(const std::string& filePattern, const int number) noexcept;
 }
 
 #endif // !KSMediaCodec_Util_hpp
\ No newline at end of file
@@ -3,17 +3,34 @@
 
 #include <string>
 #include <vector>
+#include <memory>
 #include <Foundation/Foundation.hpp>
 #include "defs.hpp"
 #include "FFmpeg.h"
 #include "MediaTimeMapping.hpp"
+#include "DecoderOpenOptions.hpp"
+#include "DecodedVideoFrame.hpp"
 
 namespace ks
 {
 	class KSMediaCodec_API VideoDecoder : public noncopyable
 	{
 	public:
-		static VideoDecoder* New(const std::string & filePath, const ks::PixelBuffer::FormatType& formatType);
+		/**
+		 * Difference between a decoded frame and the one decoded before it, measured on the luma plane.
+		 * Both differences are normalized to [0, 1]; score is their mean.
+		 */
+		struct FrameDifference
+		{
+			MediaTime pts;
+			double lumaDifference = 0.0;
+			double histogramDifference = 0.0;
+			double score = 0.0;
+			bool isSceneCut = false;
+		};
+
+	public:
+		static VideoDecoder* New(const std::string & filePath, const ks::PixelBuffer::FormatType& formatType, const DecoderOpenOptions& options = DecoderOpenOptions());
 		~VideoDecoder();
 
 	private:
@@ -25,15 +42,124 @@ namespace ks
 		AVCodec *codec = nullptr;
 		int videoStreamIndex = -1;
 		struct SwsContext *imageSwsContext = nullptr;
+		struct SwsContext *lumaSwsContext = nullptr;
 		MediaTime _lastDecodedImageDisplayTime = MediaTime::zero;
+		AVFrame *currentFrame = nullptr;
+		AVFrame *lookaheadFrame = nullptr;
+		bool isDraining = false;
+		bool isCurrentFrameFirstAfterSeek = false;
+		bool hasTakenFrameAfterSeek = false;
+		bool isLookaheadFrameNearest = false;
+		MediaTime lastSeekTime = MediaTime::zero;
+		int64_t openStartTime = 0;
+		int64_t openEndTime = 0;
+		int64_t firstFrameTime = AV_NOPTS_VALUE;
+
+		struct SceneAnalysis;
+		std::unique_ptr<SceneAnalysis> sceneAnalysis;
 
 	private:
-		ks::PixelBuffer* newDecodedFrame(AVCodecContext * videoCodecCtx, AVFrame* frame, AVPacket* packet, MediaTime& outTime);
+		int decodeNextFrame(AVFrame* frame);
+		bool takeNextFrame(AVFrame* frame);
+		ks::PixelBuffer* newConvertedFrame(const AVFrame* frame, MediaTime& outTime);
+		ks::PixelBuffer* newLumaBuffer(const AVFrame* frame, const int decimation, MediaTime& outTime);
+		MediaTime frameTime(const AVFrame* frame) const;
+		MediaTime keyframeTimeAtOrBefore(const MediaTime& time) const;
+		void analyzeFrame(const AVFrame* frame);
 
 	public:
+		std::string getFilePath() const;
+		ks::PixelBuffer::FormatType getOutputFormatType() const;
+		int getWidth() const;
+		int getHeight() const;
+
+		/**
+		 * Rough size in bytes of the codec reference frames plus buffered decoder frames.
+		 */
+		long long estimatedMemoryUsage() const;
+
 		ks::PixelBuffer* newFrame(MediaTime& outPts);
+
+		/**
+		 * Returns the frame displayed at time. Decodes forward from the current position when possible
+		 * and only seeks when time is behind it or past the next keyframe. Skipped frames are not converted.
+		 */
+		ks::PixelBuffer* newFrameAt(const MediaTime& time, MediaTime& outPts);
+		bool prepareFrameAt(const MediaTime& time);
+
+		/**
+		 * Like prepareFrameAt, but positions on the frame whose pts is nearest to time, earlier or later,
+		 * and returns that pts without converting the frame.
+		 */
+		bool prepareNearestFrameAt(const MediaTime& time, MediaTime& outPts);
+
+		/**
+		 * Converts the frame positioned by prepareFrameAt or prepareNearestFrameAt.
+		 */
+		ks::PixelBuffer* newPreparedFrame(MediaTime& outPts);
+
+		/**
+		 * The next frame's luma as gray8, every decimation-th pixel of every decimation-th row for a decimation
+		 * of 2 or 4. 8-bit YUV and gray frames are copied straight from the Y plane; other formats go through
+		 * a gray8 conversion at the decimated size. Does not change the output format of newFrame.
+		 */
+		ks::PixelBuffer* newLumaFrame(const int decimation, MediaTime& outPts);
+		ks::PixelBuffer* newLumaFrameAt(const MediaTime& time, const int decimation, MediaTime& outPts);
+
+		/**
+		 * Same frame as newFrameAt, referenced in the codec's pixel format without conversion.
+		 * Use DecodedVideoFrame::planeData or newPlaneBuffer to read chosen planes.
+		 */
+		DecodedVideoFrame* newDecodedFrameAt(const MediaTime& time);
+
+		/**
+		 * Frames displayed at each of times, in request order, nullptr where no frame could be decoded.
+		 * Requests are visited in presentation order so each GOP is decoded at most once and only
+		 * the requested frames are converted.
+		 */
+		std::vector<ks::PixelBuffer*> extractFrames(const std::vector<MediaTime>& times, std::vector<MediaTime>& outPts);
+
+		/**
+		 * Same as extractFrames, with the requests split at GOP boundaries across up to decoderCount
+		 * decoders of filePath running on a thread pool. 0 uses one decoder per hardware thread.
+		 */
+		static std::vector<ks::PixelBuffer*> extractFramesParallel(const std::string& filePath,
+			const ks::PixelBuffer::FormatType& formatType,
+			const std::vector<MediaTime>& times,
+			std::vector<MediaTime>& outPts,
+			const unsigned int decoderCount = 0);
+
 		bool seek(const MediaTime& time);
 
+		/**
+		 * Scores every decoded frame against the previous one on its luma plane before any conversion.
+		 * Frames scoring at least sceneCutThreshold are marked as scene cuts. Seeking restarts the comparison.
+		 */
+		void setSceneAnalysisEnabled(const bool isEnabled, const double sceneCutThreshold = 0.3);
+
+		/**
+		 * Returns and clears the differences recorded since the last call.
+		 */
+		std::vector<FrameDifference> takeFrameDifferences();
+
+		/**
+		 * Decodes every frame up to time without converting any, e.g. to run scene analysis over a range.
+		 * False when no frame could be decoded.
+		 */
+		bool decodeThrough(const MediaTime& time);
+
+		MediaTime openDuration() const;
+
+		/**
+		 * The container's start time of the video stream, zero when it has none.
+		 */
+		MediaTime startTime() const;
+
+		/**
+		 * Wall-clock time from the start of New until the first frame was converted, negative until then.
+		 */
+		MediaTime timeToFirstFrame() const;
+
 		MediaTime lastDecodedImageDisplayTime();
 		MediaTime fps();
 
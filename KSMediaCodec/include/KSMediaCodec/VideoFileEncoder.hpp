@@ -1,10 +1,15 @@
 #ifndef KSMediaCodec_VideoFileEncoder_hpp
 #define KSMediaCodec_VideoFileEncoder_hpp
 
+#include <string>
+#include <map>
+#include <deque>
+#include <functional>
 #include <Foundation/Foundation.hpp>
 #include "FFmpeg.h"
 #include "MediaTime.hpp"
 #include "MediaTimeRange.hpp"
+#include "MediaPacket.hpp"
 #include "defs.hpp"
 
 namespace ks
@@ -26,9 +31,17 @@ namespace ks
 			avcodec_parameters_from_context_audio,
 			avio_open,
 			avformat_write_header,
+			avcodec_parameters_copy_video,
+			avcodec_parameters_copy_audio,
 		};
 
 	public:
+		enum class RateControlMode
+		{
+			bitRate,
+			constantQuality,
+		};
+
 		struct VideoEncodeAttribute
 		{
 			ks::PixelBuffer::FormatType pixelBufferFormatType;
@@ -38,6 +51,108 @@ namespace ks
 			MediaTime timeBase;
 			long long bitRate;
 			unsigned int gopSize;
+
+			/**
+			 * Encoder name such as "libx264", empty uses the container's default video codec.
+			 */
+			std::string codecName = "";
+
+			/**
+			 * 0 lets the codec choose.
+			 */
+			int threadCount = 0;
+
+			/**
+			 * FF_THREAD_FRAME and/or FF_THREAD_SLICE, 0 keeps the codec default.
+			 */
+			int threadType = 0;
+
+			std::string preset = "";
+			std::string tune = "";
+
+			/**
+			 * constantQuality ignores bitRate and encodes at quality, the codec's crf when it has one,
+			 * otherwise a fixed quantizer.
+			 */
+			RateControlMode rateControlMode = RateControlMode::bitRate;
+			double quality = 23.0;
+
+			/**
+			 * -1 keeps the codec default.
+			 */
+			int maxBFrames = -1;
+
+			/**
+			 * Copied into the avcodec_open2 options after the fields above, so its entries win. Not owned.
+			 */
+			const AVDictionary* codecOptions = nullptr;
+
+			/**
+			 * For live capture: no B-frames, zerolatency tuning, slice threading, packets written and flushed
+			 * as soon as the codec returns them, and one fragment per frame for MP4/MOV output.
+			 */
+			bool lowLatency = false;
+
+			/**
+			 * Caps of the encoder's own interleaving queue, which holds packets of the stream that runs ahead
+			 * until the other stream catches up. Past either cap the oldest queued packet is written anyway.
+			 * 0 bytes hands interleaving to libavformat instead. Ignored with lowLatency.
+			 */
+			long long interleaveMaxBytes = 64LL * 1024 * 1024;
+			double interleaveMaxSeconds = 10.0;
+		};
+
+		/**
+		 * Wall-clock time from a video frame entering the encoder to its packet being written.
+		 */
+		struct LatencyStatistics
+		{
+			unsigned long long packets = 0;
+			long long lastMicroseconds = 0;
+			long long maxMicroseconds = 0;
+			double averageMicroseconds = 0.0;
+			size_t maxFramesInFlight = 0;
+		};
+
+		struct InterleaveStatistics
+		{
+			size_t queuedVideoPackets = 0;
+			size_t queuedAudioPackets = 0;
+			long long queuedBytes = 0;
+			long long maxQueuedBytes = 0;
+
+			/**
+			 * Span between the oldest and newest packet queued for the stream that runs ahead.
+			 */
+			double queuedSeconds = 0.0;
+			double maxQueuedSeconds = 0.0;
+
+			/**
+			 * Packets written out of order because a cap was reached.
+			 */
+			unsigned long long forcedWrites = 0;
+		};
+
+		struct AudioEncodeAttribute
+		{
+			/**
+			 * Encoder name such as "aac", empty uses the container's default audio codec.
+			 */
+			std::string codecName = "";
+			long long bitRate = 128000;
+			int threadCount = 0;
+
+			/**
+			 * Copied into the avcodec_open2 options. Not owned.
+			 */
+			const AVDictionary* codecOptions = nullptr;
+
+			/**
+			 * When set, no audio encoder is opened: the audio stream copies these parameters, e.g. another
+			 * encoder's getAudioCodecParameters, and is fed with writePacket only. Not owned.
+			 */
+			const AVCodecParameters* streamCopyParameters = nullptr;
+			AVRational streamCopyTimeBase = { 1, 48000 };
 		};
 
 	public:
@@ -46,16 +161,63 @@ namespace ks
 			const ks::AudioFormat& outputAudioFormat,
 			VideoFileEncoder::Error* error);
 
+		static VideoFileEncoder* New(const std::string& outputPath,
+			const VideoEncodeAttribute& videoEncodeAttribute,
+			const AudioEncodeAttribute& audioEncodeAttribute,
+			const ks::AudioFormat& outputAudioFormat,
+			VideoFileEncoder::Error* error);
+
+		/**
+		 * Muxer only, for stream copy, segmenting and forwarding: the output streams take their codec parameters
+		 * and time bases from the source streams, e.g. PacketReader::codecParameters, and no encoder is opened.
+		 * Feed it with writePacket; encode does nothing. Either stream may be omitted with nullptr parameters.
+		 */
+		static VideoFileEncoder* NewStreamCopy(const std::string& outputPath,
+			const AVCodecParameters* videoCodecParameters,
+			const AVRational videoTimeBase,
+			const AVCodecParameters* audioCodecParameters,
+			const AVRational audioTimeBase,
+			VideoFileEncoder::Error* error);
+
 		~VideoFileEncoder();
 
 		void encode(const ks::PixelBuffer& pixelBuffer, const ks::MediaTime& pts);
 		void encode(const ks::AudioPCMBuffer& pcmBuffer, const ks::MediaTime& pts);
 		void encodeTail();
+
+		/**
+		 * Muxes an already encoded packet into the video or audio stream without re-encoding.
+		 * The packet must match that stream's codec parameters: those of the source stream for NewStreamCopy,
+		 * or of an identically configured encoder otherwise. Returns a negative AVERROR on failure.
+		 */
+		int writePacket(const MediaPacket& packet, const AVMediaType mediaType);
 		unsigned int getAudioSamples();
 
+		/**
+		 * The audio stream's parameters and time base, the ones its packets are written in.
+		 */
+		const AVCodecParameters* getAudioCodecParameters() const;
+		AVRational getAudioTimeBase() const;
+
+		LatencyStatistics latencyStatistics() const;
+		InterleaveStatistics interleaveStatistics() const;
+
+		/**
+		 * True while packets of mediaType wait in the interleaving queue for the other stream and fill more
+		 * than half of a cap. Feed the other stream before submitting more of this one.
+		 */
+		bool isBackpressured(const AVMediaType mediaType) const;
+
+		/**
+		 * Called on the encoding thread with every packet this encoder produces, in its stream's time base,
+		 * just before it is muxed. Keep a packet with newReference.
+		 */
+		void setPacketHandler(std::function<void(const MediaPacket& packet, const AVMediaType mediaType)> packetHandler);
+
 	private:
 		std::string outputPath;
 		VideoEncodeAttribute videoEncodeAttribute;
+		AudioEncodeAttribute audioEncodeAttribute;
 		ks::AudioFormat outputAudioFormat;
 
 		const AVOutputFormat *outputFormat = nullptr;
@@ -69,6 +231,17 @@ namespace ks
 		AVStream *videoStream = nullptr;
 		AVCodecContext *videoCodecContext = nullptr;
 
+		std::map<int64_t, int64_t> videoFrameSubmitTimes;
+		std::function<void(const MediaPacket& packet, const AVMediaType mediaType)> packetHandler;
+		LatencyStatistics _latencyStatistics;
+
+		std::deque<AVPacket*> interleaveQueues[2];
+		long long interleaveQueueBytes = 0;
+		InterleaveStatistics _interleaveStatistics;
+
+		int writeMuxedPacket(AVPacket *packet) noexcept;
+		int writeInterleavedPackets(const bool isFlushing) noexcept;
+		double queuedSeconds(const int queueIndex) const;
 		int encodeFrame(AVFrame *frame, AVCodecContext *codecContext, AVStream *steam) noexcept;
 	};
 }
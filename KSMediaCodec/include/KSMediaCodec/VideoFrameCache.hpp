@@ -0,0 +1,92 @@
+#ifndef KSMediaCodec_VideoFrameCache_hpp
+#define KSMediaCodec_VideoFrameCache_hpp
+
+#include <string>
+#include <list>
+#include <map>
+#include <mutex>
+#include <memory>
+#include <thread>
+#include <condition_variable>
+#include <Foundation/Foundation.hpp>
+#include "defs.hpp"
+#include "VideoDecoder.hpp"
+
+namespace ks
+{
+	/**
+	 * Converted frames of one file keyed by presentation time, for scrubbing.
+	 * Frames are evicted least recently used first so the cache never holds more than maxMemoryBytes.
+	 * With prefetchFrameCount > 0 a background decoder fills the frames following the last request
+	 * in the direction the caller is scrubbing.
+	 */
+	class KSMediaCodec_API VideoFrameCache : public noncopyable
+	{
+	public:
+		struct Statistics
+		{
+			unsigned long long hits = 0;
+			unsigned long long misses = 0;
+			unsigned long long evictions = 0;
+			unsigned long long prefetchedFrames = 0;
+			size_t frameCount = 0;
+			long long memoryUsage = 0;
+		};
+
+	public:
+		static VideoFrameCache* New(const std::string& filePath,
+			const ks::PixelBuffer::FormatType& formatType,
+			const long long maxMemoryBytes,
+			const unsigned int prefetchFrameCount = 0);
+		~VideoFrameCache();
+
+		/**
+		 * Returns the frame displayed at time, decoding it only on a miss. The buffer stays valid after eviction.
+		 */
+		std::shared_ptr<const ks::PixelBuffer> frameAt(const MediaTime& time, MediaTime& outPts);
+
+		void clear();
+		Statistics statistics();
+
+	private:
+		struct Entry
+		{
+			std::shared_ptr<const ks::PixelBuffer> pixelBuffer;
+			MediaTime endTime;
+			std::list<MediaTime>::iterator recentlyUsedPosition;
+		};
+
+		std::unique_ptr<VideoDecoder> decoder;
+		std::mutex decoderMutex;
+		MediaTime frameDuration;
+		long long frameBytes = 0;
+		long long maxMemoryBytes = 0;
+		unsigned int prefetchFrameCount = 0;
+
+		std::mutex mutex;
+		std::map<MediaTime, Entry> entries;
+		std::list<MediaTime> recentlyUsed;
+		long long memoryUsage = 0;
+		Statistics _statistics;
+
+		std::unique_ptr<VideoDecoder> prefetchDecoder;
+		std::thread prefetchThread;
+		std::condition_variable prefetchCondition;
+		bool hasPrefetchRequest = false;
+		bool isStopping = false;
+		unsigned long long prefetchGeneration = 0;
+		MediaTime prefetchAnchor;
+		int scrubDirection = 1;
+		MediaTime lastRequestTime;
+		bool hasLastRequest = false;
+
+	private:
+		std::shared_ptr<const ks::PixelBuffer> lookup(const MediaTime& time, MediaTime& outPts);
+		bool contains(const MediaTime& time);
+		void insert(const MediaTime& pts, std::shared_ptr<const ks::PixelBuffer> pixelBuffer);
+		void requestPrefetch(const MediaTime& anchor);
+		void prefetchLoop();
+	};
+}
+
+#endif // KSMediaCodec_VideoFrameCache_hpp
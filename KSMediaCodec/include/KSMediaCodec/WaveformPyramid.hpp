@@ -0,0 +1,83 @@
+#ifndef KSMediaCodec_WaveformPyramid_hpp
+#define KSMediaCodec_WaveformPyramid_hpp
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <Foundation/Foundation.hpp>
+#include "defs.hpp"
+#include "MappedFile.hpp"
+
+namespace ks
+{
+	/**
+	 * Min, max and RMS per channel at power-of-two zoom levels. The finest level covers samplesPerBin samples
+	 * per bin and each further level halves the bin count. The on-disk layout is the in-memory layout, so a saved
+	 * pyramid is reopened by mapping the file.
+	 */
+	class KSMediaCodec_API WaveformPyramid : public noncopyable
+	{
+	public:
+		struct Peak
+		{
+			float min = 0.0f;
+			float max = 0.0f;
+			float rms = 0.0f;
+		};
+
+	public:
+		/**
+		 * Decodes filePath once as planar float at sampleRate and channels. samplesPerBin must be a power of two.
+		 * threadCount 0 uses one thread per hardware thread.
+		 */
+		static WaveformPyramid* New(const std::string& filePath,
+			const unsigned int sampleRate,
+			const unsigned int channels,
+			const unsigned int samplesPerBin = 256,
+			const unsigned int threadCount = 0);
+
+		/**
+		 * Maps a pyramid written by save, nullptr when the file is missing or not a pyramid.
+		 */
+		static WaveformPyramid* Open(const std::string& cachePath);
+
+		/**
+		 * Opens cachePath when it was built from the current filePath with the same parameters,
+		 * otherwise builds the pyramid and saves it to cachePath.
+		 */
+		static WaveformPyramid* NewCached(const std::string& filePath,
+			const std::string& cachePath,
+			const unsigned int sampleRate,
+			const unsigned int channels,
+			const unsigned int samplesPerBin = 256,
+			const unsigned int threadCount = 0);
+
+		~WaveformPyramid();
+
+		bool save(const std::string& cachePath) const;
+
+		unsigned int getSampleRate() const;
+		unsigned int channelCount() const;
+		long long sampleCount() const;
+		unsigned int getSamplesPerBin() const;
+		unsigned int levelCount() const;
+
+		/**
+		 * Resizes outPeaks to pixelCount and fills one peak per pixel over [startSample, endSample)
+		 * from the coarsest level that still resolves a pixel, in O(pixelCount).
+		 */
+		void peaks(const unsigned int channel,
+			const long long startSample,
+			const long long endSample,
+			const unsigned int pixelCount,
+			std::vector<Peak>& outPeaks) const;
+
+	private:
+		std::vector<unsigned char> storage;
+		std::unique_ptr<MappedFile> mappedFile;
+		const unsigned char* bytes = nullptr;
+		size_t byteCount = 0;
+	};
+}
+
+#endif // KSMediaCodec_WaveformPyramid_hpp
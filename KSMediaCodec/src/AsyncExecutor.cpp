@@ -0,0 +1,28 @@
+#include "AsyncExecutor.hpp"
+#include <algorithm>
+
+#if defined(KSMediaCodec_ENABLE_COROUTINE) && defined(__cpp_impl_coroutine)
+
+namespace ks
+{
+	AsyncExecutor::AsyncExecutor(const unsigned int ioThreadCount, const unsigned int computeThreadCount)
+		: ioPool(std::max(ioThreadCount, 1u)), computePool(computeThreadCount)
+	{
+	}
+
+	AsyncExecutor::~AsyncExecutor()
+	{
+	}
+
+	unsigned int AsyncExecutor::ioThreadCount() const
+	{
+		return ioPool.threadCount();
+	}
+
+	unsigned int AsyncExecutor::computeThreadCount() const
+	{
+		return computePool.threadCount();
+	}
+}
+
+#endif // KSMediaCodec_ENABLE_COROUTINE
@@ -0,0 +1,66 @@
+#include "AsyncVideoDecoder.hpp"
+
+#if defined(KSMediaCodec_ENABLE_COROUTINE) && defined(__cpp_impl_coroutine)
+
+namespace ks
+{
+	AsyncTask<std::unique_ptr<AsyncVideoDecoder>> AsyncVideoDecoder::open(AsyncExecutor & executor,
+		std::string filePath,
+		ks::PixelBuffer::FormatType formatType,
+		DecoderOpenOptions options)
+	{
+		std::unique_ptr<VideoDecoder> decoder = co_await executor.runIO([&]()
+		{
+			return std::unique_ptr<VideoDecoder>(VideoDecoder::New(filePath, formatType, options));
+		});
+		if (decoder == nullptr)
+		{
+			co_return nullptr;
+		}
+		co_return std::unique_ptr<AsyncVideoDecoder>(new AsyncVideoDecoder(executor, std::move(decoder)));
+	}
+
+	AsyncVideoDecoder::AsyncVideoDecoder(AsyncExecutor & executor, std::unique_ptr<VideoDecoder> decoder)
+		: executor(executor), decoder(std::move(decoder))
+	{
+	}
+
+	AsyncVideoDecoder::~AsyncVideoDecoder()
+	{
+	}
+
+	AsyncTask<AsyncVideoDecoder::Frame> AsyncVideoDecoder::nextFrame()
+	{
+		co_return co_await executor.runCompute([this]()
+		{
+			Frame frame;
+			frame.pixelBuffer = std::unique_ptr<ks::PixelBuffer>(decoder->newFrame(frame.pts));
+			return frame;
+		});
+	}
+
+	AsyncTask<AsyncVideoDecoder::Frame> AsyncVideoDecoder::frameAt(MediaTime time)
+	{
+		co_return co_await executor.runCompute([this, time]()
+		{
+			Frame frame;
+			frame.pixelBuffer = std::unique_ptr<ks::PixelBuffer>(decoder->newFrameAt(time, frame.pts));
+			return frame;
+		});
+	}
+
+	AsyncTask<bool> AsyncVideoDecoder::seek(MediaTime time)
+	{
+		co_return co_await executor.runIO([this, time]()
+		{
+			return decoder->seek(time);
+		});
+	}
+
+	VideoDecoder & AsyncVideoDecoder::getDecoder()
+	{
+		return *decoder;
+	}
+}
+
+#endif // KSMediaCodec_ENABLE_COROUTINE
@@ -0,0 +1,63 @@
+#include "AsyncVideoFileEncoder.hpp"
+
+#if defined(KSMediaCodec_ENABLE_COROUTINE) && defined(__cpp_impl_coroutine)
+
+namespace ks
+{
+	AsyncTask<std::unique_ptr<AsyncVideoFileEncoder>> AsyncVideoFileEncoder::open(AsyncExecutor & executor,
+		std::string outputPath,
+		VideoFileEncoder::VideoEncodeAttribute videoEncodeAttribute,
+		VideoFileEncoder::AudioEncodeAttribute audioEncodeAttribute,
+		ks::AudioFormat outputAudioFormat)
+	{
+		std::unique_ptr<VideoFileEncoder> encoder = co_await executor.runIO([&]()
+		{
+			return std::unique_ptr<VideoFileEncoder>(VideoFileEncoder::New(outputPath, videoEncodeAttribute, audioEncodeAttribute, outputAudioFormat, nullptr));
+		});
+		if (encoder == nullptr)
+		{
+			co_return nullptr;
+		}
+		co_return std::unique_ptr<AsyncVideoFileEncoder>(new AsyncVideoFileEncoder(executor, std::move(encoder)));
+	}
+
+	AsyncVideoFileEncoder::AsyncVideoFileEncoder(AsyncExecutor & executor, std::unique_ptr<VideoFileEncoder> encoder)
+		: executor(executor), encoder(std::move(encoder))
+	{
+	}
+
+	AsyncVideoFileEncoder::~AsyncVideoFileEncoder()
+	{
+	}
+
+	AsyncTask<void> AsyncVideoFileEncoder::encode(std::shared_ptr<const ks::PixelBuffer> pixelBuffer, ks::MediaTime pts)
+	{
+		co_await executor.runCompute([this, &pixelBuffer, &pts]()
+		{
+			encoder->encode(*pixelBuffer, pts);
+		});
+	}
+
+	AsyncTask<void> AsyncVideoFileEncoder::encode(std::shared_ptr<const ks::AudioPCMBuffer> pcmBuffer, ks::MediaTime pts)
+	{
+		co_await executor.runCompute([this, &pcmBuffer, &pts]()
+		{
+			encoder->encode(*pcmBuffer, pts);
+		});
+	}
+
+	AsyncTask<void> AsyncVideoFileEncoder::encodeTail()
+	{
+		co_await executor.runIO([this]()
+		{
+			encoder->encodeTail();
+		});
+	}
+
+	VideoFileEncoder & AsyncVideoFileEncoder::getEncoder()
+	{
+		return *encoder;
+	}
+}
+
+#endif // KSMediaCodec_ENABLE_COROUTINE
@@ -1,19 +1,134 @@
 #include "AudioDecoder.hpp"
+#include "DecoderOpen.hpp"
+#include "AudioKernels.hpp"
 #include <assert.h>
 #include <functional>
+#include <algorithm>
+#include <cstring>
 
 namespace ks
 {
-	AudioDecoder * AudioDecoder::New(const std::string& filePath, const ks::AudioFormat& format)
+	namespace
 	{
+		/**
+		 * Pairs convertSamplesDirectly handles: one step of interleaving or of s16/float conversion.
+		 */
+		bool isDirectConversion(const AVSampleFormat sourceFormat, const AVSampleFormat targetFormat)
+		{
+			switch (sourceFormat)
+			{
+			case AV_SAMPLE_FMT_FLTP:
+				return targetFormat == AV_SAMPLE_FMT_FLTP || targetFormat == AV_SAMPLE_FMT_FLT || targetFormat == AV_SAMPLE_FMT_S16P;
+			case AV_SAMPLE_FMT_FLT:
+				return targetFormat == AV_SAMPLE_FMT_FLT || targetFormat == AV_SAMPLE_FMT_FLTP || targetFormat == AV_SAMPLE_FMT_S16;
+			case AV_SAMPLE_FMT_S16P:
+				return targetFormat == AV_SAMPLE_FMT_S16P || targetFormat == AV_SAMPLE_FMT_S16 || targetFormat == AV_SAMPLE_FMT_FLTP;
+			case AV_SAMPLE_FMT_S16:
+				return targetFormat == AV_SAMPLE_FMT_S16 || targetFormat == AV_SAMPLE_FMT_S16P || targetFormat == AV_SAMPLE_FMT_FLT;
+			default:
+				return false;
+			}
+		}
+
+		bool convertSamplesDirectly(const uint8_t* const* source, const AVSampleFormat sourceFormat,
+			uint8_t* const* target, const AVSampleFormat targetFormat,
+			const int channels, const int sampleCount)
+		{
+			const size_t frames = (size_t)sampleCount;
+			if (sourceFormat == targetFormat)
+			{
+				const int planes = av_sample_fmt_is_planar(sourceFormat) ? channels : 1;
+				const size_t planeSize = (size_t)av_get_bytes_per_sample(sourceFormat) * frames * (planes == 1 ? channels : 1);
+				for (int i = 0; i < planes; i++)
+				{
+					memcpy(target[i], source[i], planeSize);
+				}
+				return true;
+			}
+
+			const float* const* floatPlanes = reinterpret_cast<const float* const*>(source);
+			const int16_t* const* shortPlanes = reinterpret_cast<const int16_t* const*>(source);
+			float* const* outFloatPlanes = reinterpret_cast<float* const*>(target);
+			int16_t* const* outShortPlanes = reinterpret_cast<int16_t* const*>(target);
+			switch (sourceFormat)
+			{
+			case AV_SAMPLE_FMT_FLTP:
+				if (targetFormat == AV_SAMPLE_FMT_FLT)
+				{
+					interleaveSamples(floatPlanes, channels, frames, outFloatPlanes[0]);
+					return true;
+				}
+				if (targetFormat == AV_SAMPLE_FMT_S16P)
+				{
+					for (int i = 0; i < channels; i++)
+					{
+						convertSamples(floatPlanes[i], frames, outShortPlanes[i]);
+					}
+					return true;
+				}
+				break;
+			case AV_SAMPLE_FMT_FLT:
+				if (targetFormat == AV_SAMPLE_FMT_FLTP)
+				{
+					deinterleaveSamples(floatPlanes[0], channels, frames, outFloatPlanes);
+					return true;
+				}
+				if (targetFormat == AV_SAMPLE_FMT_S16)
+				{
+					convertSamples(floatPlanes[0], frames * channels, outShortPlanes[0]);
+					return true;
+				}
+				break;
+			case AV_SAMPLE_FMT_S16P:
+				if (targetFormat == AV_SAMPLE_FMT_S16)
+				{
+					interleaveSamples(shortPlanes, channels, frames, outShortPlanes[0]);
+					return true;
+				}
+				if (targetFormat == AV_SAMPLE_FMT_FLTP)
+				{
+					for (int i = 0; i < channels; i++)
+					{
+						convertSamples(shortPlanes[i], frames, outFloatPlanes[i]);
+					}
+					return true;
+				}
+				break;
+			case AV_SAMPLE_FMT_S16:
+				if (targetFormat == AV_SAMPLE_FMT_S16P)
+				{
+					deinterleaveSamples(shortPlanes[0], channels, frames, outShortPlanes);
+					return true;
+				}
+				if (targetFormat == AV_SAMPLE_FMT_FLT)
+				{
+					convertSamples(shortPlanes[0], frames * channels, outFloatPlanes[0]);
+					return true;
+				}
+				break;
+			default:
+				break;
+			}
+			return false;
+		}
+	}
+
+	AudioDecoder * AudioDecoder::New(const std::string& filePath, const ks::AudioFormat& format, const DecoderOpenOptions& options)
+	{
+		const int64_t openStartTime = av_gettime_relative();
 		SwrContext *swrctx = nullptr;
 		AVFormatContext *formatContext = nullptr;
 		AVStream *audioStream = nullptr;
 		AVCodecContext *audioCodecCtx = nullptr;
 		AVCodec *codec = nullptr;
 		int audioStreamIndex = -1;
+		AVAudioFifo *sampleFifo = nullptr;
 		std::function<void()> cleanClosure = [&]()
 		{
+			if (sampleFifo)
+			{
+				av_audio_fifo_free(sampleFifo);
+			}
 			if (swrctx)
 			{
 				swr_close(swrctx);
@@ -42,29 +157,12 @@ namespace ks
 			return nullptr;
 		}
 
-		if (avformat_open_input(&formatContext, filePath.c_str(), nullptr, nullptr) != 0)
-		{
-			return nullptr;
-		}
-
-		if (avformat_find_stream_info(formatContext, nullptr) < 0)
-		{
-			return nullptr;
-		}
-
-		for (unsigned int i = 0; i < formatContext->nb_streams; i++)
-		{
-			if (formatContext->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_AUDIO)
-			{
-				audioStreamIndex = i;
-				audioStream = formatContext->streams[i];
-				break;
-			}
-		}
-		if (audioStreamIndex == -1)
+		audioStreamIndex = openDecoderInput(formatContext, filePath, AVMEDIA_TYPE_AUDIO, options);
+		if (audioStreamIndex < 0)
 		{
 			return nullptr;
 		}
+		audioStream = formatContext->streams[audioStreamIndex];
 
 		codec = avcodec_find_decoder(audioStream->codecpar->codec_id);
 
@@ -88,6 +186,10 @@ namespace ks
 		}
 
 		AVSampleFormat sampleFormat = AudioDecoder::getAVSampleFormat(format);
+		if (audioCodecCtx->channel_layout == 0)
+		{
+			audioCodecCtx->channel_layout = av_get_default_channel_layout(audioCodecCtx->channels);
+		}
 
 		swrctx = swr_alloc_set_opts(swrctx,
 			av_get_default_channel_layout(format.channelsPerFrame), sampleFormat, format.sampleRate,
@@ -103,6 +205,12 @@ namespace ks
 			return nullptr;
 		}
 
+		sampleFifo = av_audio_fifo_alloc(sampleFormat, format.channelsPerFrame, format.sampleRate);
+		if (sampleFifo == nullptr)
+		{
+			return nullptr;
+		}
+
 		AudioDecoder* audioDecoder = new AudioDecoder();
 		audioDecoder->filePath = filePath;
 		audioDecoder->outputAudioFormat = format;
@@ -112,6 +220,10 @@ namespace ks
 		audioDecoder->audioCodecCtx = audioCodecCtx;
 		audioDecoder->codec = codec;
 		audioDecoder->audioStreamIndex = audioStreamIndex;
+		audioDecoder->openStartTime = openStartTime;
+		audioDecoder->openEndTime = av_gettime_relative();
+		audioDecoder->sampleFifo = sampleFifo;
+		audioDecoder->convertedSamples.resize(std::max<unsigned int>(format.channelsPerFrame, 1), nullptr);
 		cleanClosure = []() {};
 		return audioDecoder;
 	}
@@ -125,6 +237,9 @@ namespace ks
 		swr_close(swrctx);
 		swr_free(&swrctx);
 
+		av_audio_fifo_free(sampleFifo);
+		av_freep(&convertedSamples[0]);
+
 		avcodec_close(audioCodecCtx);
 		avcodec_free_context(&audioCodecCtx);
 
@@ -139,6 +254,7 @@ namespace ks
 
 	ks::AudioPCMBuffer* AudioDecoder::newFrame(MediaTimeRange& outTimeRange)
 	{
+		isSampleFifoValid = false;
 		AVFrame *frame = av_frame_alloc();
 		AVPacket *packet = av_packet_alloc();
 		defer
@@ -167,6 +283,10 @@ namespace ks
 					if (buffer)
 					{
 						_lastDecodedAudioChunkDisplayTime = outTimeRange.start;
+						if (firstFrameTime == AV_NOPTS_VALUE)
+						{
+							firstFrameTime = av_gettime_relative();
+						}
 					}
 					return buffer;
 				}
@@ -189,14 +309,254 @@ namespace ks
 			return seekResult;
 		}
 		avcodec_flush_buffers(audioCodecCtx);
+		isSampleFifoValid = false;
 		return 1;
 	}
 
+	int AudioDecoder::readSamples(const MediaTimeRange & timeRange, ks::AudioPCMBuffer & outBuffer)
+	{
+		const int sampleRate = outputAudioFormat.sampleRate;
+		const int64_t startSample = av_rescale(timeRange.start.timeValue(), sampleRate, timeRange.start.timeScale());
+		const int64_t endSample = av_rescale(timeRange.end.timeValue(), sampleRate, timeRange.end.timeScale());
+		const int sampleCount = (int)std::min<int64_t>(endSample - startSample, outBuffer.samplesPerChannel());
+		if (sampleCount <= 0)
+		{
+			return 0;
+		}
+
+		const int64_t fifoEndSample = sampleFifoStartSample + av_audio_fifo_size(sampleFifo);
+		const bool isContinuous = isSampleFifoValid
+			&& sampleFifoStartSample != AV_NOPTS_VALUE
+			&& startSample >= sampleFifoStartSample
+			&& startSample <= fifoEndSample + sampleRate;
+		if (isContinuous == false)
+		{
+			int status = seekSamples(startSample);
+			if (status < 0)
+			{
+				return status;
+			}
+		}
+
+		while (isSampleStreamFinished == false
+			&& (sampleFifoStartSample == AV_NOPTS_VALUE || sampleFifoStartSample + av_audio_fifo_size(sampleFifo) < startSample + sampleCount))
+		{
+			if (decodeSamples() < 0)
+			{
+				isSampleStreamFinished = true;
+			}
+			discardSamplesBefore(startSample);
+		}
+		discardSamplesBefore(startSample);
+
+		const AVSampleFormat sampleFormat = getAVSampleFormat(outputAudioFormat);
+		const int channels = outputAudioFormat.channelsPerFrame;
+		const bool isPlanar = av_sample_fmt_is_planar(sampleFormat);
+		const int planes = isPlanar ? channels : 1;
+		const int bytesPerFrame = av_get_bytes_per_sample(sampleFormat) * (isPlanar ? 1 : channels);
+		unsigned char** channelData = outBuffer.channelData();
+		std::vector<uint8_t*> outSamples(planes, nullptr);
+		auto offsetSamples = [&](const int offset)
+		{
+			for (int i = 0; i < planes; i++)
+			{
+				outSamples[i] = channelData[i] + (size_t)offset * bytesPerFrame;
+			}
+		};
+
+		int writtenSamples = 0;
+		if (sampleFifoStartSample != AV_NOPTS_VALUE && sampleFifoStartSample > startSample)
+		{
+			writtenSamples = (int)std::min<int64_t>(sampleCount, sampleFifoStartSample - startSample);
+			offsetSamples(0);
+			av_samples_set_silence(outSamples.data(), 0, writtenSamples, channels, sampleFormat);
+		}
+
+		const int copySamples = std::min(sampleCount - writtenSamples, av_audio_fifo_size(sampleFifo));
+		if (copySamples > 0)
+		{
+			offsetSamples(writtenSamples);
+			av_audio_fifo_read(sampleFifo, reinterpret_cast<void**>(outSamples.data()), copySamples);
+			sampleFifoStartSample += copySamples;
+			writtenSamples += copySamples;
+		}
+		if (writtenSamples > 0)
+		{
+			_lastDecodedAudioChunkDisplayTime = timeRange.start;
+		}
+		return writtenSamples;
+	}
+
+	int AudioDecoder::seekSamples(const int64_t sampleIndex)
+	{
+		const int sampleRate = outputAudioFormat.sampleRate;
+		const int64_t codecPrerollSamples = audioStream->codecpar->sample_rate > 0
+			? av_rescale(audioStream->codecpar->seek_preroll, sampleRate, audioStream->codecpar->sample_rate)
+			: 0;
+		const int64_t prerollSamples = std::max<int64_t>(codecPrerollSamples, sampleRate / 10);
+		const int64_t seekSample = std::max<int64_t>(sampleIndex - prerollSamples, 0);
+		const int64_t timestamp = av_rescale_q(seekSample, MediaTime(1, sampleRate).getRational(), audioStream->time_base);
+		int status = av_seek_frame(formatContext, audioStreamIndex, timestamp, AVSEEK_FLAG_BACKWARD);
+		if (status < 0)
+		{
+			return status;
+		}
+		avcodec_flush_buffers(audioCodecCtx);
+		if ((status = swr_init(swrctx)) < 0)
+		{
+			return status;
+		}
+		av_audio_fifo_reset(sampleFifo);
+		sampleFifoStartSample = AV_NOPTS_VALUE;
+		isSampleFifoValid = true;
+		isSampleDecoderDraining = false;
+		isSampleStreamFinished = false;
+		return 0;
+	}
+
+	int AudioDecoder::decodeSamples()
+	{
+		AVFrame *frame = av_frame_alloc();
+		AVPacket *packet = av_packet_alloc();
+		defer
+		{
+			av_packet_free(&packet);
+			av_frame_free(&frame);
+		};
+
+		while (true)
+		{
+			if (isSampleDecoderDraining == false)
+			{
+				if (av_read_frame(formatContext, packet) < 0)
+				{
+					av_packet_unref(packet);
+					isSampleDecoderDraining = true;
+				}
+				else if (packet->stream_index != audioStreamIndex)
+				{
+					av_packet_unref(packet);
+					continue;
+				}
+			}
+
+			int gotFrame = 0;
+			avcodec_decode_audio4(audioCodecCtx, frame, &gotFrame, packet);
+			av_packet_unref(packet);
+			if (gotFrame)
+			{
+				if (sampleFifoStartSample == AV_NOPTS_VALUE)
+				{
+					int64_t timestamp = frame->best_effort_timestamp == AV_NOPTS_VALUE ? frame->pts : frame->best_effort_timestamp;
+					sampleFifoStartSample = timestamp == AV_NOPTS_VALUE
+						? 0
+						: av_rescale_q(timestamp, audioStream->time_base, MediaTime(1, (int)outputAudioFormat.sampleRate).getRational());
+				}
+				appendConvertedSamples(frame);
+				av_frame_unref(frame);
+				return 0;
+			}
+			if (isSampleDecoderDraining)
+			{
+				appendConvertedSamples(nullptr);
+				return AVERROR_EOF;
+			}
+		}
+	}
+
+	bool AudioDecoder::canConvertDirectly(const AVFrame * frame) const
+	{
+		const int channels = (int)outputAudioFormat.channelsPerFrame;
+		if (frame->sample_rate != (int)outputAudioFormat.sampleRate || frame->channels != channels)
+		{
+			return false;
+		}
+		if (frame->channel_layout != 0 && frame->channel_layout != (uint64_t)av_get_default_channel_layout(channels))
+		{
+			return false;
+		}
+		const AVSampleFormat sourceFormat = (AVSampleFormat)frame->format;
+		const AVSampleFormat targetFormat = getAVSampleFormat(outputAudioFormat);
+		return sourceFormat == targetFormat || isDirectConversion(sourceFormat, targetFormat);
+	}
+
+	void AudioDecoder::appendConvertedSamples(const AVFrame * frame)
+	{
+		const AVSampleFormat sampleFormat = getAVSampleFormat(outputAudioFormat);
+		const bool isDirect = frame && canConvertDirectly(frame);
+		if (isDirect && (AVSampleFormat)frame->format == sampleFormat)
+		{
+			av_audio_fifo_write(sampleFifo, reinterpret_cast<void**>(frame->extended_data), frame->nb_samples);
+			return;
+		}
+
+		const int sampleCount = frame ? frame->nb_samples : 0;
+		const int outSampleCount = isDirect ? sampleCount : swr_get_out_samples(swrctx, sampleCount);
+		if (outSampleCount <= 0)
+		{
+			return;
+		}
+		if (outSampleCount > convertedSamplesCapacity)
+		{
+			av_freep(&convertedSamples[0]);
+			if (av_samples_alloc(convertedSamples.data(), nullptr, outputAudioFormat.channelsPerFrame, outSampleCount, sampleFormat, 0) < 0)
+			{
+				convertedSamplesCapacity = 0;
+				return;
+			}
+			convertedSamplesCapacity = outSampleCount;
+		}
+
+		int convertedSampleCount = 0;
+		if (isDirect)
+		{
+			if (convertSamplesDirectly(frame->extended_data, (AVSampleFormat)frame->format,
+				convertedSamples.data(), sampleFormat, frame->channels, sampleCount))
+			{
+				convertedSampleCount = sampleCount;
+			}
+		}
+		else
+		{
+			const uint8_t** samples = frame ? const_cast<const uint8_t**>(frame->extended_data) : nullptr;
+			convertedSampleCount = swr_convert(swrctx, convertedSamples.data(), outSampleCount, samples, sampleCount);
+		}
+		if (convertedSampleCount > 0)
+		{
+			av_audio_fifo_write(sampleFifo, reinterpret_cast<void**>(convertedSamples.data()), convertedSampleCount);
+		}
+	}
+
+	void AudioDecoder::discardSamplesBefore(const int64_t sampleIndex)
+	{
+		if (sampleFifoStartSample == AV_NOPTS_VALUE || sampleFifoStartSample >= sampleIndex)
+		{
+			return;
+		}
+		const int discardedSamples = (int)std::min<int64_t>(sampleIndex - sampleFifoStartSample, av_audio_fifo_size(sampleFifo));
+		av_audio_fifo_drain(sampleFifo, discardedSamples);
+		sampleFifoStartSample += discardedSamples;
+	}
+
 	MediaTime AudioDecoder::lastDecodedAudioChunkDisplayTime() const
 	{
 		return _lastDecodedAudioChunkDisplayTime;
 	}
 
+	MediaTime AudioDecoder::openDuration() const
+	{
+		return MediaTime((int)(openEndTime - openStartTime), AV_TIME_BASE);
+	}
+
+	MediaTime AudioDecoder::timeToFirstFrame() const
+	{
+		if (firstFrameTime == AV_NOPTS_VALUE)
+		{
+			return MediaTime(-1.0, 600);
+		}
+		return MediaTime((int)(firstFrameTime - openStartTime), AV_TIME_BASE);
+	}
+
 	MediaTime AudioDecoder::fps() const
 	{
 		if (audioStream)
@@ -214,10 +574,15 @@ namespace ks
 		if (ret >= 0)
 		{
 			ks::AudioPCMBuffer* outPCMBuffer = new ks::AudioPCMBuffer(outputAudioFormat, frame->nb_samples);
-			const uint8_t ** source = const_cast<const uint8_t **>(frame->data);
-			ret = swr_convert(swrctx,
-				outPCMBuffer->channelData(), frame->nb_samples,
-				source, frame->nb_samples);
+			if (canConvertDirectly(frame) == false
+				|| convertSamplesDirectly(frame->extended_data, (AVSampleFormat)frame->format,
+					outPCMBuffer->channelData(), getAVSampleFormat(outputAudioFormat), frame->channels, frame->nb_samples) == false)
+			{
+				const uint8_t ** source = const_cast<const uint8_t **>(frame->data);
+				ret = swr_convert(swrctx,
+					outPCMBuffer->channelData(), frame->nb_samples,
+					source, frame->nb_samples);
+			}
 			outTimeRange = MediaTimeRange(MediaTime((int)frame->pts, frame->sample_rate), MediaTime((int)frame->pts + (int)frame->nb_samples, frame->sample_rate));
 			return outPCMBuffer;
 		}
@@ -229,45 +594,29 @@ namespace ks
 
 	AVSampleFormat AudioDecoder::getAVSampleFormat(const ks::AudioFormat & format) noexcept
 	{
+		// [isFloat][16, 32, 64 bits][isNonInterleaved]
+		static constexpr AVSampleFormat sampleFormats[2][3][2] =
+		{
+			{
+				{ AV_SAMPLE_FMT_S16, AV_SAMPLE_FMT_S16P },
+				{ AV_SAMPLE_FMT_S32, AV_SAMPLE_FMT_S32P },
+				{ AV_SAMPLE_FMT_NONE, AV_SAMPLE_FMT_NONE },
+			},
+			{
+				{ AV_SAMPLE_FMT_NONE, AV_SAMPLE_FMT_NONE },
+				{ AV_SAMPLE_FMT_FLT, AV_SAMPLE_FMT_FLTP },
+				{ AV_SAMPLE_FMT_DBL, AV_SAMPLE_FMT_DBLP },
+			},
+		};
 
-		bool isSignedInteger = format.isSignedInteger();
-		bool isFloat = format.isFloat();
-		bool isNonInterleaved = format.isNonInterleaved();
+		const bool isFloat = format.isFloat();
+		const int depthIndex = format.bitsPerChannel == 16 ? 0 : format.bitsPerChannel == 32 ? 1 : format.bitsPerChannel == 64 ? 2 : -1;
 		AVSampleFormat sampleFormat = AV_SAMPLE_FMT_NONE;
-
-		if (isSignedInteger && format.bitsPerChannel == 16 && isNonInterleaved)
-		{
-			sampleFormat = AV_SAMPLE_FMT_S16P;
-		}
-		if (isSignedInteger && format.bitsPerChannel == 16 && isNonInterleaved == false)
-		{
-			sampleFormat = AV_SAMPLE_FMT_S16;
-		}
-		if (isSignedInteger && format.bitsPerChannel == 32 && isNonInterleaved)
-		{
-			sampleFormat = AV_SAMPLE_FMT_S32P;
-		}
-		if (isSignedInteger && format.bitsPerChannel == 32 && isNonInterleaved == false)
-		{
-			sampleFormat = AV_SAMPLE_FMT_S32;
-		}
-		if (isFloat && format.bitsPerChannel == 32 && isNonInterleaved)
-		{
-			sampleFormat = AV_SAMPLE_FMT_FLTP;
-		}
-		if (isFloat && format.bitsPerChannel == 32 && isNonInterleaved == false)
-		{
-			sampleFormat = AV_SAMPLE_FMT_FLT;
-		}
-		if (isFloat && format.bitsPerChannel == 64 && isNonInterleaved)
-		{
-			sampleFormat = AV_SAMPLE_FMT_DBLP;
-		}
-		if (isFloat && format.bitsPerChannel == 64 && isNonInterleaved == false)
+		if (depthIndex >= 0 && (isFloat || format.isSignedInteger()))
 		{
-			sampleFormat = AV_SAMPLE_FMT_DBL;
+			sampleFormat = sampleFormats[isFloat ? 1 : 0][depthIndex][format.isNonInterleaved() ? 1 : 0];
 		}
 		assert(sampleFormat != AV_SAMPLE_FMT_NONE);
 		return sampleFormat;
 	}
-}
\ No newline at end of file
+}
@@ -0,0 +1,331 @@
+#include "AudioKernels.hpp"
+#include <algorithm>
+#include <cmath>
+#include "Simd.hpp"
+
+namespace ks
+{
+	void reduceSamplePeaks(const float * samples, const size_t count, float & outMin, float & outMax, float & outSumSquares) noexcept
+	{
+		if (count == 0)
+		{
+			outMin = 0.0f;
+			outMax = 0.0f;
+			outSumSquares = 0.0f;
+			return;
+		}
+
+		float minValue = samples[0];
+		float maxValue = samples[0];
+		float sumSquares = 0.0f;
+		size_t i = 0;
+
+#if defined(KSMediaCodec_SIMD_SSE2)
+		if (count >= 4)
+		{
+			__m128 minVector = _mm_loadu_ps(samples);
+			__m128 maxVector = minVector;
+			__m128 sumVector = _mm_setzero_ps();
+			for (; i + 4 <= count; i += 4)
+			{
+				const __m128 value = _mm_loadu_ps(samples + i);
+				minVector = _mm_min_ps(minVector, value);
+				maxVector = _mm_max_ps(maxVector, value);
+				sumVector = _mm_add_ps(sumVector, _mm_mul_ps(value, value));
+			}
+			alignas(16) float minLanes[4];
+			alignas(16) float maxLanes[4];
+			alignas(16) float sumLanes[4];
+			_mm_store_ps(minLanes, minVector);
+			_mm_store_ps(maxLanes, maxVector);
+			_mm_store_ps(sumLanes, sumVector);
+			minValue = std::min(std::min(minLanes[0], minLanes[1]), std::min(minLanes[2], minLanes[3]));
+			maxValue = std::max(std::max(maxLanes[0], maxLanes[1]), std::max(maxLanes[2], maxLanes[3]));
+			sumSquares = (sumLanes[0] + sumLanes[1]) + (sumLanes[2] + sumLanes[3]);
+		}
+#elif defined(KSMediaCodec_SIMD_NEON)
+		if (count >= 4)
+		{
+			float32x4_t minVector = vld1q_f32(samples);
+			float32x4_t maxVector = minVector;
+			float32x4_t sumVector = vdupq_n_f32(0.0f);
+			for (; i + 4 <= count; i += 4)
+			{
+				const float32x4_t value = vld1q_f32(samples + i);
+				minVector = vminq_f32(minVector, value);
+				maxVector = vmaxq_f32(maxVector, value);
+				sumVector = vmlaq_f32(sumVector, value, value);
+			}
+			float minLanes[4];
+			float maxLanes[4];
+			float sumLanes[4];
+			vst1q_f32(minLanes, minVector);
+			vst1q_f32(maxLanes, maxVector);
+			vst1q_f32(sumLanes, sumVector);
+			minValue = std::min(std::min(minLanes[0], minLanes[1]), std::min(minLanes[2], minLanes[3]));
+			maxValue = std::max(std::max(maxLanes[0], maxLanes[1]), std::max(maxLanes[2], maxLanes[3]));
+			sumSquares = (sumLanes[0] + sumLanes[1]) + (sumLanes[2] + sumLanes[3]);
+		}
+#endif
+
+		for (; i < count; i++)
+		{
+			const float value = samples[i];
+			minValue = std::min(minValue, value);
+			maxValue = std::max(maxValue, value);
+			sumSquares += value * value;
+		}
+		outMin = minValue;
+		outMax = maxValue;
+		outSumSquares = sumSquares;
+	}
+
+	namespace
+	{
+		template<typename Sample>
+		void interleaveScalar(const Sample* const* planes, const int channels, const size_t frames, Sample* outSamples) noexcept
+		{
+			for (int channel = 0; channel < channels; channel++)
+			{
+				const Sample* plane = planes[channel];
+				Sample* target = outSamples + channel;
+				for (size_t frame = 0; frame < frames; frame++)
+				{
+					target[frame * channels] = plane[frame];
+				}
+			}
+		}
+
+		template<typename Sample>
+		void deinterleaveScalar(const Sample* samples, const int channels, const size_t frames, Sample* const* outPlanes) noexcept
+		{
+			for (int channel = 0; channel < channels; channel++)
+			{
+				const Sample* source = samples + channel;
+				Sample* plane = outPlanes[channel];
+				for (size_t frame = 0; frame < frames; frame++)
+				{
+					plane[frame] = source[frame * channels];
+				}
+			}
+		}
+	}
+
+	void interleaveSamples(const float * const * planes, const int channels, const size_t frames, float * outSamples) noexcept
+	{
+		size_t frame = 0;
+		if (channels == 2)
+		{
+			const float* left = planes[0];
+			const float* right = planes[1];
+#if defined(KSMediaCodec_SIMD_SSE2)
+			for (; frame + 4 <= frames; frame += 4)
+			{
+				const __m128 leftValue = _mm_loadu_ps(left + frame);
+				const __m128 rightValue = _mm_loadu_ps(right + frame);
+				_mm_storeu_ps(outSamples + frame * 2, _mm_unpacklo_ps(leftValue, rightValue));
+				_mm_storeu_ps(outSamples + frame * 2 + 4, _mm_unpackhi_ps(leftValue, rightValue));
+			}
+#elif defined(KSMediaCodec_SIMD_NEON)
+			for (; frame + 4 <= frames; frame += 4)
+			{
+				float32x4x2_t value;
+				value.val[0] = vld1q_f32(left + frame);
+				value.val[1] = vld1q_f32(right + frame);
+				vst2q_f32(outSamples + frame * 2, value);
+			}
+#endif
+			for (; frame < frames; frame++)
+			{
+				outSamples[frame * 2] = left[frame];
+				outSamples[frame * 2 + 1] = right[frame];
+			}
+			return;
+		}
+		interleaveScalar(planes, channels, frames, outSamples);
+	}
+
+	void interleaveSamples(const int16_t * const * planes, const int channels, const size_t frames, int16_t * outSamples) noexcept
+	{
+		size_t frame = 0;
+		if (channels == 2)
+		{
+			const int16_t* left = planes[0];
+			const int16_t* right = planes[1];
+#if defined(KSMediaCodec_SIMD_SSE2)
+			for (; frame + 8 <= frames; frame += 8)
+			{
+				const __m128i leftValue = _mm_loadu_si128(reinterpret_cast<const __m128i*>(left + frame));
+				const __m128i rightValue = _mm_loadu_si128(reinterpret_cast<const __m128i*>(right + frame));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(outSamples + frame * 2), _mm_unpacklo_epi16(leftValue, rightValue));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(outSamples + frame * 2 + 8), _mm_unpackhi_epi16(leftValue, rightValue));
+			}
+#elif defined(KSMediaCodec_SIMD_NEON)
+			for (; frame + 8 <= frames; frame += 8)
+			{
+				int16x8x2_t value;
+				value.val[0] = vld1q_s16(left + frame);
+				value.val[1] = vld1q_s16(right + frame);
+				vst2q_s16(outSamples + frame * 2, value);
+			}
+#endif
+			for (; frame < frames; frame++)
+			{
+				outSamples[frame * 2] = left[frame];
+				outSamples[frame * 2 + 1] = right[frame];
+			}
+			return;
+		}
+		interleaveScalar(planes, channels, frames, outSamples);
+	}
+
+	void deinterleaveSamples(const float * samples, const int channels, const size_t frames, float * const * outPlanes) noexcept
+	{
+		size_t frame = 0;
+		if (channels == 2)
+		{
+			float* left = outPlanes[0];
+			float* right = outPlanes[1];
+#if defined(KSMediaCodec_SIMD_SSE2)
+			for (; frame + 4 <= frames; frame += 4)
+			{
+				const __m128 low = _mm_loadu_ps(samples + frame * 2);
+				const __m128 high = _mm_loadu_ps(samples + frame * 2 + 4);
+				_mm_storeu_ps(left + frame, _mm_shuffle_ps(low, high, _MM_SHUFFLE(2, 0, 2, 0)));
+				_mm_storeu_ps(right + frame, _mm_shuffle_ps(low, high, _MM_SHUFFLE(3, 1, 3, 1)));
+			}
+#elif defined(KSMediaCodec_SIMD_NEON)
+			for (; frame + 4 <= frames; frame += 4)
+			{
+				const float32x4x2_t value = vld2q_f32(samples + frame * 2);
+				vst1q_f32(left + frame, value.val[0]);
+				vst1q_f32(right + frame, value.val[1]);
+			}
+#endif
+			for (; frame < frames; frame++)
+			{
+				left[frame] = samples[frame * 2];
+				right[frame] = samples[frame * 2 + 1];
+			}
+			return;
+		}
+		deinterleaveScalar(samples, channels, frames, outPlanes);
+	}
+
+	void deinterleaveSamples(const int16_t * samples, const int channels, const size_t frames, int16_t * const * outPlanes) noexcept
+	{
+		size_t frame = 0;
+		if (channels == 2)
+		{
+			int16_t* left = outPlanes[0];
+			int16_t* right = outPlanes[1];
+#if defined(KSMediaCodec_SIMD_NEON)
+			for (; frame + 8 <= frames; frame += 8)
+			{
+				const int16x8x2_t value = vld2q_s16(samples + frame * 2);
+				vst1q_s16(left + frame, value.val[0]);
+				vst1q_s16(right + frame, value.val[1]);
+			}
+#endif
+			for (; frame < frames; frame++)
+			{
+				left[frame] = samples[frame * 2];
+				right[frame] = samples[frame * 2 + 1];
+			}
+			return;
+		}
+		deinterleaveScalar(samples, channels, frames, outPlanes);
+	}
+
+	void convertSamples(const int16_t * samples, const size_t count, float * outSamples) noexcept
+	{
+		const float scale = 1.0f / 32768.0f;
+		size_t i = 0;
+#if defined(KSMediaCodec_SIMD_SSE2)
+		const __m128 scaleVector = _mm_set1_ps(scale);
+		for (; i + 8 <= count; i += 8)
+		{
+			const __m128i value = _mm_loadu_si128(reinterpret_cast<const __m128i*>(samples + i));
+			const __m128i low = _mm_srai_epi32(_mm_unpacklo_epi16(value, value), 16);
+			const __m128i high = _mm_srai_epi32(_mm_unpackhi_epi16(value, value), 16);
+			_mm_storeu_ps(outSamples + i, _mm_mul_ps(_mm_cvtepi32_ps(low), scaleVector));
+			_mm_storeu_ps(outSamples + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(high), scaleVector));
+		}
+#elif defined(KSMediaCodec_SIMD_NEON)
+		for (; i + 8 <= count; i += 8)
+		{
+			const int16x8_t value = vld1q_s16(samples + i);
+			vst1q_f32(outSamples + i, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(value))), scale));
+			vst1q_f32(outSamples + i + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(value))), scale));
+		}
+#endif
+		for (; i < count; i++)
+		{
+			outSamples[i] = samples[i] * scale;
+		}
+	}
+
+	void convertSamples(const float * samples, const size_t count, int16_t * outSamples) noexcept
+	{
+		size_t i = 0;
+#if defined(KSMediaCodec_SIMD_SSE2)
+		const __m128 scaleVector = _mm_set1_ps(32768.0f);
+		for (; i + 8 <= count; i += 8)
+		{
+			const __m128i low = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(samples + i), scaleVector));
+			const __m128i high = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(samples + i + 4), scaleVector));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(outSamples + i), _mm_packs_epi32(low, high));
+		}
+#elif defined(KSMediaCodec_SIMD_NEON)
+		for (; i + 8 <= count; i += 8)
+		{
+			const float32x4_t lowSamples = vmulq_n_f32(vld1q_f32(samples + i), 32768.0f);
+			const float32x4_t highSamples = vmulq_n_f32(vld1q_f32(samples + i + 4), 32768.0f);
+#if defined(__aarch64__)
+			const int32x4_t low = vcvtnq_s32_f32(lowSamples);
+			const int32x4_t high = vcvtnq_s32_f32(highSamples);
+#else
+			// ARMv7 only converts toward zero, so add 0.5 carrying each sample's sign first.
+			const uint32x4_t signMask = vdupq_n_u32(0x80000000u);
+			const float32x4_t half = vdupq_n_f32(0.5f);
+			const int32x4_t low = vcvtq_s32_f32(vaddq_f32(lowSamples, vbslq_f32(signMask, lowSamples, half)));
+			const int32x4_t high = vcvtq_s32_f32(vaddq_f32(highSamples, vbslq_f32(signMask, highSamples, half)));
+#endif
+			vst1q_s16(outSamples + i, vcombine_s16(vqmovn_s32(low), vqmovn_s32(high)));
+		}
+#endif
+		for (; i < count; i++)
+		{
+			const float value = std::nearbyint(samples[i] * 32768.0f);
+			outSamples[i] = (int16_t)std::min(std::max(value, -32768.0f), 32767.0f);
+		}
+	}
+
+	void mixSamples(const float * samples, const size_t count, const float startGain, const float gainStep, float * outSamples) noexcept
+	{
+		size_t i = 0;
+#if defined(KSMediaCodec_SIMD_SSE2)
+		__m128 gain = _mm_add_ps(_mm_set1_ps(startGain), _mm_mul_ps(_mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f), _mm_set1_ps(gainStep)));
+		const __m128 gainIncrement = _mm_set1_ps(gainStep * 4.0f);
+		for (; i + 4 <= count; i += 4)
+		{
+			const __m128 value = _mm_mul_ps(_mm_loadu_ps(samples + i), gain);
+			_mm_storeu_ps(outSamples + i, _mm_add_ps(_mm_loadu_ps(outSamples + i), value));
+			gain = _mm_add_ps(gain, gainIncrement);
+		}
+#elif defined(KSMediaCodec_SIMD_NEON)
+		const float offsets[4] = { 0.0f, 1.0f, 2.0f, 3.0f };
+		float32x4_t gain = vmlaq_n_f32(vdupq_n_f32(startGain), vld1q_f32(offsets), gainStep);
+		const float32x4_t gainIncrement = vdupq_n_f32(gainStep * 4.0f);
+		for (; i + 4 <= count; i += 4)
+		{
+			vst1q_f32(outSamples + i, vmlaq_f32(vld1q_f32(outSamples + i), vld1q_f32(samples + i), gain));
+			gain = vaddq_f32(gain, gainIncrement);
+		}
+#endif
+		for (; i < count; i++)
+		{
+			outSamples[i] += samples[i] * (startGain + (float)i * gainStep);
+		}
+	}
+}
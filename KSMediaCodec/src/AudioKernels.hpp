@@ -0,0 +1,35 @@
+#ifndef KSMediaCodec_AudioKernels_hpp
+#define KSMediaCodec_AudioKernels_hpp
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace ks
+{
+	/**
+	 * Minimum, maximum and sum of squares of count samples. All zero when count is 0.
+	 */
+	void reduceSamplePeaks(const float* samples, const size_t count, float& outMin, float& outMax, float& outSumSquares) noexcept;
+
+	void interleaveSamples(const float* const* planes, const int channels, const size_t frames, float* outSamples) noexcept;
+	void interleaveSamples(const int16_t* const* planes, const int channels, const size_t frames, int16_t* outSamples) noexcept;
+	void deinterleaveSamples(const float* samples, const int channels, const size_t frames, float* const* outPlanes) noexcept;
+	void deinterleaveSamples(const int16_t* samples, const int channels, const size_t frames, int16_t* const* outPlanes) noexcept;
+
+	/**
+	 * Scales by 1/32768.
+	 */
+	void convertSamples(const int16_t* samples, const size_t count, float* outSamples) noexcept;
+
+	/**
+	 * Scales by 32768 and saturates to the int16 range.
+	 */
+	void convertSamples(const float* samples, const size_t count, int16_t* outSamples) noexcept;
+
+	/**
+	 * Adds samples scaled by a linear gain ramp to outSamples: outSamples[i] += samples[i] * (startGain + i * gainStep).
+	 */
+	void mixSamples(const float* samples, const size_t count, const float startGain, const float gainStep, float* outSamples) noexcept;
+}
+
+#endif // KSMediaCodec_AudioKernels_hpp
@@ -0,0 +1,220 @@
+#include "AudioMixer.hpp"
+#include "AudioKernels.hpp"
+#include <algorithm>
+#include <assert.h>
+#include <string.h>
+
+namespace ks
+{
+	AudioMixer * AudioMixer::New(const std::vector<Source>& sources, const ks::AudioFormat & audioFormat, const unsigned int threadCount)
+	{
+		if (sources.empty()
+			|| audioFormat.isFloat() == false
+			|| audioFormat.bitsPerChannel != 32
+			|| audioFormat.channelsPerFrame == 0
+			|| audioFormat.sampleRate == 0)
+		{
+			return nullptr;
+		}
+
+		ks::AudioFormat decoderFormat = audioFormat;
+		decoderFormat.formatFlags = ks::AudioFormatFlag::isFloat | ks::AudioFormatFlag::isNonInterleaved;
+		decoderFormat.bytesPerFrame = 4;
+		decoderFormat.bytesPerPacket = 4;
+
+		std::unique_ptr<AudioMixer> mixer = std::unique_ptr<AudioMixer>(new AudioMixer());
+		mixer->audioFormat = audioFormat;
+		mixer->decoderFormat = decoderFormat;
+		mixer->isNonInterleaved = audioFormat.isNonInterleaved();
+		for (const Source& source : sources)
+		{
+			std::unique_ptr<SourceState> state = std::make_unique<SourceState>();
+			state->decoder = std::unique_ptr<AudioDecoder>(AudioDecoder::New(source.filePath, decoderFormat));
+			if (state->decoder == nullptr)
+			{
+				return nullptr;
+			}
+			state->source = source;
+			state->targetStartSample = mixer->sampleOf(source.timeMapping.target.start);
+			state->targetEndSample = mixer->sampleOf(source.timeMapping.target.end);
+			state->sourceStartSample = mixer->sampleOf(source.timeMapping.source.start);
+			state->fadeInSamples = std::max<int64_t>(mixer->sampleOf(source.fadeInDuration), 0);
+			state->fadeOutSamples = std::max<int64_t>(mixer->sampleOf(source.fadeOutDuration), 0);
+			mixer->sources.push_back(std::move(state));
+		}
+		if (threadCount != 1)
+		{
+			mixer->threadPool = std::make_unique<ThreadPool>(threadCount);
+		}
+		mixer->mixPlanes.resize(audioFormat.channelsPerFrame);
+		return mixer.release();
+	}
+
+	AudioMixer::~AudioMixer()
+	{
+	}
+
+	int AudioMixer::mix(const MediaTimeRange & timeRange, ks::AudioPCMBuffer & outBuffer)
+	{
+		const int64_t startSample = sampleOf(timeRange.start);
+		const int sampleCount = (int)std::min<int64_t>(sampleOf(timeRange.end) - startSample, outBuffer.samplesPerChannel());
+		if (sampleCount <= 0)
+		{
+			return 0;
+		}
+		const int64_t endSample = startSample + sampleCount;
+		const int channels = audioFormat.channelsPerFrame;
+
+		std::vector<SourceState*> activeSources;
+		for (std::unique_ptr<SourceState>& state : sources)
+		{
+			state->readSampleCount = 0;
+			const int64_t overlapStart = std::max(startSample, state->targetStartSample);
+			const int64_t overlapEnd = std::min(endSample, state->targetEndSample);
+			if (overlapStart < overlapEnd && state->source.gain != 0.0f)
+			{
+				state->readStartSample = overlapStart;
+				state->readSampleCount = (int)(overlapEnd - overlapStart);
+				activeSources.push_back(state.get());
+			}
+		}
+
+		if (threadPool && activeSources.size() > 1)
+		{
+			std::vector<std::future<void>> tasks;
+			tasks.reserve(activeSources.size());
+			for (SourceState* state : activeSources)
+			{
+				tasks.push_back(threadPool->submit([this, state]()
+				{
+					readSource(*state, state->readStartSample, state->readSampleCount);
+				}));
+			}
+			for (std::future<void>& task : tasks)
+			{
+				task.get();
+			}
+		}
+		else
+		{
+			for (SourceState* state : activeSources)
+			{
+				readSource(*state, state->readStartSample, state->readSampleCount);
+			}
+		}
+
+		std::vector<float*> outPlanes(channels, nullptr);
+		for (int channel = 0; channel < channels; channel++)
+		{
+			if (isNonInterleaved)
+			{
+				outPlanes[channel] = reinterpret_cast<float*>(outBuffer.channelData()[channel]);
+			}
+			else
+			{
+				std::vector<float>& plane = mixPlanes[channel];
+				if (plane.size() < (size_t)sampleCount)
+				{
+					plane.resize(sampleCount);
+				}
+				outPlanes[channel] = plane.data();
+			}
+			memset(outPlanes[channel], 0, sizeof(float) * sampleCount);
+		}
+
+		for (SourceState* state : activeSources)
+		{
+			mixSource(*state, startSample, outPlanes.data());
+		}
+
+		if (isNonInterleaved == false)
+		{
+			interleaveSamples(outPlanes.data(), channels, sampleCount, reinterpret_cast<float*>(outBuffer.channelData()[0]));
+		}
+		return sampleCount;
+	}
+
+	void AudioMixer::setGain(const size_t sourceIndex, const float gain)
+	{
+		assert(sourceIndex < sources.size());
+		sources[sourceIndex]->source.gain = gain;
+	}
+
+	size_t AudioMixer::sourceCount() const
+	{
+		return sources.size();
+	}
+
+	const ks::AudioFormat & AudioMixer::getAudioFormat() const
+	{
+		return audioFormat;
+	}
+
+	int64_t AudioMixer::sampleOf(const MediaTime & time) const
+	{
+		return av_rescale(time.timeValue(), audioFormat.sampleRate, time.timeScale());
+	}
+
+	float AudioMixer::envelopeAt(const SourceState & state, const int64_t sample) const
+	{
+		double envelope = state.source.gain;
+		if (state.fadeInSamples > 0)
+		{
+			envelope *= std::clamp((double)(sample - state.targetStartSample) / state.fadeInSamples, 0.0, 1.0);
+		}
+		if (state.fadeOutSamples > 0)
+		{
+			envelope *= std::clamp((double)(state.targetEndSample - sample) / state.fadeOutSamples, 0.0, 1.0);
+		}
+		return (float)envelope;
+	}
+
+	void AudioMixer::readSource(SourceState & state, const int64_t startSample, const int sampleCount)
+	{
+		if (state.samples == nullptr || state.samples->samplesPerChannel() < (unsigned int)sampleCount)
+		{
+			state.samples = std::make_unique<ks::AudioPCMBuffer>(decoderFormat, sampleCount);
+		}
+		const int sampleRate = audioFormat.sampleRate;
+		const int64_t sourceSample = state.sourceStartSample + (startSample - state.targetStartSample);
+		const MediaTimeRange sourceTimeRange = MediaTimeRange(MediaTime((int)sourceSample, sampleRate),
+			MediaTime((int)(sourceSample + sampleCount), sampleRate));
+		state.readSampleCount = std::max(state.decoder->readSamples(sourceTimeRange, *state.samples), 0);
+	}
+
+	void AudioMixer::mixSource(const SourceState & state, const int64_t blockStartSample, float * const * outPlanes) const
+	{
+		const int64_t readEndSample = state.readStartSample + state.readSampleCount;
+		// The envelope is linear between these points, apart from overlapping fades.
+		int64_t boundaries[4] = {
+			state.readStartSample,
+			state.targetStartSample + state.fadeInSamples,
+			state.targetEndSample - state.fadeOutSamples,
+			readEndSample
+		};
+		std::sort(boundaries, boundaries + 4);
+
+		const int channels = audioFormat.channelsPerFrame;
+		const unsigned char* const* sourcePlanes = state.samples ? state.samples->immutableChannelData() : nullptr;
+		int64_t segmentStart = state.readStartSample;
+		for (const int64_t boundary : boundaries)
+		{
+			const int64_t segmentEnd = std::min(boundary, readEndSample);
+			if (segmentEnd <= segmentStart)
+			{
+				continue;
+			}
+			const size_t length = (size_t)(segmentEnd - segmentStart);
+			const float startGain = envelopeAt(state, segmentStart);
+			const float gainStep = (envelopeAt(state, segmentEnd) - startGain) / length;
+			const size_t sourceOffset = (size_t)(segmentStart - state.readStartSample);
+			const size_t outOffset = (size_t)(segmentStart - blockStartSample);
+			for (int channel = 0; channel < channels; channel++)
+			{
+				const float* samples = reinterpret_cast<const float*>(sourcePlanes[channel]);
+				mixSamples(samples + sourceOffset, length, startGain, gainStep, outPlanes[channel] + outOffset);
+			}
+			segmentStart = segmentEnd;
+		}
+	}
+}
@@ -0,0 +1,410 @@
+#include "CompositionRenderer.hpp"
+#include <algorithm>
+#include <climits>
+#include <assert.h>
+#include <functional>
+
+namespace ks
+{
+	namespace
+	{
+		const int speedChunkSamples = 1024;
+	}
+
+	CompositionClip::CompositionClip()
+	{
+	}
+
+	CompositionClip::CompositionClip(const std::string & filePath, const MediaTimeMapping & timeMapping)
+		: filePath(filePath), timeMapping(timeMapping)
+	{
+	}
+
+	CompositionRenderer * CompositionRenderer::New(const std::vector<CompositionClip>& clips,
+		const ks::PixelBuffer::FormatType & formatType,
+		const ks::AudioFormat & audioFormat,
+		const size_t maxOpenSources)
+	{
+		AVAudioFifo *outputAudioFifo = nullptr;
+		AVAudioFifo *clipAudioFifo = nullptr;
+		std::function<void()> cleanClosure = [&]()
+		{
+			if (clipAudioFifo)
+			{
+				av_audio_fifo_free(clipAudioFifo);
+			}
+			if (outputAudioFifo)
+			{
+				av_audio_fifo_free(outputAudioFifo);
+			}
+		};
+
+		defer
+		{
+			cleanClosure();
+		};
+
+		if (clips.empty())
+		{
+			return nullptr;
+		}
+
+		AVSampleFormat sampleFormat = AudioDecoder::getAVSampleFormat(audioFormat);
+		outputAudioFifo = av_audio_fifo_alloc(sampleFormat, audioFormat.channelsPerFrame, audioFormat.sampleRate);
+		clipAudioFifo = av_audio_fifo_alloc(sampleFormat, audioFormat.channelsPerFrame, speedChunkSamples);
+		if (outputAudioFifo == nullptr || clipAudioFifo == nullptr)
+		{
+			return nullptr;
+		}
+
+		std::vector<CompositionClip> sortedClips = clips;
+		std::stable_sort(sortedClips.begin(), sortedClips.end(), [](const CompositionClip& lhs, const CompositionClip& rhs)
+		{
+			return lhs.timeMapping.target.start < rhs.timeMapping.target.start;
+		});
+		std::vector<MediaTimeMapping> mappings;
+		mappings.reserve(sortedClips.size());
+		for (const CompositionClip& clip : sortedClips)
+		{
+			mappings.push_back(clip.timeMapping);
+		}
+
+		CompositionRenderer* renderer = new CompositionRenderer();
+		renderer->clips = sortedClips;
+		renderer->timeline = MediaTimeline(mappings);
+		renderer->formatType = formatType;
+		renderer->audioFormat = audioFormat;
+		renderer->sampleFormat = sampleFormat;
+		renderer->maxOpenSources = std::max<size_t>(maxOpenSources, 2);
+		renderer->outputAudioFifo = outputAudioFifo;
+		renderer->clipAudioFifo = clipAudioFifo;
+		cleanClosure = []() {};
+		return renderer;
+	}
+
+	CompositionRenderer::~CompositionRenderer()
+	{
+		waitPrefetch();
+		assert(outputAudioFifo && clipAudioFifo);
+		av_audio_fifo_free(outputAudioFifo);
+		av_audio_fifo_free(clipAudioFifo);
+		swr_free(&speedSwrContext);
+	}
+
+	bool CompositionRenderer::render(VideoFileEncoder & encoder, const MediaTime & fps)
+	{
+		if (fps.timeValue() <= 0)
+		{
+			return false;
+		}
+		const MediaTimeRange targetTimeRange = timeline.targetTimeRange();
+		const MediaTime frameDuration = fps.invert();
+		outputAudioSamples = audioSampleOf(targetTimeRange.start);
+		encodedAudioSamples = outputAudioSamples;
+		currentAudioClipIndex = -1;
+		currentAudioSources.reset();
+		av_audio_fifo_reset(outputAudioFifo);
+
+		int activeClipIndex = -1;
+		std::shared_ptr<SourceDecoders> activeSources;
+		for (int frameIndex = 0; ; frameIndex++)
+		{
+			const MediaTime time = targetTimeRange.start + MediaTime(frameIndex, 1) * frameDuration;
+			if (time >= targetTimeRange.end)
+			{
+				break;
+			}
+
+			const int clipIndex = timeline.indexOf(time);
+			if (clipIndex >= 0)
+			{
+				if (clipIndex != activeClipIndex)
+				{
+					waitPrefetch();
+					activeClipIndex = clipIndex;
+					activeSources = sourceDecoders(clips[clipIndex].filePath);
+					if (clipIndex + 1 < (int)clips.size())
+					{
+						prefetchTask = std::async(std::launch::async, [this, clipIndex]()
+						{
+							prefetch(clipIndex + 1, clipIndex);
+						});
+					}
+				}
+
+				const CompositionClip& clip = clips[clipIndex];
+				if (activeSources->videoDecoder)
+				{
+					MediaTime pts;
+					std::unique_ptr<ks::PixelBuffer> pixelBuffer = std::unique_ptr<ks::PixelBuffer>(activeSources->videoDecoder->newFrameAt(clip.timeMapping.sourceTime(time), pts));
+					if (pixelBuffer)
+					{
+						encoder.encode(*pixelBuffer, time);
+					}
+				}
+			}
+
+			renderAudio(encoder, audioSampleOf(time + frameDuration));
+		}
+
+		renderAudio(encoder, audioSampleOf(targetTimeRange.end));
+		encodeAudio(encoder, true);
+		waitPrefetch();
+		return true;
+	}
+
+	const MediaTimeline & CompositionRenderer::getTimeline() const
+	{
+		return timeline;
+	}
+
+	size_t CompositionRenderer::openSourceCount()
+	{
+		std::lock_guard<std::mutex> lock(decoderPoolMutex);
+		return decoderPool.size();
+	}
+
+	std::shared_ptr<CompositionRenderer::SourceDecoders> CompositionRenderer::sourceDecoders(const std::string & filePath)
+	{
+		{
+			std::lock_guard<std::mutex> lock(decoderPoolMutex);
+			auto iter = decoderPoolIndex.find(filePath);
+			if (iter != decoderPoolIndex.end())
+			{
+				decoderPool.splice(decoderPool.begin(), decoderPool, iter->second);
+				return iter->second->decoders;
+			}
+		}
+
+		std::shared_ptr<SourceDecoders> decoders = std::make_shared<SourceDecoders>();
+		decoders->videoDecoder = std::unique_ptr<VideoDecoder>(VideoDecoder::New(filePath, formatType));
+		decoders->audioDecoder = std::unique_ptr<AudioDecoder>(AudioDecoder::New(filePath, audioFormat));
+
+		// Declared before the lock so evicted decoders are closed after it is released.
+		std::vector<std::shared_ptr<SourceDecoders>> evictedDecoders;
+		std::lock_guard<std::mutex> lock(decoderPoolMutex);
+		auto iter = decoderPoolIndex.find(filePath);
+		if (iter != decoderPoolIndex.end())
+		{
+			decoderPool.splice(decoderPool.begin(), decoderPool, iter->second);
+			evictedDecoders.push_back(std::move(decoders));
+			return iter->second->decoders;
+		}
+		decoderPool.push_front(SourceEntry{ filePath, decoders });
+		decoderPoolIndex[filePath] = decoderPool.begin();
+		while (decoderPool.size() > maxOpenSources)
+		{
+			decoderPoolIndex.erase(decoderPool.back().filePath);
+			evictedDecoders.push_back(std::move(decoderPool.back().decoders));
+			decoderPool.pop_back();
+		}
+		return decoders;
+	}
+
+	void CompositionRenderer::prefetch(const int clipIndex, const int currentClipIndex)
+	{
+		const CompositionClip& clip = clips[clipIndex];
+		if (clip.filePath == clips[currentClipIndex].filePath)
+		{
+			return;
+		}
+		std::shared_ptr<SourceDecoders> decoders = sourceDecoders(clip.filePath);
+		if (decoders->videoDecoder)
+		{
+			decoders->videoDecoder->prepareFrameAt(clip.timeMapping.source.start);
+		}
+	}
+
+	void CompositionRenderer::waitPrefetch()
+	{
+		if (prefetchTask.valid())
+		{
+			prefetchTask.wait();
+			prefetchTask = std::future<void>();
+		}
+	}
+
+	int64_t CompositionRenderer::audioSampleOf(const MediaTime & time) const
+	{
+		return av_rescale(time.timeValue(), audioFormat.sampleRate, time.timeScale());
+	}
+
+	void CompositionRenderer::renderAudio(VideoFileEncoder & encoder, const int64_t targetEndSample)
+	{
+		while (outputAudioSamples < targetEndSample)
+		{
+			const MediaTime time = MediaTime((int)outputAudioSamples, (int)audioFormat.sampleRate);
+			int64_t sampleCount = targetEndSample - outputAudioSamples;
+			const int clipIndex = timeline.indexOf(time);
+			if (clipIndex >= 0)
+			{
+				const int64_t clipEndSample = audioSampleOf(clips[clipIndex].timeMapping.target.end);
+				sampleCount = std::max<int64_t>(1, std::min(sampleCount, clipEndSample - outputAudioSamples));
+				readClipAudio(clipIndex, time, (int)sampleCount);
+			}
+			else
+			{
+				std::vector<size_t> indices = timeline.indicesOverlapping(MediaTimeRange(time, MediaTime((int)targetEndSample, (int)audioFormat.sampleRate)));
+				if (indices.empty() == false)
+				{
+					const int64_t clipStartSample = audioSampleOf(timeline.mappingAt(indices.front()).target.start);
+					sampleCount = std::max<int64_t>(1, std::min(sampleCount, clipStartSample - outputAudioSamples));
+				}
+				writeSilence(outputAudioFifo, (int)sampleCount);
+			}
+			outputAudioSamples += sampleCount;
+		}
+		encodeAudio(encoder, false);
+	}
+
+	void CompositionRenderer::readClipAudio(const int clipIndex, const MediaTime & targetTime, const int sampleCount)
+	{
+		if (clipIndex != currentAudioClipIndex)
+		{
+			waitPrefetch();
+			const CompositionClip& clip = clips[clipIndex];
+			currentAudioClipIndex = clipIndex;
+			currentAudioSources = sourceDecoders(clip.filePath);
+			nextSourceAudioSample = audioSampleOf(clip.timeMapping.sourceTime(targetTime));
+			av_audio_fifo_reset(clipAudioFifo);
+			isClipAudioFinished = false;
+			if (resetSpeedResampler(clip.timeMapping) == false)
+			{
+				currentAudioSources.reset();
+			}
+		}
+
+		int readSamples = 0;
+		AudioDecoder* audioDecoder = currentAudioSources ? currentAudioSources->audioDecoder.get() : nullptr;
+		if (audioDecoder && speedSwrContext)
+		{
+			readSamples = readSpeedChangedAudio(audioDecoder, sampleCount);
+		}
+		else if (audioDecoder)
+		{
+			const int sampleRate = audioFormat.sampleRate;
+			const MediaTimeRange sourceTimeRange = MediaTimeRange(MediaTime((int)nextSourceAudioSample, sampleRate),
+				MediaTime((int)(nextSourceAudioSample + sampleCount), sampleRate));
+			ks::AudioPCMBuffer pcmBuffer(audioFormat, sampleCount);
+			readSamples = std::max(audioDecoder->readSamples(sourceTimeRange, pcmBuffer), 0);
+			if (readSamples > 0)
+			{
+				av_audio_fifo_write(outputAudioFifo, reinterpret_cast<void**>(pcmBuffer.channelData()), readSamples);
+			}
+			nextSourceAudioSample += sampleCount;
+		}
+		writeSilence(outputAudioFifo, sampleCount - readSamples);
+	}
+
+	bool CompositionRenderer::resetSpeedResampler(const MediaTimeMapping & timeMapping)
+	{
+		swr_free(&speedSwrContext);
+		const MediaTime sourceDuration = timeMapping.source.duration();
+		const MediaTime targetDuration = timeMapping.target.duration();
+		if (targetDuration.timeValue() <= 0 || sourceDuration == targetDuration)
+		{
+			return true;
+		}
+
+		// Played at sourceRate, the clip's source samples span exactly its target duration.
+		const int64_t sourceRate = av_rescale((int64_t)audioFormat.sampleRate * sourceDuration.timeValue(), targetDuration.timeScale(),
+			(int64_t)sourceDuration.timeScale() * targetDuration.timeValue());
+		if (sourceRate <= 0 || sourceRate > INT_MAX)
+		{
+			return false;
+		}
+		if (sourceRate == (int64_t)audioFormat.sampleRate)
+		{
+			return true;
+		}
+		const int64_t channelLayout = av_get_default_channel_layout(audioFormat.channelsPerFrame);
+		speedSwrContext = swr_alloc_set_opts(nullptr,
+			channelLayout, sampleFormat, audioFormat.sampleRate,
+			channelLayout, sampleFormat, (int)sourceRate,
+			0, nullptr);
+		if (speedSwrContext == nullptr || swr_init(speedSwrContext) < 0)
+		{
+			swr_free(&speedSwrContext);
+			return false;
+		}
+		return true;
+	}
+
+	int CompositionRenderer::readSpeedChangedAudio(AudioDecoder * audioDecoder, const int sampleCount)
+	{
+		const int sampleRate = audioFormat.sampleRate;
+		while (av_audio_fifo_size(clipAudioFifo) < sampleCount && isClipAudioFinished == false)
+		{
+			const MediaTimeRange sourceTimeRange = MediaTimeRange(MediaTime((int)nextSourceAudioSample, sampleRate),
+				MediaTime((int)(nextSourceAudioSample + speedChunkSamples), sampleRate));
+			ks::AudioPCMBuffer pcmBuffer(audioFormat, speedChunkSamples);
+			const int readSamples = std::max(audioDecoder->readSamples(sourceTimeRange, pcmBuffer), 0);
+			nextSourceAudioSample += speedChunkSamples;
+			isClipAudioFinished = readSamples < speedChunkSamples;
+			if (readSamples > 0)
+			{
+				appendSpeedChangedSamples(const_cast<const uint8_t**>(pcmBuffer.channelData()), readSamples);
+			}
+			if (isClipAudioFinished)
+			{
+				appendSpeedChangedSamples(nullptr, 0);
+			}
+		}
+
+		const int availableSamples = std::min(av_audio_fifo_size(clipAudioFifo), sampleCount);
+		if (availableSamples > 0)
+		{
+			ks::AudioPCMBuffer pcmBuffer(audioFormat, availableSamples);
+			av_audio_fifo_read(clipAudioFifo, reinterpret_cast<void**>(pcmBuffer.channelData()), availableSamples);
+			av_audio_fifo_write(outputAudioFifo, reinterpret_cast<void**>(pcmBuffer.channelData()), availableSamples);
+		}
+		return std::max(availableSamples, 0);
+	}
+
+	void CompositionRenderer::appendSpeedChangedSamples(const uint8_t ** samples, const int sampleCount)
+	{
+		const int outSampleCount = swr_get_out_samples(speedSwrContext, sampleCount);
+		if (outSampleCount <= 0)
+		{
+			return;
+		}
+		ks::AudioPCMBuffer pcmBuffer(audioFormat, outSampleCount);
+		const int convertedSampleCount = swr_convert(speedSwrContext, pcmBuffer.channelData(), outSampleCount, samples, sampleCount);
+		if (convertedSampleCount > 0)
+		{
+			av_audio_fifo_write(clipAudioFifo, reinterpret_cast<void**>(pcmBuffer.channelData()), convertedSampleCount);
+		}
+	}
+
+	void CompositionRenderer::writeSilence(AVAudioFifo * fifo, const int sampleCount)
+	{
+		if (sampleCount <= 0)
+		{
+			return;
+		}
+		std::vector<uint8_t*> samples(audioFormat.channelsPerFrame, nullptr);
+		av_samples_alloc(samples.data(), nullptr, audioFormat.channelsPerFrame, sampleCount, sampleFormat, 0);
+		defer
+		{
+			av_freep(&samples[0]);
+		};
+		av_samples_set_silence(samples.data(), 0, sampleCount, audioFormat.channelsPerFrame, sampleFormat);
+		av_audio_fifo_write(fifo, reinterpret_cast<void**>(samples.data()), sampleCount);
+	}
+
+	void CompositionRenderer::encodeAudio(VideoFileEncoder & encoder, const bool isFlushing)
+	{
+		const int frameSize = encoder.getAudioSamples();
+		if (isFlushing && av_audio_fifo_size(outputAudioFifo) % frameSize != 0)
+		{
+			writeSilence(outputAudioFifo, frameSize - av_audio_fifo_size(outputAudioFifo) % frameSize);
+		}
+		while (av_audio_fifo_size(outputAudioFifo) >= frameSize)
+		{
+			ks::AudioPCMBuffer pcmBuffer(audioFormat, frameSize);
+			av_audio_fifo_read(outputAudioFifo, reinterpret_cast<void**>(pcmBuffer.channelData()), frameSize);
+			encoder.encode(pcmBuffer, MediaTime((int)encodedAudioSamples, (int)audioFormat.sampleRate));
+			encodedAudioSamples += frameSize;
+		}
+	}
+}
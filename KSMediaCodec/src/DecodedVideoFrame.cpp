@@ -0,0 +1,105 @@
+#include "DecodedVideoFrame.hpp"
+#include "VideoDecoder.hpp"
+#include "PlaneCopy.hpp"
+#include <assert.h>
+#include <algorithm>
+
+namespace ks
+{
+	DecodedVideoFrame * DecodedVideoFrame::New(const AVFrame * frame, const MediaTime & pts)
+	{
+		// av_frame_clone copies the pixels of frames without a buffer reference, which would defeat the point.
+		if (frame->buf[0] == nullptr)
+		{
+			return nullptr;
+		}
+		AVFrame* reference = av_frame_clone(frame);
+		if (reference == nullptr)
+		{
+			return nullptr;
+		}
+		DecodedVideoFrame* decodedFrame = new DecodedVideoFrame();
+		decodedFrame->frame = reference;
+		decodedFrame->pts = pts;
+		return decodedFrame;
+	}
+
+	DecodedVideoFrame::~DecodedVideoFrame()
+	{
+		assert(frame);
+		av_frame_free(&frame);
+	}
+
+	int DecodedVideoFrame::getWidth() const
+	{
+		return frame->width;
+	}
+
+	int DecodedVideoFrame::getHeight() const
+	{
+		return frame->height;
+	}
+
+	AVPixelFormat DecodedVideoFrame::getPixelFormat() const
+	{
+		return static_cast<AVPixelFormat>(frame->format);
+	}
+
+	MediaTime DecodedVideoFrame::getPts() const
+	{
+		return pts;
+	}
+
+	bool DecodedVideoFrame::hasFormatType(const ks::PixelBuffer::FormatType & formatType) const
+	{
+		return VideoDecoder::getAVPixelFormat(formatType) == getPixelFormat();
+	}
+
+	int DecodedVideoFrame::planeCount() const
+	{
+		return std::max(av_pix_fmt_count_planes(getPixelFormat()), 0);
+	}
+
+	const uint8_t * DecodedVideoFrame::planeData(const int plane) const
+	{
+		assert(plane >= 0 && plane < planeCount());
+		return frame->data[plane];
+	}
+
+	int DecodedVideoFrame::lineSize(const int plane) const
+	{
+		assert(plane >= 0 && plane < planeCount());
+		return frame->linesize[plane];
+	}
+
+	int DecodedVideoFrame::planeWidth(const int plane) const
+	{
+		int width = 0;
+		int height = 0;
+		ks::planeSize(frame, plane, width, height);
+		return width;
+	}
+
+	int DecodedVideoFrame::planeHeight(const int plane) const
+	{
+		int width = 0;
+		int height = 0;
+		ks::planeSize(frame, plane, width, height);
+		return height;
+	}
+
+	bool DecodedVideoFrame::isPlaneCopyable(const int plane) const
+	{
+		return ks::isPlaneCopyable(frame, plane);
+	}
+
+	ks::PixelBuffer * DecodedVideoFrame::newPlaneBuffer(const int plane, const int decimation) const
+	{
+		return newPlaneCopy(frame, plane, decimation);
+	}
+
+	const AVFrame * DecodedVideoFrame::getAVFrame() const
+	{
+		return frame;
+	}
+}
@@ -0,0 +1,162 @@
+#include "DecoderCache.hpp"
+#include <assert.h>
+
+namespace ks
+{
+	DecoderCache::DecoderCache(const size_t maxOpenDecoders, const long long maxMemoryBytes)
+		: maxOpenDecoders(maxOpenDecoders), maxMemoryBytes(maxMemoryBytes)
+	{
+	}
+
+	DecoderCache::~DecoderCache()
+	{
+		assert(checkedOutDecoders.empty());
+	}
+
+	VideoDecoder * DecoderCache::checkout(const std::string & filePath, const ks::PixelBuffer::FormatType & formatType)
+	{
+		const std::string key = makeKey(filePath, formatType);
+		std::vector<std::unique_ptr<VideoDecoder>> evictedDecoders;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			auto range = idleEntriesByKey.equal_range(key);
+			if (range.first != range.second)
+			{
+				std::list<Entry>::iterator entry = range.first->second;
+				VideoDecoder* decoder = entry->decoder.release();
+				checkedOutDecoders[decoder] = entry->memoryUsage;
+				idleEntriesByKey.erase(range.first);
+				idleEntries.erase(entry);
+				_statistics.hits += 1;
+				return decoder;
+			}
+			_statistics.misses += 1;
+			evictedDecoders = evictOverLimit(1, 0);
+		}
+		evictedDecoders.clear();
+
+		VideoDecoder* decoder = VideoDecoder::New(filePath, formatType);
+		if (decoder == nullptr)
+		{
+			return nullptr;
+		}
+		const long long decoderMemoryUsage = decoder->estimatedMemoryUsage();
+
+		std::lock_guard<std::mutex> lock(mutex);
+		checkedOutDecoders[decoder] = decoderMemoryUsage;
+		memoryUsage += decoderMemoryUsage;
+		evictedDecoders = evictOverLimit(0, 0);
+		return decoder;
+	}
+
+	void DecoderCache::checkin(VideoDecoder * decoder)
+	{
+		if (decoder == nullptr)
+		{
+			return;
+		}
+		std::vector<std::unique_ptr<VideoDecoder>> evictedDecoders;
+		std::lock_guard<std::mutex> lock(mutex);
+		auto iter = checkedOutDecoders.find(decoder);
+		assert(iter != checkedOutDecoders.end());
+		const long long decoderMemoryUsage = iter->second;
+		checkedOutDecoders.erase(iter);
+		memoryUsage -= decoderMemoryUsage;
+		insertIdle(std::unique_ptr<VideoDecoder>(decoder), decoderMemoryUsage);
+		evictedDecoders = evictOverLimit(0, 0);
+	}
+
+	void DecoderCache::warmUp(const std::vector<std::string>& filePaths, const ks::PixelBuffer::FormatType & formatType)
+	{
+		for (const std::string& filePath : filePaths)
+		{
+			std::unique_ptr<VideoDecoder> decoder = std::unique_ptr<VideoDecoder>(VideoDecoder::New(filePath, formatType));
+			if (decoder == nullptr)
+			{
+				continue;
+			}
+			const long long decoderMemoryUsage = decoder->estimatedMemoryUsage();
+			std::vector<std::unique_ptr<VideoDecoder>> evictedDecoders;
+			std::lock_guard<std::mutex> lock(mutex);
+			insertIdle(std::move(decoder), decoderMemoryUsage);
+			evictedDecoders = evictOverLimit(0, 0);
+		}
+	}
+
+	void DecoderCache::clear()
+	{
+		std::list<Entry> entries;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			for (const Entry& entry : idleEntries)
+			{
+				memoryUsage -= entry.memoryUsage;
+			}
+			entries.swap(idleEntries);
+			idleEntriesByKey.clear();
+		}
+	}
+
+	DecoderCache::Statistics DecoderCache::statistics()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		Statistics statistics = _statistics;
+		statistics.idleDecoders = idleEntries.size();
+		statistics.checkedOutDecoders = checkedOutDecoders.size();
+		statistics.memoryUsage = memoryUsage;
+		return statistics;
+	}
+
+	std::string DecoderCache::makeKey(const std::string & filePath, const ks::PixelBuffer::FormatType & formatType)
+	{
+		return std::to_string(static_cast<int>(formatType)) + ":" + filePath;
+	}
+
+	void DecoderCache::insertIdle(std::unique_ptr<VideoDecoder> decoder, const long long decoderMemoryUsage)
+	{
+		Entry entry;
+		entry.key = makeKey(decoder->getFilePath(), decoder->getOutputFormatType());
+		entry.decoder = std::move(decoder);
+		entry.memoryUsage = decoderMemoryUsage;
+		idleEntries.push_front(std::move(entry));
+		idleEntriesByKey.emplace(idleEntries.front().key, idleEntries.begin());
+		memoryUsage += decoderMemoryUsage;
+	}
+
+	std::unique_ptr<VideoDecoder> DecoderCache::evictLeastRecentlyUsed()
+	{
+		assert(idleEntries.empty() == false);
+		std::list<Entry>::iterator entry = std::prev(idleEntries.end());
+		auto range = idleEntriesByKey.equal_range(entry->key);
+		for (auto iter = range.first; iter != range.second; iter++)
+		{
+			if (iter->second == entry)
+			{
+				idleEntriesByKey.erase(iter);
+				break;
+			}
+		}
+		std::unique_ptr<VideoDecoder> decoder = std::move(entry->decoder);
+		memoryUsage -= entry->memoryUsage;
+		idleEntries.erase(entry);
+		_statistics.evictions += 1;
+		return decoder;
+	}
+
+	std::vector<std::unique_ptr<VideoDecoder>> DecoderCache::evictOverLimit(const size_t reservedDecoders, const long long reservedMemory)
+	{
+		std::vector<std::unique_ptr<VideoDecoder>> evictedDecoders;
+		while (idleEntries.empty() == false)
+		{
+			const size_t openDecoders = idleEntries.size() + checkedOutDecoders.size() + reservedDecoders;
+			const bool isOverDecoderLimit = openDecoders > maxOpenDecoders;
+			const bool isOverMemoryLimit = memoryUsage + reservedMemory > maxMemoryBytes;
+			if (isOverDecoderLimit == false && isOverMemoryLimit == false)
+			{
+				break;
+			}
+			evictedDecoders.push_back(evictLeastRecentlyUsed());
+		}
+		return evictedDecoders;
+	}
+}
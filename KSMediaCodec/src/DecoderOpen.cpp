@@ -0,0 +1,116 @@
+#include "DecoderOpen.hpp"
+
+namespace ks
+{
+	int openDecoderInput(AVFormatContext*& formatContext, const std::string & filePath, const AVMediaType mediaType, const DecoderOpenOptions & options)
+	{
+		if (options.probeSize > 0)
+		{
+			formatContext->probesize = options.probeSize;
+		}
+		if (options.analyzeDuration > 0)
+		{
+			formatContext->max_analyze_duration = options.analyzeDuration;
+		}
+
+		int status = avformat_open_input(&formatContext, filePath.c_str(), nullptr, nullptr);
+		if (status != 0)
+		{
+			return status;
+		}
+
+		int streamIndex = selectDecoderStream(formatContext, mediaType, options);
+		bool isProbingNeeded = true;
+		switch (options.streamInfoProbing)
+		{
+		case DecoderOpenOptions::StreamInfoProbing::never:
+			isProbingNeeded = false;
+			break;
+		case DecoderOpenOptions::StreamInfoProbing::whenNeeded:
+			isProbingNeeded = streamIndex < 0
+				|| (options.codecParameters == nullptr && hasKnownCodecParameters(formatContext->streams[streamIndex]->codecpar) == false);
+			break;
+		default:
+			break;
+		}
+
+		if (isProbingNeeded)
+		{
+			if ((status = avformat_find_stream_info(formatContext, nullptr)) < 0)
+			{
+				return status;
+			}
+			if (streamIndex < 0)
+			{
+				streamIndex = selectDecoderStream(formatContext, mediaType, options);
+			}
+		}
+		if (streamIndex < 0)
+		{
+			return AVERROR_STREAM_NOT_FOUND;
+		}
+
+		if (options.codecParameters && options.codecParameters->codec_type == mediaType)
+		{
+			if ((status = avcodec_parameters_copy(formatContext->streams[streamIndex]->codecpar, options.codecParameters)) < 0)
+			{
+				return status;
+			}
+		}
+		return streamIndex;
+	}
+
+	int selectDecoderStream(const AVFormatContext * formatContext, const AVMediaType mediaType, const DecoderOpenOptions & options)
+	{
+		for (unsigned int i = 0; i < formatContext->nb_streams; i++)
+		{
+			if (matchesDecoderStream(formatContext->streams[i], mediaType, options))
+			{
+				return i;
+			}
+		}
+		return AVERROR_STREAM_NOT_FOUND;
+	}
+
+	bool matchesDecoderStream(const AVStream * stream, const AVMediaType mediaType, const DecoderOpenOptions & options)
+	{
+		if (stream->codecpar->codec_type != mediaType)
+		{
+			return false;
+		}
+		if (options.streamIndex >= 0 && stream->index != options.streamIndex)
+		{
+			return false;
+		}
+		if ((stream->disposition & options.disposition) != options.disposition)
+		{
+			return false;
+		}
+		if (options.language.empty() == false)
+		{
+			const AVDictionaryEntry* entry = av_dict_get(stream->metadata, "language", nullptr, 0);
+			if (entry == nullptr || options.language != entry->value)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool hasKnownCodecParameters(const AVCodecParameters * codecParameters)
+	{
+		if (codecParameters->codec_id == AV_CODEC_ID_NONE)
+		{
+			return false;
+		}
+		switch (codecParameters->codec_type)
+		{
+		case AVMEDIA_TYPE_VIDEO:
+			return codecParameters->width > 0 && codecParameters->height > 0;
+		case AVMEDIA_TYPE_AUDIO:
+			return codecParameters->sample_rate > 0 && codecParameters->channels > 0;
+		default:
+			return false;
+		}
+	}
+}
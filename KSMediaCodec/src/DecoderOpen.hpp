@@ -0,0 +1,26 @@
+#ifndef KSMediaCodec_DecoderOpen_hpp
+#define KSMediaCodec_DecoderOpen_hpp
+
+#include <string>
+#include "FFmpeg.h"
+#include "DecoderOpenOptions.hpp"
+
+namespace ks
+{
+	/**
+	 * Opens filePath into an allocated formatContext, probing as little as options allow.
+	 * Returns the selected stream index or a negative AVERROR.
+	 */
+	int openDecoderInput(AVFormatContext*& formatContext, const std::string& filePath, const AVMediaType mediaType, const DecoderOpenOptions& options);
+
+	int selectDecoderStream(const AVFormatContext* formatContext, const AVMediaType mediaType, const DecoderOpenOptions& options);
+
+	/**
+	 * Whether stream has mediaType and satisfies the index, language and disposition of options.
+	 */
+	bool matchesDecoderStream(const AVStream* stream, const AVMediaType mediaType, const DecoderOpenOptions& options);
+
+	bool hasKnownCodecParameters(const AVCodecParameters* codecParameters);
+}
+
+#endif // KSMediaCodec_DecoderOpen_hpp
@@ -0,0 +1,243 @@
+#include "FramePool.hpp"
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <stdlib.h>
+
+#ifdef _WIN32
+#include <malloc.h>
+#else
+#include <sys/mman.h>
+#endif
+
+namespace ks
+{
+	namespace
+	{
+		const size_t hugePageSize = 2 * 1024 * 1024;
+
+		/**
+		 * Codecs may read up to 64 bytes past the last line.
+		 */
+		const size_t bufferPadding = 64;
+	}
+
+	struct FramePool::State
+	{
+		std::mutex mutex;
+		std::unordered_map<size_t, std::vector<uint8_t*>> idleBuffers;
+		std::unordered_set<const uint8_t*> inUseBuffers;
+		long long maxIdleBytes = 0;
+		long long idleBytes = 0;
+		bool useHugePages = false;
+		Statistics statistics;
+
+		uint8_t* allocate(const size_t size)
+		{
+#ifdef _WIN32
+			return static_cast<uint8_t*>(_aligned_malloc(size, alignment));
+#else
+			if (useHugePages && size >= hugePageSize)
+			{
+				void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+				if (data == MAP_FAILED)
+				{
+					return nullptr;
+				}
+#ifdef MADV_HUGEPAGE
+				madvise(data, size, MADV_HUGEPAGE);
+#endif
+				return static_cast<uint8_t*>(data);
+			}
+			void* data = nullptr;
+			if (posix_memalign(&data, alignment, size) != 0)
+			{
+				return nullptr;
+			}
+			return static_cast<uint8_t*>(data);
+#endif
+		}
+
+		void deallocate(uint8_t* data, const size_t size)
+		{
+#ifdef _WIN32
+			_aligned_free(data);
+#else
+			if (useHugePages && size >= hugePageSize)
+			{
+				munmap(data, size);
+				return;
+			}
+			free(data);
+#endif
+		}
+
+		size_t roundedSize(const size_t size) const
+		{
+			const size_t granularity = useHugePages && size >= hugePageSize ? hugePageSize : alignment;
+			return (size + granularity - 1) / granularity * granularity;
+		}
+	};
+
+	struct FramePool::BufferOwner
+	{
+		std::shared_ptr<State> state;
+		size_t size;
+	};
+
+	FramePool::FramePool(const long long maxIdleBytes, const bool useHugePages)
+	{
+		state = std::make_shared<State>();
+		state->maxIdleBytes = maxIdleBytes;
+		state->useHugePages = useHugePages;
+	}
+
+	FramePool::~FramePool()
+	{
+		trim();
+	}
+
+	void FramePool::attach(AVCodecContext * codecContext)
+	{
+		codecContext->opaque = this;
+		codecContext->get_buffer2 = &FramePool::getBuffer;
+		codecContext->thread_safe_callbacks = 1;
+	}
+
+	void FramePool::trim()
+	{
+		std::lock_guard<std::mutex> lock(state->mutex);
+		for (std::pair<const size_t, std::vector<uint8_t*>>& bucket : state->idleBuffers)
+		{
+			for (uint8_t* data : bucket.second)
+			{
+				state->deallocate(data, bucket.first);
+				state->statistics.allocatedBytes -= bucket.first;
+			}
+		}
+		state->idleBuffers.clear();
+		state->idleBytes = 0;
+		state->statistics.idleBuffers = 0;
+	}
+
+	FramePool::Statistics FramePool::statistics() const
+	{
+		std::lock_guard<std::mutex> lock(state->mutex);
+		return state->statistics;
+	}
+
+	bool FramePool::owns(const AVFrame * frame) const
+	{
+		if (frame->buf[0] == nullptr)
+		{
+			return false;
+		}
+		std::lock_guard<std::mutex> lock(state->mutex);
+		return state->inUseBuffers.count(frame->buf[0]->data) > 0;
+	}
+
+	int FramePool::getBuffer(AVCodecContext * codecContext, AVFrame * frame, int flags)
+	{
+		const AVPixFmtDescriptor* descriptor = av_pix_fmt_desc_get(static_cast<AVPixelFormat>(frame->format));
+		if (descriptor == nullptr
+			|| (descriptor->flags & (AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_PAL)) != 0
+			|| (codecContext->codec->capabilities & AV_CODEC_CAP_DR1) == 0)
+		{
+			return avcodec_default_get_buffer2(codecContext, frame, flags);
+		}
+
+		int width = frame->width;
+		int height = frame->height;
+		int strideAlignments[AV_NUM_DATA_POINTERS];
+		avcodec_align_dimensions2(codecContext, &width, &height, strideAlignments);
+
+		int linesizes[4];
+		int status = av_image_fill_linesizes(linesizes, static_cast<AVPixelFormat>(frame->format), width);
+		if (status < 0)
+		{
+			return status;
+		}
+		for (int& linesize : linesizes)
+		{
+			linesize = FFALIGN(linesize, alignment);
+		}
+		uint8_t* planes[4] = { nullptr };
+		const int imageSize = av_image_fill_pointers(planes, static_cast<AVPixelFormat>(frame->format), height, nullptr, linesizes);
+		if (imageSize < 0)
+		{
+			return imageSize;
+		}
+
+		std::shared_ptr<State> state = static_cast<FramePool*>(codecContext->opaque)->state;
+		const size_t size = state->roundedSize(imageSize + bufferPadding);
+		uint8_t* data = nullptr;
+		{
+			std::lock_guard<std::mutex> lock(state->mutex);
+			std::vector<uint8_t*>& bucket = state->idleBuffers[size];
+			if (bucket.empty() == false)
+			{
+				data = bucket.back();
+				bucket.pop_back();
+				state->idleBytes -= size;
+				state->statistics.idleBuffers -= 1;
+				state->statistics.reuses += 1;
+			}
+		}
+		if (data == nullptr)
+		{
+			data = state->allocate(size);
+			if (data == nullptr)
+			{
+				return AVERROR(ENOMEM);
+			}
+			std::lock_guard<std::mutex> lock(state->mutex);
+			state->statistics.allocatedBytes += size;
+			state->statistics.allocations += 1;
+		}
+
+		BufferOwner* owner = new BufferOwner{ state, size };
+		frame->buf[0] = av_buffer_create(data, (int)size, &FramePool::releaseBuffer, owner, 0);
+		if (frame->buf[0] == nullptr)
+		{
+			releaseBuffer(owner, data);
+			return AVERROR(ENOMEM);
+		}
+		{
+			std::lock_guard<std::mutex> lock(state->mutex);
+			state->inUseBuffers.insert(data);
+			state->statistics.inUseBytes += size;
+			state->statistics.buffersInUse += 1;
+		}
+
+		av_image_fill_pointers(frame->data, static_cast<AVPixelFormat>(frame->format), height, data, linesizes);
+		for (int i = 0; i < 4; i++)
+		{
+			frame->linesize[i] = linesizes[i];
+		}
+		frame->extended_data = frame->data;
+		return 0;
+	}
+
+	void FramePool::releaseBuffer(void * opaque, uint8_t * data)
+	{
+		BufferOwner* owner = static_cast<BufferOwner*>(opaque);
+		std::shared_ptr<State> state = std::move(owner->state);
+		const size_t size = owner->size;
+		delete owner;
+
+		std::lock_guard<std::mutex> lock(state->mutex);
+		state->inUseBuffers.erase(data);
+		state->statistics.inUseBytes -= size;
+		state->statistics.buffersInUse -= 1;
+		if (state->maxIdleBytes > 0 && state->idleBytes + (long long)size > state->maxIdleBytes)
+		{
+			state->deallocate(data, size);
+			state->statistics.allocatedBytes -= size;
+			return;
+		}
+		state->idleBuffers[size].push_back(data);
+		state->idleBytes += size;
+		state->statistics.idleBuffers += 1;
+	}
+}
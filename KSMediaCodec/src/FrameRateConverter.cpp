@@ -0,0 +1,108 @@
+#include "FrameRateConverter.hpp"
+
+namespace ks
+{
+	FrameRateConverter * FrameRateConverter::New(VideoDecoder * decoder,
+		const MediaTime & fps,
+		const MediaTime & startTime,
+		const bool isDuplicateElided)
+	{
+		if (decoder == nullptr || fps.timeValue() <= 0 || fps.timeScale() <= 0)
+		{
+			return nullptr;
+		}
+
+		FrameRateConverter* converter = new FrameRateConverter();
+		converter->decoder = decoder;
+		converter->fps = fps;
+		converter->startTime = startTime;
+		converter->isDuplicateElided = isDuplicateElided;
+		MediaTime sourceFps = decoder->fps();
+		converter->sourceFrameDuration = sourceFps.timeValue() > 0 && sourceFps.timeScale() > 0 ? sourceFps.invert() : fps.invert();
+		return converter;
+	}
+
+	bool FrameRateConverter::nextFrame(Frame & outFrame)
+	{
+		while (isFinished == false)
+		{
+			const MediaTime tick = startTime + MediaTime(frameIndex * fps.timeScale(), fps.timeValue());
+			MediaTime sourcePts;
+			if (decoder->prepareNearestFrameAt(tick, sourcePts) == false)
+			{
+				isFinished = true;
+				break;
+			}
+			const bool isDuplicate = lastPixelBuffer && sourcePts == lastSourcePts;
+			if (isDuplicate && tick - sourcePts >= sourceFrameDuration)
+			{
+				isFinished = true;
+				break;
+			}
+			frameIndex++;
+
+			if (isDuplicate == false)
+			{
+				MediaTime pts;
+				ks::PixelBuffer* pixelBuffer = decoder->newPreparedFrame(pts);
+				if (pixelBuffer == nullptr)
+				{
+					isFinished = true;
+					break;
+				}
+				lastPixelBuffer = std::shared_ptr<const ks::PixelBuffer>(pixelBuffer);
+				lastSourcePts = sourcePts;
+				if (pendingDuplicate)
+				{
+					_statistics.elidedFrames++;
+					pendingDuplicate.reset();
+				}
+				_statistics.convertedFrames++;
+				_statistics.outputFrames++;
+				outFrame.pixelBuffer = lastPixelBuffer;
+				outFrame.pts = tick;
+				outFrame.sourcePts = sourcePts;
+				outFrame.isDuplicate = false;
+				return true;
+			}
+
+			_statistics.duplicateFrames++;
+			Frame frame;
+			frame.pixelBuffer = lastPixelBuffer;
+			frame.pts = tick;
+			frame.sourcePts = sourcePts;
+			frame.isDuplicate = true;
+			if (isDuplicateElided)
+			{
+				if (pendingDuplicate)
+				{
+					_statistics.elidedFrames++;
+				}
+				pendingDuplicate = std::make_unique<Frame>(std::move(frame));
+				continue;
+			}
+			_statistics.outputFrames++;
+			outFrame = std::move(frame);
+			return true;
+		}
+
+		if (pendingDuplicate)
+		{
+			_statistics.outputFrames++;
+			outFrame = std::move(*pendingDuplicate);
+			pendingDuplicate.reset();
+			return true;
+		}
+		return false;
+	}
+
+	MediaTime FrameRateConverter::getFps() const
+	{
+		return fps;
+	}
+
+	FrameRateConverter::Statistics FrameRateConverter::statistics() const
+	{
+		return _statistics;
+	}
+}
@@ -0,0 +1,406 @@
+#include "FrameSpillCache.hpp"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <filesystem>
+#include <functional>
+
+namespace ks
+{
+	namespace
+	{
+		const char fileMagic[8] = { 'K', 'S', 'F', 'R', 'S', 'P', 'I', 'L' };
+		const uint32_t fileVersion = 1;
+		const size_t pageSize = 4096;
+		const int lineAlignment = 64;
+
+		struct IndexEntry
+		{
+			int32_t timeValue;
+			int32_t timeScale;
+		};
+
+		size_t alignUp(const size_t value, const size_t alignment)
+		{
+			return (value + alignment - 1) / alignment * alignment;
+		}
+
+		bool sourceFileStamp(const std::string& filePath, uint64_t& outFileSize, int64_t& outModificationTime)
+		{
+			std::error_code errorCode;
+			const std::filesystem::path path = std::filesystem::u8path(filePath);
+			outFileSize = std::filesystem::file_size(path, errorCode);
+			if (errorCode)
+			{
+				return false;
+			}
+			outModificationTime = std::filesystem::last_write_time(path, errorCode).time_since_epoch().count();
+			return !errorCode;
+		}
+
+		/**
+		 * The plane layout of one slot, the same for every file with this format and size, so a reused header
+		 * can be checked against it instead of being trusted.
+		 */
+		bool fillSlotLayout(const AVPixelFormat pixelFormat, const int width, const int height, int32_t outLineSizes[4], uint64_t outPlaneOffsets[4], uint64_t& outSlotSize)
+		{
+			if (width <= 0 || height <= 0)
+			{
+				return false;
+			}
+			int lineSizes[4] = { 0, 0, 0, 0 };
+			if (av_image_fill_linesizes(lineSizes, pixelFormat, width) < 0)
+			{
+				return false;
+			}
+			for (int i = 0; i < 4; i++)
+			{
+				lineSizes[i] = (int)alignUp(lineSizes[i], lineAlignment);
+				outLineSizes[i] = lineSizes[i];
+			}
+			uint8_t* planes[4] = { nullptr, nullptr, nullptr, nullptr };
+			uint8_t* const base = reinterpret_cast<uint8_t*>(pageSize);
+			const int frameSize = av_image_fill_pointers(planes, pixelFormat, height, base, lineSizes);
+			if (frameSize <= 0)
+			{
+				return false;
+			}
+			for (int i = 0; i < 4; i++)
+			{
+				outPlaneOffsets[i] = planes[i] ? (uint64_t)(planes[i] - base) : 0;
+			}
+			outSlotSize = alignUp((size_t)frameSize, pageSize);
+			return true;
+		}
+	}
+
+	struct FrameSpillCache::FileHeader
+	{
+		char magic[8];
+		uint32_t version;
+		uint32_t formatType;
+		int32_t width;
+		int32_t height;
+		uint64_t sourceFileSize;
+		int64_t sourceModificationTime;
+		uint64_t slotSize;
+		uint64_t capacity;
+		uint64_t dataOffset;
+		uint64_t planeOffsets[4];
+		int32_t lineSizes[4];
+
+		uint64_t frameCount;
+		uint32_t isComplete;
+
+		/**
+		 * Set and flushed while a cache has the file open. Pages reach the disk in any order until the cache
+		 * flushes them on close, so frames of a file still marked open, i.e. left by a crash, are not trusted.
+		 */
+		uint32_t isOpen;
+	};
+
+	FrameSpillCache * FrameSpillCache::New(const std::string & filePath,
+		const std::string & cachePath,
+		const ks::PixelBuffer::FormatType & formatType,
+		const long long maxDiskBytes)
+	{
+		uint64_t sourceFileSize = 0;
+		int64_t sourceModificationTime = 0;
+		if (sourceFileStamp(filePath, sourceFileSize, sourceModificationTime) == false)
+		{
+			return nullptr;
+		}
+
+		std::unique_ptr<MappedFile> mappedFile;
+		{
+			FileHeader existingHeader;
+			std::ifstream stream(std::filesystem::u8path(cachePath), std::ios::binary);
+			if (stream.read(reinterpret_cast<char*>(&existingHeader), sizeof(existingHeader))
+				&& memcmp(existingHeader.magic, fileMagic, sizeof(fileMagic)) == 0
+				&& existingHeader.version == fileVersion
+				&& existingHeader.formatType == (uint32_t)formatType
+				&& existingHeader.sourceFileSize == sourceFileSize
+				&& existingHeader.sourceModificationTime == sourceModificationTime
+				&& isReusableHeader(existingHeader, VideoDecoder::getAVPixelFormat(formatType), (uint64_t)std::max(maxDiskBytes, 0LL)))
+			{
+				stream.close();
+				mappedFile = std::unique_ptr<MappedFile>(MappedFile::Create(cachePath, existingHeader.dataOffset + existingHeader.capacity * existingHeader.slotSize));
+			}
+		}
+
+		std::unique_ptr<VideoDecoder> decoder;
+		if (mappedFile == nullptr)
+		{
+			decoder = std::unique_ptr<VideoDecoder>(VideoDecoder::New(filePath, formatType));
+			if (decoder == nullptr)
+			{
+				return nullptr;
+			}
+
+			FileHeader header;
+			memset(&header, 0, sizeof(header));
+			memcpy(header.magic, fileMagic, sizeof(fileMagic));
+			header.version = fileVersion;
+			header.formatType = (uint32_t)formatType;
+			header.width = decoder->getWidth();
+			header.height = decoder->getHeight();
+			header.sourceFileSize = sourceFileSize;
+			header.sourceModificationTime = sourceModificationTime;
+
+			if (fillSlotLayout(VideoDecoder::getAVPixelFormat(formatType), header.width, header.height, header.lineSizes, header.planeOffsets, header.slotSize) == false)
+			{
+				return nullptr;
+			}
+
+			uint64_t capacity = (uint64_t)std::max(maxDiskBytes, 0LL) / (header.slotSize + sizeof(IndexEntry));
+			while (capacity > 0 && alignUp(sizeof(FileHeader) + capacity * sizeof(IndexEntry), pageSize) + capacity * header.slotSize > (uint64_t)maxDiskBytes)
+			{
+				capacity--;
+			}
+			if (capacity == 0)
+			{
+				return nullptr;
+			}
+			header.capacity = capacity;
+			header.dataOffset = alignUp(sizeof(FileHeader) + capacity * sizeof(IndexEntry), pageSize);
+
+			mappedFile = std::unique_ptr<MappedFile>(MappedFile::Create(cachePath, header.dataOffset + capacity * header.slotSize));
+			if (mappedFile == nullptr)
+			{
+				return nullptr;
+			}
+			memcpy(mappedFile->mutableData(), &header, sizeof(header));
+		}
+
+		FileHeader& header = *reinterpret_cast<FileHeader*>(mappedFile->mutableData());
+		if (header.isOpen)
+		{
+			header.frameCount = 0;
+			header.isComplete = 0;
+		}
+		header.isOpen = 1;
+		if (mappedFile->flush(0, sizeof(FileHeader)) == false)
+		{
+			return nullptr;
+		}
+
+		FrameSpillCache* cache = new FrameSpillCache();
+		cache->filePath = filePath;
+		cache->formatType = formatType;
+		cache->mappedFile = std::move(mappedFile);
+		cache->decoder = std::move(decoder);
+		return cache;
+	}
+
+	FrameSpillCache::~FrameSpillCache()
+	{
+		// The header goes last, so it is only marked closed once every frame it counts is on disk.
+		if (mappedFile->flush(0, mappedFile->size()))
+		{
+			header().isOpen = 0;
+			mappedFile->flush(0, sizeof(FileHeader));
+		}
+	}
+
+	bool FrameSpillCache::isReusableHeader(const FileHeader & fileHeader, const AVPixelFormat pixelFormat, const uint64_t maxDiskBytes)
+	{
+		int32_t lineSizes[4] = { 0, 0, 0, 0 };
+		uint64_t planeOffsets[4] = { 0, 0, 0, 0 };
+		uint64_t slotSize = 0;
+		if (fillSlotLayout(pixelFormat, fileHeader.width, fileHeader.height, lineSizes, planeOffsets, slotSize) == false
+			|| memcmp(lineSizes, fileHeader.lineSizes, sizeof(lineSizes)) != 0
+			|| memcmp(planeOffsets, fileHeader.planeOffsets, sizeof(planeOffsets)) != 0
+			|| slotSize != fileHeader.slotSize)
+		{
+			return false;
+		}
+		// Every product below is bounded by maxDiskBytes before it is formed, so none of them can wrap.
+		if (fileHeader.capacity == 0
+			|| fileHeader.capacity > maxDiskBytes / (slotSize + sizeof(IndexEntry))
+			|| fileHeader.dataOffset < sizeof(FileHeader) + fileHeader.capacity * sizeof(IndexEntry)
+			|| fileHeader.dataOffset > maxDiskBytes
+			|| fileHeader.capacity > (maxDiskBytes - fileHeader.dataOffset) / slotSize)
+		{
+			return false;
+		}
+		return fileHeader.frameCount <= fileHeader.capacity;
+	}
+
+	bool FrameSpillCache::frameAt(const MediaTime & time, FrameView & outView)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		while (true)
+		{
+			FileHeader& fileHeader = header();
+			const size_t frameCount = (size_t)fileHeader.frameCount;
+			size_t low = 0;
+			size_t high = frameCount;
+			while (low < high)
+			{
+				const size_t middle = (low + high) / 2;
+				if (indexTime(middle) <= time)
+				{
+					low = middle + 1;
+				}
+				else
+				{
+					high = middle;
+				}
+			}
+			// low is the first cached frame after time; the frame before it is displayed unless later frames are not cached yet.
+			if (frameCount > 0 && (low < frameCount || fileHeader.isComplete))
+			{
+				viewSlot(low > 0 ? low - 1 : 0, outView);
+				_statistics.hits++;
+				return true;
+			}
+			if (fileHeader.isComplete)
+			{
+				return false;
+			}
+			if (frameCount < fileHeader.capacity)
+			{
+				if (spillNextFrame() == false && fileHeader.isComplete == 0)
+				{
+					return false;
+				}
+				continue;
+			}
+
+			if (decoder == nullptr)
+			{
+				decoder = std::unique_ptr<VideoDecoder>(VideoDecoder::New(filePath, formatType));
+				if (decoder == nullptr)
+				{
+					return false;
+				}
+			}
+			MediaTime pts;
+			std::shared_ptr<const ks::PixelBuffer> pixelBuffer = std::shared_ptr<const ks::PixelBuffer>(decoder->newFrameAt(time, pts));
+			if (pixelBuffer == nullptr)
+			{
+				return false;
+			}
+			outView = FrameView();
+			outView.pts = pts;
+			outView.width = pixelBuffer->getWidth();
+			outView.height = pixelBuffer->getHeight();
+			av_image_fill_linesizes(outView.lineSize, VideoDecoder::getAVPixelFormat(formatType), outView.width);
+			const unsigned char* const* planes = pixelBuffer->getImmutableData();
+			for (int i = 0; i < 4 && outView.lineSize[i] > 0; i++)
+			{
+				outView.planeData[i] = planes[i];
+			}
+			outView.pixelBuffer = pixelBuffer;
+			_statistics.overflowFrames++;
+			return true;
+		}
+	}
+
+	bool FrameSpillCache::populate()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		while (header().isComplete == 0 && header().frameCount < header().capacity)
+		{
+			if (spillNextFrame() == false)
+			{
+				break;
+			}
+		}
+		return header().isComplete != 0;
+	}
+
+	FrameSpillCache::Statistics FrameSpillCache::statistics()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		const FileHeader& fileHeader = header();
+		Statistics statistics = _statistics;
+		statistics.frameCount = (size_t)fileHeader.frameCount;
+		statistics.capacity = (size_t)fileHeader.capacity;
+		statistics.diskUsage = (long long)(fileHeader.dataOffset + fileHeader.frameCount * fileHeader.slotSize);
+		statistics.isComplete = fileHeader.isComplete != 0;
+		return statistics;
+	}
+
+	FrameSpillCache::FileHeader & FrameSpillCache::header()
+	{
+		return *reinterpret_cast<FileHeader*>(mappedFile->mutableData());
+	}
+
+	MediaTime FrameSpillCache::indexTime(const size_t index)
+	{
+		const IndexEntry* entries = reinterpret_cast<const IndexEntry*>(mappedFile->data() + sizeof(FileHeader));
+		return MediaTime((int)entries[index].timeValue, (int)entries[index].timeScale);
+	}
+
+	void FrameSpillCache::viewSlot(const size_t index, FrameView & outView)
+	{
+		const FileHeader& fileHeader = header();
+		const unsigned char* slot = mappedFile->data() + fileHeader.dataOffset + index * fileHeader.slotSize;
+		outView = FrameView();
+		outView.pts = indexTime(index);
+		outView.width = fileHeader.width;
+		outView.height = fileHeader.height;
+		for (int i = 0; i < 4 && fileHeader.lineSizes[i] > 0; i++)
+		{
+			outView.planeData[i] = slot + fileHeader.planeOffsets[i];
+			outView.lineSize[i] = fileHeader.lineSizes[i];
+		}
+	}
+
+	bool FrameSpillCache::spillNextFrame()
+	{
+		FileHeader& fileHeader = header();
+		const size_t frameCount = (size_t)fileHeader.frameCount;
+		if (decoder == nullptr)
+		{
+			decoder = std::unique_ptr<VideoDecoder>(VideoDecoder::New(filePath, formatType));
+			if (decoder == nullptr)
+			{
+				return false;
+			}
+			// Resume after the frames an earlier run already cached.
+			if (frameCount > 0)
+			{
+				decoder->seek(indexTime(frameCount - 1));
+			}
+		}
+
+		while (true)
+		{
+			MediaTime pts;
+			std::unique_ptr<ks::PixelBuffer> pixelBuffer = std::unique_ptr<ks::PixelBuffer>(decoder->newFrame(pts));
+			if (pixelBuffer == nullptr)
+			{
+				fileHeader.isComplete = 1;
+				return false;
+			}
+			if (frameCount > 0 && pts <= indexTime(frameCount - 1))
+			{
+				continue;
+			}
+
+			const AVPixelFormat pixelFormat = VideoDecoder::getAVPixelFormat(formatType);
+			int sourceLineSizes[4] = { 0, 0, 0, 0 };
+			av_image_fill_linesizes(sourceLineSizes, pixelFormat, pixelBuffer->getWidth());
+			const unsigned char* const* sourcePlanes = pixelBuffer->getImmutableData();
+			const uint8_t* sourceData[4] = { nullptr, nullptr, nullptr, nullptr };
+			uint8_t* targetData[4] = { nullptr, nullptr, nullptr, nullptr };
+			uint8_t* slot = mappedFile->mutableData() + fileHeader.dataOffset + frameCount * fileHeader.slotSize;
+			for (int i = 0; i < 4 && fileHeader.lineSizes[i] > 0; i++)
+			{
+				sourceData[i] = sourcePlanes[i];
+				targetData[i] = slot + fileHeader.planeOffsets[i];
+			}
+			av_image_copy(targetData, fileHeader.lineSizes, sourceData, sourceLineSizes, pixelFormat,
+				std::min(pixelBuffer->getWidth(), (int)fileHeader.width), std::min(pixelBuffer->getHeight(), (int)fileHeader.height));
+
+			IndexEntry* entries = reinterpret_cast<IndexEntry*>(mappedFile->mutableData() + sizeof(FileHeader));
+			entries[frameCount].timeValue = pts.timeValue();
+			entries[frameCount].timeScale = pts.timeScale();
+			fileHeader.frameCount = frameCount + 1;
+			_statistics.spilledFrames++;
+			return true;
+		}
+	}
+}
@@ -0,0 +1,182 @@
+#include "ImageSequenceReader.hpp"
+#include <filesystem>
+#include <algorithm>
+#include "VideoDecoder.hpp"
+#include "Util.hpp"
+
+namespace ks
+{
+	ImageSequenceReader * ImageSequenceReader::New(const std::string & filePattern,
+		const ks::PixelBuffer::FormatType & formatType,
+		const MediaTime & fps,
+		const int startNumber,
+		const unsigned int threadCount,
+		const unsigned int readAheadFrames)
+	{
+		if (fps.seconds() <= 0.0)
+		{
+			return nullptr;
+		}
+		int frameCount = 0;
+		while (true)
+		{
+			const std::string filePath = imageSequenceFilePath(filePattern, startNumber + frameCount);
+			std::error_code errorCode;
+			if (filePath.empty() || std::filesystem::exists(std::filesystem::u8path(filePath), errorCode) == false)
+			{
+				break;
+			}
+			frameCount += 1;
+		}
+		if (frameCount == 0)
+		{
+			return nullptr;
+		}
+
+		std::unique_ptr<VideoDecoder> firstImage = std::unique_ptr<VideoDecoder>(VideoDecoder::New(imageSequenceFilePath(filePattern, startNumber), formatType));
+		if (firstImage == nullptr)
+		{
+			return nullptr;
+		}
+
+		ImageSequenceReader* reader = new ImageSequenceReader();
+		reader->filePattern = filePattern;
+		reader->outputFormatType = formatType;
+		reader->_fps = fps;
+		reader->startNumber = startNumber;
+		reader->_frameCount = frameCount;
+		reader->width = firstImage->getWidth();
+		reader->height = firstImage->getHeight();
+		reader->threadPool = std::make_unique<ThreadPool>(threadCount);
+		reader->readAheadFrames = readAheadFrames == 0 ? reader->threadPool->threadCount() * 2 : readAheadFrames;
+		reader->scheduleReadAhead();
+		return reader;
+	}
+
+	ImageSequenceReader::~ImageSequenceReader()
+	{
+		discardPendingOutside(0, 0);
+	}
+
+	int ImageSequenceReader::frameCount() const
+	{
+		return _frameCount;
+	}
+
+	int ImageSequenceReader::getWidth() const
+	{
+		return width;
+	}
+
+	int ImageSequenceReader::getHeight() const
+	{
+		return height;
+	}
+
+	ks::PixelBuffer * ImageSequenceReader::newFrame(MediaTime & outPts)
+	{
+		if (nextIndex >= _frameCount)
+		{
+			return nullptr;
+		}
+		scheduleReadAhead();
+		std::map<int, std::future<ks::PixelBuffer*>>::iterator iter = pendingFrames.find(nextIndex);
+		ks::PixelBuffer* pixelBuffer = iter->second.get();
+		pendingFrames.erase(iter);
+		outPts = timeAt(nextIndex);
+		nextIndex += 1;
+		scheduleReadAhead();
+		if (pixelBuffer)
+		{
+			_lastDecodedImageDisplayTime = outPts;
+		}
+		return pixelBuffer;
+	}
+
+	ks::PixelBuffer * ImageSequenceReader::newFrameAt(const MediaTime & time, MediaTime & outPts)
+	{
+		if (indexAt(time) != nextIndex && seek(time) == false)
+		{
+			return nullptr;
+		}
+		return newFrame(outPts);
+	}
+
+	bool ImageSequenceReader::seek(const MediaTime & time)
+	{
+		const int index = indexAt(time);
+		if (index < 0 || index >= _frameCount)
+		{
+			return false;
+		}
+		nextIndex = index;
+		discardPendingOutside(nextIndex, nextIndex + (int)readAheadFrames);
+		scheduleReadAhead();
+		return true;
+	}
+
+	MediaTime ImageSequenceReader::lastDecodedImageDisplayTime()
+	{
+		return _lastDecodedImageDisplayTime;
+	}
+
+	MediaTime ImageSequenceReader::fps()
+	{
+		return _fps;
+	}
+
+	int ImageSequenceReader::indexAt(const MediaTime & time) const
+	{
+		const AVRational fpsRational = _fps.getRational();
+		const int64_t index = av_rescale_rnd(time.timeValue(), fpsRational.num, (int64_t)time.timeScale() * fpsRational.den, AV_ROUND_DOWN);
+		return (int)std::min<int64_t>(index, _frameCount);
+	}
+
+	MediaTime ImageSequenceReader::timeAt(const int index) const
+	{
+		return _fps.invert() * MediaTime(index, 1);
+	}
+
+	void ImageSequenceReader::scheduleReadAhead()
+	{
+		const int endIndex = std::min(nextIndex + (int)readAheadFrames, _frameCount);
+		for (int index = nextIndex; index < endIndex; index++)
+		{
+			if (pendingFrames.find(index) != pendingFrames.end())
+			{
+				continue;
+			}
+			const std::string filePath = imageSequenceFilePath(filePattern, startNumber + index);
+			const ks::PixelBuffer::FormatType formatType = outputFormatType;
+			pendingFrames.emplace(index, threadPool->submit([filePath, formatType]()
+			{
+				return decodeImage(filePath, formatType);
+			}));
+		}
+	}
+
+	void ImageSequenceReader::discardPendingOutside(const int firstIndex, const int endIndex)
+	{
+		for (std::map<int, std::future<ks::PixelBuffer*>>::iterator iter = pendingFrames.begin(); iter != pendingFrames.end();)
+		{
+			if (iter->first >= firstIndex && iter->first < endIndex)
+			{
+				++iter;
+				continue;
+			}
+			delete iter->second.get();
+			iter = pendingFrames.erase(iter);
+		}
+	}
+
+	ks::PixelBuffer * ImageSequenceReader::decodeImage(const std::string & filePath, const ks::PixelBuffer::FormatType & formatType)
+	{
+		std::unique_ptr<VideoDecoder> decoder = std::unique_ptr<VideoDecoder>(VideoDecoder::New(filePath, formatType));
+		if (decoder == nullptr)
+		{
+			return nullptr;
+		}
+		MediaTime pts;
+		return decoder->newFrame(pts);
+	}
+}
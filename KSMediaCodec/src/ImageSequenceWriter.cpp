@@ -0,0 +1,153 @@
+#include "ImageSequenceWriter.hpp"
+#include <fstream>
+#include <filesystem>
+#include "VideoDecoder.hpp"
+#include "Util.hpp"
+
+namespace ks
+{
+	ImageSequenceWriter * ImageSequenceWriter::New(const std::string & filePattern, const int startNumber, const unsigned int threadCount)
+	{
+		const std::string firstFilePath = imageSequenceFilePath(filePattern, startNumber);
+		if (firstFilePath.empty())
+		{
+			return nullptr;
+		}
+		AVOutputFormat* imageFormat = av_guess_format("image2", nullptr, nullptr);
+		if (imageFormat == nullptr)
+		{
+			return nullptr;
+		}
+		const AVCodecID codecId = av_guess_codec(imageFormat, nullptr, firstFilePath.c_str(), nullptr, AVMEDIA_TYPE_VIDEO);
+		if (codecId == AV_CODEC_ID_NONE || avcodec_find_encoder(codecId) == nullptr)
+		{
+			return nullptr;
+		}
+
+		ImageSequenceWriter* writer = new ImageSequenceWriter();
+		writer->filePattern = filePattern;
+		writer->codecId = codecId;
+		writer->nextNumber = startNumber;
+		writer->threadPool = std::make_unique<ThreadPool>(threadCount);
+		writer->maxPendingImages = writer->threadPool->threadCount() * 2;
+		return writer;
+	}
+
+	ImageSequenceWriter::~ImageSequenceWriter()
+	{
+		finish();
+	}
+
+	void ImageSequenceWriter::write(std::unique_ptr<ks::PixelBuffer> pixelBuffer)
+	{
+		while (pendingImages.size() >= maxPendingImages)
+		{
+			hasFailed = (pendingImages.front().get() == false) || hasFailed;
+			pendingImages.pop_front();
+		}
+
+		const std::string filePath = imageSequenceFilePath(filePattern, nextNumber);
+		nextNumber += 1;
+		std::shared_ptr<ks::PixelBuffer> image = std::move(pixelBuffer);
+		const AVCodecID codecId = this->codecId;
+		std::atomic<int>* writtenCount = &_writtenCount;
+		pendingImages.push_back(threadPool->submit([filePath, codecId, image, writtenCount]()
+		{
+			if (image == nullptr || encodeImage(filePath, codecId, *image) == false)
+			{
+				return false;
+			}
+			*writtenCount += 1;
+			return true;
+		}));
+	}
+
+	bool ImageSequenceWriter::finish()
+	{
+		while (pendingImages.empty() == false)
+		{
+			hasFailed = (pendingImages.front().get() == false) || hasFailed;
+			pendingImages.pop_front();
+		}
+		return hasFailed == false;
+	}
+
+	int ImageSequenceWriter::writtenCount() const
+	{
+		return _writtenCount;
+	}
+
+	bool ImageSequenceWriter::encodeImage(const std::string & filePath, const AVCodecID codecId, const ks::PixelBuffer & pixelBuffer)
+	{
+		const AVCodec* codec = avcodec_find_encoder(codecId);
+		if (codec == nullptr)
+		{
+			return false;
+		}
+		AVCodecContext *codecContext = avcodec_alloc_context3(codec);
+		AVFrame *frame = av_frame_alloc();
+		AVPacket *packet = av_packet_alloc();
+		struct SwsContext *swsContext = nullptr;
+		defer
+		{
+			sws_freeContext(swsContext);
+			av_packet_free(&packet);
+			av_frame_free(&frame);
+			avcodec_free_context(&codecContext);
+		};
+		if (codecContext == nullptr || frame == nullptr || packet == nullptr)
+		{
+			return false;
+		}
+
+		const AVPixelFormat sourceFormat = VideoDecoder::getAVPixelFormat(pixelBuffer.getType());
+		codecContext->width = pixelBuffer.getWidth();
+		codecContext->height = pixelBuffer.getHeight();
+		codecContext->time_base = AVRational{ 1, 25 };
+		codecContext->thread_count = 1;
+		codecContext->pix_fmt = codec->pix_fmts ? avcodec_find_best_pix_fmt_of_list(codec->pix_fmts, sourceFormat, 1, nullptr) : sourceFormat;
+		if (avcodec_open2(codecContext, codec, nullptr) < 0)
+		{
+			return false;
+		}
+
+		frame->format = codecContext->pix_fmt;
+		frame->width = codecContext->width;
+		frame->height = codecContext->height;
+		if (av_frame_get_buffer(frame, 0) < 0)
+		{
+			return false;
+		}
+		int linesizes[4];
+		if (av_image_fill_linesizes(linesizes, sourceFormat, pixelBuffer.getWidth()) < 0)
+		{
+			return false;
+		}
+		swsContext = sws_getContext(pixelBuffer.getWidth(), pixelBuffer.getHeight(), sourceFormat,
+			frame->width, frame->height, codecContext->pix_fmt, SWS_BICUBIC, nullptr, nullptr, nullptr);
+		if (swsContext == nullptr)
+		{
+			return false;
+		}
+		sws_scale(swsContext, pixelBuffer.getImmutableData(), linesizes, 0, pixelBuffer.getHeight(), frame->data, frame->linesize);
+		frame->pts = 0;
+
+		if (avcodec_send_frame(codecContext, frame) < 0 || avcodec_send_frame(codecContext, nullptr) < 0)
+		{
+			return false;
+		}
+		std::ofstream stream(std::filesystem::u8path(filePath), std::ios::binary | std::ios::trunc);
+		if (stream.is_open() == false)
+		{
+			return false;
+		}
+		bool hasPacket = false;
+		while (avcodec_receive_packet(codecContext, packet) >= 0)
+		{
+			stream.write(reinterpret_cast<const char*>(packet->data), packet->size);
+			av_packet_unref(packet);
+			hasPacket = true;
+		}
+		return hasPacket && stream.good();
+	}
+}
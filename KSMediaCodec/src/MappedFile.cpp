@@ -0,0 +1,287 @@
+#include "MappedFile.hpp"
+#include <algorithm>
+#include <functional>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace ks
+{
+#ifdef _WIN32
+	MappedFile * MappedFile::Open(const std::string & filePath)
+	{
+		HANDLE fileHandle = INVALID_HANDLE_VALUE;
+		HANDLE mappingHandle = nullptr;
+		void* data = nullptr;
+		std::function<void()> cleanClosure = [&]()
+		{
+			if (data)
+			{
+				UnmapViewOfFile(data);
+			}
+			if (mappingHandle)
+			{
+				CloseHandle(mappingHandle);
+			}
+			if (fileHandle != INVALID_HANDLE_VALUE)
+			{
+				CloseHandle(fileHandle);
+			}
+		};
+
+		defer
+		{
+			cleanClosure();
+		};
+
+		fileHandle = CreateFileA(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (fileHandle == INVALID_HANDLE_VALUE)
+		{
+			return nullptr;
+		}
+		LARGE_INTEGER fileSize;
+		if (GetFileSizeEx(fileHandle, &fileSize) == FALSE || fileSize.QuadPart == 0)
+		{
+			return nullptr;
+		}
+		mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mappingHandle == nullptr)
+		{
+			return nullptr;
+		}
+		data = MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+		if (data == nullptr)
+		{
+			return nullptr;
+		}
+
+		MappedFile* mappedFile = new MappedFile();
+		mappedFile->_data = static_cast<unsigned char*>(data);
+		mappedFile->_size = (size_t)fileSize.QuadPart;
+		mappedFile->fileHandle = fileHandle;
+		mappedFile->mappingHandle = mappingHandle;
+		cleanClosure = []() {};
+		return mappedFile;
+	}
+
+	MappedFile * MappedFile::Create(const std::string & filePath, const size_t size)
+	{
+		HANDLE fileHandle = INVALID_HANDLE_VALUE;
+		HANDLE mappingHandle = nullptr;
+		void* data = nullptr;
+		std::function<void()> cleanClosure = [&]()
+		{
+			if (data)
+			{
+				UnmapViewOfFile(data);
+			}
+			if (mappingHandle)
+			{
+				CloseHandle(mappingHandle);
+			}
+			if (fileHandle != INVALID_HANDLE_VALUE)
+			{
+				CloseHandle(fileHandle);
+			}
+		};
+
+		defer
+		{
+			cleanClosure();
+		};
+
+		if (size == 0)
+		{
+			return nullptr;
+		}
+		fileHandle = CreateFileA(filePath.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (fileHandle == INVALID_HANDLE_VALUE)
+		{
+			return nullptr;
+		}
+		DWORD bytesReturned = 0;
+		DeviceIoControl(fileHandle, FSCTL_SET_SPARSE, nullptr, 0, nullptr, 0, &bytesReturned, nullptr);
+		LARGE_INTEGER fileSize;
+		fileSize.QuadPart = (LONGLONG)size;
+		if (SetFilePointerEx(fileHandle, fileSize, nullptr, FILE_BEGIN) == FALSE || SetEndOfFile(fileHandle) == FALSE)
+		{
+			return nullptr;
+		}
+		mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READWRITE, 0, 0, nullptr);
+		if (mappingHandle == nullptr)
+		{
+			return nullptr;
+		}
+		data = MapViewOfFile(mappingHandle, FILE_MAP_READ | FILE_MAP_WRITE, 0, 0, 0);
+		if (data == nullptr)
+		{
+			return nullptr;
+		}
+
+		MappedFile* mappedFile = new MappedFile();
+		mappedFile->_data = static_cast<unsigned char*>(data);
+		mappedFile->_size = size;
+		mappedFile->isWritable = true;
+		mappedFile->fileHandle = fileHandle;
+		mappedFile->mappingHandle = mappingHandle;
+		cleanClosure = []() {};
+		return mappedFile;
+	}
+
+	bool MappedFile::flush(const size_t offset, const size_t length)
+	{
+		if (isWritable == false || offset > _size)
+		{
+			return false;
+		}
+		const size_t flushLength = std::min(length, _size - offset);
+		return FlushViewOfFile(_data + offset, flushLength) != FALSE && FlushFileBuffers(fileHandle) != FALSE;
+	}
+
+	MappedFile::~MappedFile()
+	{
+		UnmapViewOfFile(_data);
+		CloseHandle(mappingHandle);
+		CloseHandle(fileHandle);
+	}
+#else
+	MappedFile * MappedFile::Open(const std::string & filePath)
+	{
+		int fileDescriptor = -1;
+		void* data = MAP_FAILED;
+		size_t size = 0;
+		std::function<void()> cleanClosure = [&]()
+		{
+			if (data != MAP_FAILED)
+			{
+				munmap(data, size);
+			}
+			if (fileDescriptor >= 0)
+			{
+				close(fileDescriptor);
+			}
+		};
+
+		defer
+		{
+			cleanClosure();
+		};
+
+		fileDescriptor = open(filePath.c_str(), O_RDONLY);
+		if (fileDescriptor < 0)
+		{
+			return nullptr;
+		}
+		struct stat fileStatus;
+		if (fstat(fileDescriptor, &fileStatus) != 0 || fileStatus.st_size == 0)
+		{
+			return nullptr;
+		}
+		size = (size_t)fileStatus.st_size;
+		data = mmap(nullptr, size, PROT_READ, MAP_SHARED, fileDescriptor, 0);
+		if (data == MAP_FAILED)
+		{
+			return nullptr;
+		}
+
+		MappedFile* mappedFile = new MappedFile();
+		mappedFile->_data = static_cast<unsigned char*>(data);
+		mappedFile->_size = size;
+		mappedFile->fileDescriptor = fileDescriptor;
+		cleanClosure = []() {};
+		return mappedFile;
+	}
+
+	MappedFile * MappedFile::Create(const std::string & filePath, const size_t size)
+	{
+		int fileDescriptor = -1;
+		void* data = MAP_FAILED;
+		std::function<void()> cleanClosure = [&]()
+		{
+			if (data != MAP_FAILED)
+			{
+				munmap(data, size);
+			}
+			if (fileDescriptor >= 0)
+			{
+				close(fileDescriptor);
+			}
+		};
+
+		defer
+		{
+			cleanClosure();
+		};
+
+		if (size == 0)
+		{
+			return nullptr;
+		}
+		fileDescriptor = open(filePath.c_str(), O_RDWR | O_CREAT, 0644);
+		if (fileDescriptor < 0)
+		{
+			return nullptr;
+		}
+		if (ftruncate(fileDescriptor, (off_t)size) != 0)
+		{
+			return nullptr;
+		}
+		data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fileDescriptor, 0);
+		if (data == MAP_FAILED)
+		{
+			return nullptr;
+		}
+
+		MappedFile* mappedFile = new MappedFile();
+		mappedFile->_data = static_cast<unsigned char*>(data);
+		mappedFile->_size = size;
+		mappedFile->isWritable = true;
+		mappedFile->fileDescriptor = fileDescriptor;
+		cleanClosure = []() {};
+		return mappedFile;
+	}
+
+	bool MappedFile::flush(const size_t offset, const size_t length)
+	{
+		if (isWritable == false || offset > _size)
+		{
+			return false;
+		}
+		// msync wants a page-aligned address; the mapping itself starts on a page boundary.
+		const size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+		const size_t alignedOffset = offset / pageSize * pageSize;
+		const size_t flushLength = std::min(length, _size - offset) + (offset - alignedOffset);
+		return msync(_data + alignedOffset, flushLength, MS_SYNC) == 0;
+	}
+
+	MappedFile::~MappedFile()
+	{
+		munmap(_data, _size);
+		close(fileDescriptor);
+	}
+#endif
+
+	const unsigned char * MappedFile::data() const
+	{
+		return _data;
+	}
+
+	unsigned char * MappedFile::mutableData()
+	{
+		return isWritable ? _data : nullptr;
+	}
+
+	size_t MappedFile::size() const
+	{
+		return _size;
+	}
+}
@@ -0,0 +1,93 @@
+#include "MediaPacket.hpp"
+#include <assert.h>
+
+namespace ks
+{
+	MediaPacket * MediaPacket::New(const AVPacket * packet, const AVRational timeBase)
+	{
+		AVPacket* reference = av_packet_clone(packet);
+		if (reference == nullptr)
+		{
+			return nullptr;
+		}
+		MediaPacket* mediaPacket = new MediaPacket();
+		mediaPacket->packet = reference;
+		mediaPacket->timeBase = timeBase;
+		return mediaPacket;
+	}
+
+	MediaPacket::~MediaPacket()
+	{
+		assert(packet);
+		av_packet_free(&packet);
+	}
+
+	MediaPacket * MediaPacket::newReference() const
+	{
+		return New(packet, timeBase);
+	}
+
+	int MediaPacket::getStreamIndex() const
+	{
+		return packet->stream_index;
+	}
+
+	AVRational MediaPacket::getTimeBase() const
+	{
+		return timeBase;
+	}
+
+	int64_t MediaPacket::getPts() const
+	{
+		return packet->pts;
+	}
+
+	int64_t MediaPacket::getDts() const
+	{
+		return packet->dts;
+	}
+
+	int64_t MediaPacket::getDuration() const
+	{
+		return packet->duration;
+	}
+
+	MediaTime MediaPacket::ptsTime() const
+	{
+		return timestampTime(packet->pts);
+	}
+
+	MediaTime MediaPacket::dtsTime() const
+	{
+		return timestampTime(packet->dts);
+	}
+
+	bool MediaPacket::isKeyframe() const
+	{
+		return (packet->flags & AV_PKT_FLAG_KEY) != 0;
+	}
+
+	const uint8_t * MediaPacket::data() const
+	{
+		return packet->data;
+	}
+
+	int MediaPacket::size() const
+	{
+		return packet->size;
+	}
+
+	const AVPacket * MediaPacket::getAVPacket() const
+	{
+		return packet;
+	}
+
+	MediaTime MediaPacket::timestampTime(const int64_t timestamp) const
+	{
+		if (timestamp == AV_NOPTS_VALUE)
+		{
+			return MediaTime::zero;
+		}
+		return MediaTime((int)(timestamp * timeBase.num), timeBase.den);
+	}
+}
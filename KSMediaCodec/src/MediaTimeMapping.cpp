@@ -10,4 +10,14 @@ namespace ks
 		: source(source), target(target)
 	{
 	}
+
+	MediaTime MediaTimeMapping::sourceTime(const MediaTime & targetTime) const
+	{
+		MediaTime offset = targetTime - target.start;
+		if (target.isEmpty() == false && source.duration() != target.duration())
+		{
+			offset = offset * source.duration() / target.duration();
+		}
+		return source.start + offset;
+	}
 }
\ No newline at end of file
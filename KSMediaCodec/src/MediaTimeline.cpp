@@ -0,0 +1,186 @@
+#include "MediaTimeline.hpp"
+#include <algorithm>
+#include <assert.h>
+
+namespace ks
+{
+	MediaTimeline::MediaTimeline()
+	{
+	}
+
+	MediaTimeline::MediaTimeline(const std::vector<MediaTimeMapping>& mappings)
+		: mappings(mappings)
+	{
+		auto compare = [](const MediaTimeMapping& lhs, const MediaTimeMapping& rhs)
+		{
+			return lhs.target.start < rhs.target.start;
+		};
+		if (std::is_sorted(this->mappings.begin(), this->mappings.end(), compare) == false)
+		{
+			std::stable_sort(this->mappings.begin(), this->mappings.end(), compare);
+		}
+		rebuildMaxTargetEnds();
+	}
+
+	void MediaTimeline::insert(const MediaTimeMapping & mapping)
+	{
+		const size_t index = upperBound(mapping.target.start);
+		mappings.insert(mappings.begin() + index, mapping);
+		rebuildMaxTargetEnds();
+	}
+
+	void MediaTimeline::clear()
+	{
+		mappings.clear();
+		maxTargetEnds.clear();
+	}
+
+	size_t MediaTimeline::count() const
+	{
+		return mappings.size();
+	}
+
+	bool MediaTimeline::isEmpty() const
+	{
+		return mappings.empty();
+	}
+
+	const MediaTimeMapping & MediaTimeline::mappingAt(const size_t index) const
+	{
+		assert(index < mappings.size());
+		return mappings[index];
+	}
+
+	const std::vector<MediaTimeMapping>& MediaTimeline::getMappings() const
+	{
+		return mappings;
+	}
+
+	MediaTimeRange MediaTimeline::targetTimeRange() const
+	{
+		if (mappings.empty())
+		{
+			return MediaTimeRange::zero;
+		}
+		return MediaTimeRange(mappings.front().target.start, maxTargetEnds[1]);
+	}
+
+	int MediaTimeline::indexOf(const MediaTime & targetTime) const
+	{
+		if (mappings.empty())
+		{
+			return -1;
+		}
+		return lastIndexEndingAfter(1, 0, mappings.size(), upperBound(targetTime), targetTime);
+	}
+
+	bool MediaTimeline::sourceTime(const MediaTime & targetTime, MediaTime & outSourceTime) const
+	{
+		const int index = indexOf(targetTime);
+		if (index < 0)
+		{
+			return false;
+		}
+		outSourceTime = mappings[index].sourceTime(targetTime);
+		return true;
+	}
+
+	std::vector<size_t> MediaTimeline::indicesOverlapping(const MediaTimeRange & targetTimeRange) const
+	{
+		std::vector<size_t> indices;
+		if (targetTimeRange.end < targetTimeRange.start)
+		{
+			return indices;
+		}
+		const bool isPoint = targetTimeRange.start == targetTimeRange.end;
+		const size_t endIndex = isPoint ? upperBound(targetTimeRange.start) : lowerBound(targetTimeRange.end);
+		if (endIndex > 0)
+		{
+			collectIndicesEndingAfter(1, 0, mappings.size(), endIndex, targetTimeRange.start, indices);
+		}
+		return indices;
+	}
+
+	std::vector<MediaTimeMapping> MediaTimeline::mappingsOverlapping(const MediaTimeRange & targetTimeRange) const
+	{
+		std::vector<MediaTimeMapping> overlapping;
+		for (const size_t index : indicesOverlapping(targetTimeRange))
+		{
+			overlapping.push_back(mappings[index]);
+		}
+		return overlapping;
+	}
+
+	void MediaTimeline::rebuildMaxTargetEnds()
+	{
+		maxTargetEnds.assign(mappings.empty() ? 0 : mappings.size() * 4, MediaTime::zero);
+		if (mappings.empty() == false)
+		{
+			buildNode(1, 0, mappings.size());
+		}
+	}
+
+	void MediaTimeline::buildNode(const size_t node, const size_t first, const size_t last)
+	{
+		if (last - first == 1)
+		{
+			maxTargetEnds[node] = mappings[first].target.end;
+			return;
+		}
+		const size_t middle = first + (last - first) / 2;
+		buildNode(node * 2, first, middle);
+		buildNode(node * 2 + 1, middle, last);
+		maxTargetEnds[node] = std::max(maxTargetEnds[node * 2], maxTargetEnds[node * 2 + 1]);
+	}
+
+	int MediaTimeline::lastIndexEndingAfter(const size_t node, const size_t first, const size_t last, const size_t endIndex, const MediaTime & time) const
+	{
+		if (first >= endIndex || maxTargetEnds[node] <= time)
+		{
+			return -1;
+		}
+		if (last - first == 1)
+		{
+			return static_cast<int>(first);
+		}
+		const size_t middle = first + (last - first) / 2;
+		const int index = lastIndexEndingAfter(node * 2 + 1, middle, last, endIndex, time);
+		return index >= 0 ? index : lastIndexEndingAfter(node * 2, first, middle, endIndex, time);
+	}
+
+	void MediaTimeline::collectIndicesEndingAfter(const size_t node, const size_t first, const size_t last, const size_t endIndex, const MediaTime & time, std::vector<size_t>& outIndices) const
+	{
+		if (first >= endIndex || maxTargetEnds[node] <= time)
+		{
+			return;
+		}
+		if (last - first == 1)
+		{
+			outIndices.push_back(first);
+			return;
+		}
+		const size_t middle = first + (last - first) / 2;
+		collectIndicesEndingAfter(node * 2, first, middle, endIndex, time, outIndices);
+		collectIndicesEndingAfter(node * 2 + 1, middle, last, endIndex, time, outIndices);
+	}
+
+	size_t MediaTimeline::upperBound(const MediaTime & time) const
+	{
+		auto iter = std::upper_bound(mappings.begin(), mappings.end(), time,
+			[](const MediaTime& time, const MediaTimeMapping& mapping)
+		{
+			return time < mapping.target.start;
+		});
+		return iter - mappings.begin();
+	}
+
+	size_t MediaTimeline::lowerBound(const MediaTime & time) const
+	{
+		auto iter = std::lower_bound(mappings.begin(), mappings.end(), time,
+			[](const MediaTimeMapping& mapping, const MediaTime& time)
+		{
+			return mapping.target.start < time;
+		});
+		return iter - mappings.begin();
+	}
+}
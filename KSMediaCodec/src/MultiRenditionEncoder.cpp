@@ -0,0 +1,322 @@
+#include "MultiRenditionEncoder.hpp"
+#include <algorithm>
+#include <filesystem>
+#include <functional>
+#include <assert.h>
+#include "VideoDecoder.hpp"
+#include "AudioDecoder.hpp"
+
+namespace ks
+{
+	MultiRenditionEncoder * MultiRenditionEncoder::New(const std::vector<Rendition>& renditions,
+		const VideoFileEncoder::AudioEncodeAttribute & audioEncodeAttribute,
+		const ks::AudioFormat & outputAudioFormat,
+		VideoFileEncoder::Error * error)
+	{
+		if (renditions.empty())
+		{
+			return nullptr;
+		}
+
+		std::vector<Rendition> sortedRenditions = renditions;
+		std::stable_sort(sortedRenditions.begin(), sortedRenditions.end(), [](const Rendition& lhs, const Rendition& rhs)
+		{
+			return (unsigned long long)lhs.videoEncodeAttribute.videoWidth * lhs.videoEncodeAttribute.videoHeight
+				> (unsigned long long)rhs.videoEncodeAttribute.videoWidth * rhs.videoEncodeAttribute.videoHeight;
+		});
+
+		std::vector<std::unique_ptr<RenditionWorker>> workers;
+		std::function<void()> cleanClosure = [&]()
+		{
+			// Outputs opened so far have headers but will never get a trailer.
+			for (std::unique_ptr<RenditionWorker>& worker : workers)
+			{
+				worker->encoder.reset();
+				std::error_code errorCode;
+				std::filesystem::remove(std::filesystem::u8path(worker->rendition.outputPath), errorCode);
+			}
+		};
+
+		defer
+		{
+			cleanClosure();
+		};
+
+		std::vector<int> globalHeaderOwners = { -1, -1 };
+		for (const Rendition& rendition : sortedRenditions)
+		{
+			std::unique_ptr<RenditionWorker> worker = std::make_unique<RenditionWorker>();
+			worker->rendition = rendition;
+
+			// Audio extradata depends on whether the container wants global headers, so outputs only share audio within that group.
+			const AVOutputFormat* outputFormat = av_guess_format(nullptr, rendition.outputPath.c_str(), nullptr);
+			const int group = outputFormat && (outputFormat->flags & AVFMT_GLOBALHEADER) ? 1 : 0;
+			VideoFileEncoder::AudioEncodeAttribute renditionAudioAttribute = audioEncodeAttribute;
+			if (globalHeaderOwners[group] < 0)
+			{
+				worker->encodesAudio = true;
+			}
+			else
+			{
+				// Only the owner encodes; this output muxes the owner's packets into a stream with its parameters.
+				worker->audioOwner = workers[globalHeaderOwners[group]].get();
+				renditionAudioAttribute.streamCopyParameters = worker->audioOwner->encoder->getAudioCodecParameters();
+				renditionAudioAttribute.streamCopyTimeBase = worker->audioOwner->encoder->getAudioTimeBase();
+			}
+			worker->encoder = std::unique_ptr<VideoFileEncoder>(VideoFileEncoder::New(rendition.outputPath,
+				rendition.videoEncodeAttribute, renditionAudioAttribute, outputAudioFormat, error));
+			if (worker->encoder == nullptr)
+			{
+				return nullptr;
+			}
+			if (worker->encodesAudio)
+			{
+				globalHeaderOwners[group] = (int)workers.size();
+			}
+			else
+			{
+				worker->audioOwner->audioTargets.push_back(worker.get());
+			}
+			workers.push_back(std::move(worker));
+		}
+
+		for (size_t i = 0; i + 1 < workers.size(); i++)
+		{
+			workers[i]->nextWorker = workers[i + 1].get();
+		}
+		for (std::unique_ptr<RenditionWorker>& worker : workers)
+		{
+			if (worker->audioTargets.empty())
+			{
+				continue;
+			}
+			std::vector<RenditionWorker*> audioTargets = worker->audioTargets;
+			worker->encoder->setPacketHandler([audioTargets](const MediaPacket& packet, const AVMediaType mediaType)
+			{
+				if (mediaType != AVMEDIA_TYPE_AUDIO)
+				{
+					return;
+				}
+				for (RenditionWorker* target : audioTargets)
+				{
+					WorkItem item;
+					item.type = WorkItem::Type::packet;
+					item.packet = std::shared_ptr<const MediaPacket>(packet.newReference());
+					push(*target, std::move(item));
+				}
+			});
+		}
+		for (std::unique_ptr<RenditionWorker>& worker : workers)
+		{
+			worker->thread = std::thread(&MultiRenditionEncoder::workerLoop, worker.get());
+		}
+
+		MultiRenditionEncoder* encoder = new MultiRenditionEncoder();
+		encoder->workers = std::move(workers);
+		cleanClosure = []() {};
+		return encoder;
+	}
+
+	MultiRenditionEncoder::~MultiRenditionEncoder()
+	{
+		if (hasEncodedTail == false)
+		{
+			encodeTail();
+		}
+		for (std::unique_ptr<RenditionWorker>& worker : workers)
+		{
+			worker->thread.join();
+			sws_freeContext(worker->swsContext);
+		}
+	}
+
+	void MultiRenditionEncoder::encode(std::shared_ptr<const ks::PixelBuffer> pixelBuffer, const ks::MediaTime & pts)
+	{
+		assert(hasEncodedTail == false);
+		WorkItem item;
+		item.type = WorkItem::Type::video;
+		item.pixelBuffer = std::move(pixelBuffer);
+		item.pts = pts;
+		push(*workers.front(), std::move(item));
+	}
+
+	void MultiRenditionEncoder::encode(const ks::AudioPCMBuffer & pcmBuffer, const ks::MediaTime & pts)
+	{
+		assert(hasEncodedTail == false);
+		const ks::AudioFormat& format = pcmBuffer.audioFormat();
+		std::shared_ptr<ks::AudioPCMBuffer> copy = std::make_shared<ks::AudioPCMBuffer>(format, pcmBuffer.samplesPerChannel());
+		av_samples_copy(copy->channelData(), const_cast<uint8_t* const*>(pcmBuffer.immutableChannelData()), 0, 0,
+			pcmBuffer.samplesPerChannel(), format.channelsPerFrame, AudioDecoder::getAVSampleFormat(format));
+		for (std::unique_ptr<RenditionWorker>& worker : workers)
+		{
+			if (worker->encodesAudio)
+			{
+				WorkItem item;
+				item.type = WorkItem::Type::audio;
+				item.pcmBuffer = copy;
+				item.pts = pts;
+				push(*worker, std::move(item));
+			}
+		}
+	}
+
+	void MultiRenditionEncoder::encodeTail()
+	{
+		if (hasEncodedTail)
+		{
+			return;
+		}
+		hasEncodedTail = true;
+
+		// The tail follows the frames down the cascade, so every rendition has all of its frames before flushing.
+		WorkItem item;
+		item.type = WorkItem::Type::tail;
+		push(*workers.front(), std::move(item));
+		for (std::unique_ptr<RenditionWorker>& worker : workers)
+		{
+			waitUntilFinished(*worker);
+		}
+	}
+
+	unsigned int MultiRenditionEncoder::getAudioSamples()
+	{
+		return workers.front()->encoder->getAudioSamples();
+	}
+
+	size_t MultiRenditionEncoder::renditionCount() const
+	{
+		return workers.size();
+	}
+
+	void MultiRenditionEncoder::push(RenditionWorker & worker, WorkItem item)
+	{
+		std::unique_lock<std::mutex> lock(worker.mutex);
+		if (item.type == WorkItem::Type::video)
+		{
+			worker.condition.wait(lock, [&worker]()
+			{
+				return worker.queuedFrames < maxQueuedFrames;
+			});
+			worker.queuedFrames += 1;
+		}
+		worker.items.push_back(std::move(item));
+		worker.condition.notify_all();
+	}
+
+	void MultiRenditionEncoder::workerLoop(RenditionWorker * worker)
+	{
+		while (true)
+		{
+			WorkItem item;
+			{
+				std::unique_lock<std::mutex> lock(worker->mutex);
+				worker->condition.wait(lock, [worker]()
+				{
+					return worker->items.empty() == false;
+				});
+				item = std::move(worker->items.front());
+				worker->items.pop_front();
+				if (item.type == WorkItem::Type::video)
+				{
+					worker->queuedFrames -= 1;
+				}
+			}
+			worker->condition.notify_all();
+
+			switch (item.type)
+			{
+			case WorkItem::Type::video:
+			{
+				// The next rendition scales from this one's frame, not from the larger source.
+				std::shared_ptr<const ks::PixelBuffer> pixelBuffer = newScaledFrame(*worker, item.pixelBuffer);
+				if (pixelBuffer == nullptr)
+				{
+					break;
+				}
+				if (worker->nextWorker)
+				{
+					WorkItem nextItem;
+					nextItem.type = WorkItem::Type::video;
+					nextItem.pixelBuffer = pixelBuffer;
+					nextItem.pts = item.pts;
+					push(*worker->nextWorker, std::move(nextItem));
+				}
+				worker->encoder->encode(*pixelBuffer, item.pts);
+				break;
+			}
+			case WorkItem::Type::audio:
+				worker->encoder->encode(*item.pcmBuffer, item.pts);
+				break;
+			case WorkItem::Type::packet:
+				worker->encoder->writePacket(*item.packet, AVMEDIA_TYPE_AUDIO);
+				break;
+			case WorkItem::Type::tail:
+				if (worker->nextWorker)
+				{
+					push(*worker->nextWorker, item);
+				}
+				if (worker->audioOwner)
+				{
+					// The owner's flushed audio packets are queued before it reports finished.
+					waitUntilFinished(*worker->audioOwner);
+					std::deque<WorkItem> packets;
+					{
+						std::lock_guard<std::mutex> lock(worker->mutex);
+						packets.swap(worker->items);
+					}
+					for (const WorkItem& packetItem : packets)
+					{
+						worker->encoder->writePacket(*packetItem.packet, AVMEDIA_TYPE_AUDIO);
+					}
+				}
+				worker->encoder->encodeTail();
+				{
+					std::lock_guard<std::mutex> lock(worker->mutex);
+					worker->isFinished = true;
+				}
+				worker->condition.notify_all();
+				return;
+			}
+		}
+	}
+
+	std::shared_ptr<const ks::PixelBuffer> MultiRenditionEncoder::newScaledFrame(RenditionWorker & worker, std::shared_ptr<const ks::PixelBuffer> source)
+	{
+		const VideoFileEncoder::VideoEncodeAttribute& attribute = worker.rendition.videoEncodeAttribute;
+		const ks::PixelBuffer& pixelBuffer = *source;
+		if (pixelBuffer.getWidth() == (int)attribute.videoWidth
+			&& pixelBuffer.getHeight() == (int)attribute.videoHeight
+			&& pixelBuffer.getType() == attribute.pixelBufferFormatType)
+		{
+			return source;
+		}
+		const AVPixelFormat sourceFormat = VideoDecoder::getAVPixelFormat(pixelBuffer.getType());
+		const AVPixelFormat targetFormat = VideoDecoder::getAVPixelFormat(attribute.pixelBufferFormatType);
+		worker.swsContext = sws_getCachedContext(worker.swsContext, pixelBuffer.getWidth(), pixelBuffer.getHeight(), sourceFormat,
+			attribute.videoWidth, attribute.videoHeight, targetFormat, SWS_BICUBIC, nullptr, nullptr, nullptr);
+		if (worker.swsContext == nullptr)
+		{
+			return nullptr;
+		}
+		int sourceLinesizes[4];
+		int targetLinesizes[4];
+		if (av_image_fill_linesizes(sourceLinesizes, sourceFormat, pixelBuffer.getWidth()) < 0
+			|| av_image_fill_linesizes(targetLinesizes, targetFormat, attribute.videoWidth) < 0)
+		{
+			return nullptr;
+		}
+		std::shared_ptr<ks::PixelBuffer> scaled = std::make_shared<ks::PixelBuffer>(attribute.videoWidth, attribute.videoHeight, attribute.pixelBufferFormatType);
+		sws_scale(worker.swsContext, pixelBuffer.getImmutableData(), sourceLinesizes, 0, pixelBuffer.getHeight(),
+			scaled->getMutableData(), targetLinesizes);
+		return scaled;
+	}
+
+	void MultiRenditionEncoder::waitUntilFinished(RenditionWorker & worker)
+	{
+		std::unique_lock<std::mutex> lock(worker.mutex);
+		worker.condition.wait(lock, [&worker]()
+		{
+			return worker.isFinished;
+		});
+	}
+}
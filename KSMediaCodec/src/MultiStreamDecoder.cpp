@@ -0,0 +1,372 @@
+#include "MultiStreamDecoder.hpp"
+#include "DecoderOpen.hpp"
+#include "VideoDecoder.hpp"
+#include "AudioDecoder.hpp"
+#include <assert.h>
+#include <functional>
+#include <algorithm>
+
+namespace ks
+{
+	MultiStreamDecoder * MultiStreamDecoder::New(const std::string & filePath,
+		const std::vector<StreamSelection>& selections,
+		const ks::PixelBuffer::FormatType & formatType,
+		const ks::AudioFormat & audioFormat)
+	{
+		AVFormatContext *formatContext = nullptr;
+		std::vector<std::unique_ptr<DecodedStream>> decodedStreams;
+		AVFrame *frame = nullptr;
+		AVPacket *packet = nullptr;
+		std::function<void()> cleanClosure = [&]()
+		{
+			for (std::unique_ptr<DecodedStream>& decodedStream : decodedStreams)
+			{
+				freeDecodedStream(*decodedStream);
+			}
+			if (packet)
+			{
+				av_packet_free(&packet);
+			}
+			if (frame)
+			{
+				av_frame_free(&frame);
+			}
+			if (formatContext)
+			{
+				avformat_close_input(&formatContext);
+				avformat_free_context(formatContext);
+			}
+		};
+
+		defer
+		{
+			cleanClosure();
+		};
+
+		// Only audio and video have a decode path; subtitle, data and attachment streams would reach the audio decoder.
+		for (const StreamSelection& selection : selections)
+		{
+			if (selection.mediaType != AVMEDIA_TYPE_AUDIO && selection.mediaType != AVMEDIA_TYPE_VIDEO)
+			{
+				return nullptr;
+			}
+		}
+
+		if (avformat_open_input(&formatContext, filePath.c_str(), nullptr, nullptr) != 0)
+		{
+			return nullptr;
+		}
+		if (avformat_find_stream_info(formatContext, nullptr) < 0)
+		{
+			return nullptr;
+		}
+
+		std::vector<int> decodedStreamIndices(formatContext->nb_streams, -1);
+		for (unsigned int i = 0; i < formatContext->nb_streams; i++)
+		{
+			AVStream* stream = formatContext->streams[i];
+			const bool isSelected = std::any_of(selections.begin(), selections.end(), [stream](const StreamSelection& selection)
+			{
+				return matchesDecoderStream(stream, selection.mediaType, selection.options);
+			});
+			if (isSelected == false)
+			{
+				stream->discard = AVDISCARD_ALL;
+				continue;
+			}
+
+			std::unique_ptr<DecodedStream> decodedStream = std::make_unique<DecodedStream>();
+			decodedStream->stream = stream;
+			decodedStream->info.streamIndex = i;
+			decodedStream->info.mediaType = stream->codecpar->codec_type;
+			decodedStream->info.disposition = stream->disposition;
+			if (const AVDictionaryEntry* entry = av_dict_get(stream->metadata, "language", nullptr, 0))
+			{
+				decodedStream->info.language = entry->value;
+			}
+			decodedStreams.push_back(std::move(decodedStream));
+			DecodedStream& current = *decodedStreams.back();
+
+			AVCodec* codec = avcodec_find_decoder(stream->codecpar->codec_id);
+			if (codec == nullptr)
+			{
+				return nullptr;
+			}
+			current.codecContext = avcodec_alloc_context3(codec);
+			if (current.codecContext == nullptr)
+			{
+				return nullptr;
+			}
+			avcodec_parameters_to_context(current.codecContext, stream->codecpar);
+			if (avcodec_open2(current.codecContext, codec, nullptr) < 0)
+			{
+				return nullptr;
+			}
+
+			if (current.info.mediaType == AVMEDIA_TYPE_AUDIO)
+			{
+				if (current.codecContext->channel_layout == 0)
+				{
+					current.codecContext->channel_layout = av_get_default_channel_layout(current.codecContext->channels);
+				}
+				current.swrContext = swr_alloc_set_opts(nullptr,
+					av_get_default_channel_layout(audioFormat.channelsPerFrame), AudioDecoder::getAVSampleFormat(audioFormat), audioFormat.sampleRate,
+					current.codecContext->channel_layout, current.codecContext->sample_fmt, current.codecContext->sample_rate,
+					0, nullptr);
+				if (current.swrContext == nullptr || swr_init(current.swrContext) < 0)
+				{
+					return nullptr;
+				}
+				current.convertedSamples.resize(std::max<unsigned int>(audioFormat.channelsPerFrame, 1), nullptr);
+			}
+			decodedStreamIndices[i] = (int)decodedStreams.size() - 1;
+		}
+		if (decodedStreams.empty())
+		{
+			return nullptr;
+		}
+
+		frame = av_frame_alloc();
+		packet = av_packet_alloc();
+		if (frame == nullptr || packet == nullptr)
+		{
+			return nullptr;
+		}
+
+		MultiStreamDecoder* decoder = new MultiStreamDecoder();
+		decoder->filePath = filePath;
+		decoder->outputFormatType = formatType;
+		decoder->outputAudioFormat = audioFormat;
+		decoder->formatContext = formatContext;
+		decoder->decodedStreams = std::move(decodedStreams);
+		decoder->decodedStreamIndices = decodedStreamIndices;
+		decoder->frame = frame;
+		decoder->packet = packet;
+		cleanClosure = []() {};
+		return decoder;
+	}
+
+	MultiStreamDecoder::~MultiStreamDecoder()
+	{
+		assert(formatContext);
+
+		for (std::unique_ptr<DecodedStream>& decodedStream : decodedStreams)
+		{
+			freeDecodedStream(*decodedStream);
+		}
+		av_packet_free(&packet);
+		av_frame_free(&frame);
+
+		avformat_close_input(&formatContext);
+		avformat_free_context(formatContext);
+	}
+
+	std::vector<MultiStreamDecoder::StreamInfo> MultiStreamDecoder::streams() const
+	{
+		std::vector<StreamInfo> infos;
+		for (const std::unique_ptr<DecodedStream>& decodedStream : decodedStreams)
+		{
+			infos.push_back(decodedStream->info);
+		}
+		return infos;
+	}
+
+	bool MultiStreamDecoder::nextFrame(Frame & outFrame)
+	{
+		while (pendingFrames.empty())
+		{
+			if (isDraining)
+			{
+				return false;
+			}
+			if (av_read_frame(formatContext, packet) < 0)
+			{
+				av_packet_unref(packet);
+				isDraining = true;
+				for (std::unique_ptr<DecodedStream>& decodedStream : decodedStreams)
+				{
+					decodePacket(*decodedStream, packet);
+				}
+				continue;
+			}
+			const int decodedStreamIndex = packet->stream_index < (int)decodedStreamIndices.size() ? decodedStreamIndices[packet->stream_index] : -1;
+			if (decodedStreamIndex >= 0)
+			{
+				decodePacket(*decodedStreams[decodedStreamIndex], packet);
+			}
+			av_packet_unref(packet);
+		}
+		outFrame = std::move(pendingFrames.front());
+		pendingFrames.pop_front();
+		return true;
+	}
+
+	bool MultiStreamDecoder::seek(const MediaTime & time)
+	{
+		const int64_t timestamp = av_rescale(time.timeValue(), AV_TIME_BASE, time.timeScale());
+		if (av_seek_frame(formatContext, -1, timestamp, AVSEEK_FLAG_BACKWARD) < 0)
+		{
+			return false;
+		}
+		for (std::unique_ptr<DecodedStream>& decodedStream : decodedStreams)
+		{
+			avcodec_flush_buffers(decodedStream->codecContext);
+			if (decodedStream->swrContext && swr_init(decodedStream->swrContext) < 0)
+			{
+				return false;
+			}
+		}
+		pendingFrames.clear();
+		isDraining = false;
+		return true;
+	}
+
+	void MultiStreamDecoder::freeDecodedStream(DecodedStream & decodedStream)
+	{
+		if (decodedStream.convertedSamples.empty() == false)
+		{
+			av_freep(&decodedStream.convertedSamples[0]);
+		}
+		if (decodedStream.swsContext)
+		{
+			sws_freeContext(decodedStream.swsContext);
+			decodedStream.swsContext = nullptr;
+		}
+		if (decodedStream.swrContext)
+		{
+			swr_close(decodedStream.swrContext);
+			swr_free(&decodedStream.swrContext);
+		}
+		if (decodedStream.codecContext)
+		{
+			avcodec_close(decodedStream.codecContext);
+			avcodec_free_context(&decodedStream.codecContext);
+		}
+	}
+
+	void MultiStreamDecoder::decodePacket(DecodedStream & decodedStream, const AVPacket * packet)
+	{
+		while (true)
+		{
+			int gotFrame = 0;
+			if (decodedStream.info.mediaType == AVMEDIA_TYPE_VIDEO)
+			{
+				avcodec_decode_video2(decodedStream.codecContext, frame, &gotFrame, packet);
+			}
+			else
+			{
+				avcodec_decode_audio4(decodedStream.codecContext, frame, &gotFrame, packet);
+			}
+
+			if (gotFrame)
+			{
+				Frame decodedFrame;
+				const bool isConverted = decodedStream.info.mediaType == AVMEDIA_TYPE_VIDEO
+					? convertVideoFrame(decodedStream, decodedFrame)
+					: convertAudioFrame(decodedStream, const_cast<const uint8_t**>(frame->extended_data), frame->nb_samples, decodedFrame);
+				if (isConverted)
+				{
+					pendingFrames.push_back(std::move(decodedFrame));
+				}
+			}
+			av_frame_unref(frame);
+
+			if (isDraining == false)
+			{
+				return;
+			}
+			if (gotFrame == false)
+			{
+				break;
+			}
+		}
+
+		if (decodedStream.swrContext)
+		{
+			Frame decodedFrame;
+			if (convertAudioFrame(decodedStream, nullptr, 0, decodedFrame))
+			{
+				pendingFrames.push_back(std::move(decodedFrame));
+			}
+		}
+	}
+
+	bool MultiStreamDecoder::convertVideoFrame(DecodedStream & decodedStream, Frame & outFrame)
+	{
+		const AVPixelFormat pixelFormat = VideoDecoder::getAVPixelFormat(outputFormatType);
+		int linesizes[4];
+		if (av_image_fill_linesizes(linesizes, pixelFormat, frame->width) < 0)
+		{
+			return false;
+		}
+		decodedStream.swsContext = sws_getCachedContext(decodedStream.swsContext, frame->width, frame->height, static_cast<AVPixelFormat>(frame->format),
+			frame->width, frame->height, pixelFormat, SWS_FAST_BILINEAR, nullptr, nullptr, nullptr);
+		if (decodedStream.swsContext == nullptr)
+		{
+			return false;
+		}
+		outFrame.pixelBuffer = std::make_unique<ks::PixelBuffer>(frame->width, frame->height, outputFormatType);
+		sws_scale(decodedStream.swsContext, frame->data,
+			frame->linesize, 0, frame->height,
+			outFrame.pixelBuffer->getMutableData(), linesizes);
+
+		const AVRational timeBase = decodedStream.stream->time_base;
+		const int64_t timestamp = frame->best_effort_timestamp == AV_NOPTS_VALUE ? frame->pts : frame->best_effort_timestamp;
+		const MediaTime start = MediaTime((int)(timestamp * timeBase.num), timeBase.den);
+		MediaTime duration = MediaTime((int)(frame->pkt_duration * timeBase.num), timeBase.den);
+		if (frame->pkt_duration <= 0)
+		{
+			const MediaTime fps = MediaTime(decodedStream.stream->avg_frame_rate);
+			duration = fps.seconds() > 0.0 ? fps.invert() : MediaTime::zero;
+		}
+		outFrame.streamIndex = decodedStream.info.streamIndex;
+		outFrame.mediaType = AVMEDIA_TYPE_VIDEO;
+		outFrame.timeRange = MediaTimeRange(start, start + duration);
+		return true;
+	}
+
+	bool MultiStreamDecoder::convertAudioFrame(DecodedStream & decodedStream, const uint8_t ** samples, const int sampleCount, Frame & outFrame)
+	{
+		const int outSampleCount = swr_get_out_samples(decodedStream.swrContext, sampleCount);
+		if (outSampleCount <= 0)
+		{
+			return false;
+		}
+		const AVSampleFormat sampleFormat = AudioDecoder::getAVSampleFormat(outputAudioFormat);
+		if (outSampleCount > decodedStream.convertedSamplesCapacity)
+		{
+			av_freep(&decodedStream.convertedSamples[0]);
+			if (av_samples_alloc(decodedStream.convertedSamples.data(), nullptr, outputAudioFormat.channelsPerFrame, outSampleCount, sampleFormat, 0) < 0)
+			{
+				decodedStream.convertedSamplesCapacity = 0;
+				return false;
+			}
+			decodedStream.convertedSamplesCapacity = outSampleCount;
+		}
+		const int convertedSampleCount = swr_convert(decodedStream.swrContext, decodedStream.convertedSamples.data(), outSampleCount, samples, sampleCount);
+		if (convertedSampleCount <= 0)
+		{
+			return false;
+		}
+
+		outFrame.pcmBuffer = std::make_unique<ks::AudioPCMBuffer>(outputAudioFormat, convertedSampleCount);
+		av_samples_copy(outFrame.pcmBuffer->channelData(), decodedStream.convertedSamples.data(), 0, 0,
+			convertedSampleCount, outputAudioFormat.channelsPerFrame, sampleFormat);
+
+		const int sampleRate = outputAudioFormat.sampleRate;
+		int64_t startSample = decodedStream.nextStartSample;
+		if (samples)
+		{
+			const int64_t timestamp = frame->best_effort_timestamp == AV_NOPTS_VALUE ? frame->pts : frame->best_effort_timestamp;
+			if (timestamp != AV_NOPTS_VALUE)
+			{
+				startSample = av_rescale_q(timestamp, decodedStream.stream->time_base, MediaTime(1, sampleRate).getRational());
+			}
+		}
+		decodedStream.nextStartSample = startSample + convertedSampleCount;
+		outFrame.streamIndex = decodedStream.info.streamIndex;
+		outFrame.mediaType = AVMEDIA_TYPE_AUDIO;
+		outFrame.timeRange = MediaTimeRange(MediaTime((int)startSample, sampleRate), MediaTime((int)(startSample + convertedSampleCount), sampleRate));
+		return true;
+	}
+}
@@ -0,0 +1,130 @@
+#include "PacketReader.hpp"
+#include <assert.h>
+#include <functional>
+
+namespace ks
+{
+	PacketReader * PacketReader::New(const std::string & filePath, const DecoderOpenOptions & options)
+	{
+		AVFormatContext *formatContext = nullptr;
+		AVPacket *packet = nullptr;
+		std::function<void()> cleanClosure = [&]()
+		{
+			if (packet)
+			{
+				av_packet_free(&packet);
+			}
+			if (formatContext)
+			{
+				avformat_close_input(&formatContext);
+				avformat_free_context(formatContext);
+			}
+		};
+
+		defer
+		{
+			cleanClosure();
+		};
+
+		formatContext = avformat_alloc_context();
+		if (formatContext == nullptr)
+		{
+			return nullptr;
+		}
+		if (options.probeSize > 0)
+		{
+			formatContext->probesize = options.probeSize;
+		}
+		if (options.analyzeDuration > 0)
+		{
+			formatContext->max_analyze_duration = options.analyzeDuration;
+		}
+		if (avformat_open_input(&formatContext, filePath.c_str(), nullptr, nullptr) != 0)
+		{
+			return nullptr;
+		}
+		if (options.streamInfoProbing != DecoderOpenOptions::StreamInfoProbing::never
+			&& avformat_find_stream_info(formatContext, nullptr) < 0)
+		{
+			return nullptr;
+		}
+
+		packet = av_packet_alloc();
+		if (packet == nullptr)
+		{
+			return nullptr;
+		}
+
+		PacketReader* reader = new PacketReader();
+		reader->filePath = filePath;
+		reader->formatContext = formatContext;
+		reader->packet = packet;
+		cleanClosure = []() {};
+		return reader;
+	}
+
+	PacketReader::~PacketReader()
+	{
+		assert(formatContext);
+		av_packet_free(&packet);
+		avformat_close_input(&formatContext);
+		avformat_free_context(formatContext);
+	}
+
+	std::string PacketReader::getFilePath() const
+	{
+		return filePath;
+	}
+
+	int PacketReader::streamCount() const
+	{
+		return formatContext->nb_streams;
+	}
+
+	AVMediaType PacketReader::mediaType(const int streamIndex) const
+	{
+		assert(streamIndex >= 0 && streamIndex < streamCount());
+		return formatContext->streams[streamIndex]->codecpar->codec_type;
+	}
+
+	AVRational PacketReader::timeBase(const int streamIndex) const
+	{
+		assert(streamIndex >= 0 && streamIndex < streamCount());
+		return formatContext->streams[streamIndex]->time_base;
+	}
+
+	const AVCodecParameters * PacketReader::codecParameters(const int streamIndex) const
+	{
+		assert(streamIndex >= 0 && streamIndex < streamCount());
+		return formatContext->streams[streamIndex]->codecpar;
+	}
+
+	void PacketReader::setStreamEnabled(const int streamIndex, const bool isEnabled)
+	{
+		assert(streamIndex >= 0 && streamIndex < streamCount());
+		formatContext->streams[streamIndex]->discard = isEnabled ? AVDISCARD_DEFAULT : AVDISCARD_ALL;
+	}
+
+	MediaPacket * PacketReader::newPacket()
+	{
+		while (av_read_frame(formatContext, packet) >= 0)
+		{
+			defer
+			{
+				av_packet_unref(packet);
+			};
+			if (formatContext->streams[packet->stream_index]->discard == AVDISCARD_ALL)
+			{
+				continue;
+			}
+			return MediaPacket::New(packet, formatContext->streams[packet->stream_index]->time_base);
+		}
+		return nullptr;
+	}
+
+	bool PacketReader::seek(const MediaTime & time)
+	{
+		const int64_t timestamp = av_rescale(time.timeValue(), AV_TIME_BASE, time.timeScale());
+		return av_seek_frame(formatContext, -1, timestamp, AVSEEK_FLAG_BACKWARD) >= 0;
+	}
+}
@@ -0,0 +1,60 @@
+#include "PlaneCopy.hpp"
+#include "VideoKernels.hpp"
+
+namespace ks
+{
+	void planeSize(const AVFrame * frame, const int plane, int & outWidth, int & outHeight)
+	{
+		outWidth = frame->width;
+		outHeight = frame->height;
+		const AVPixFmtDescriptor* descriptor = av_pix_fmt_desc_get(static_cast<AVPixelFormat>(frame->format));
+		if (descriptor && plane > 0 && (descriptor->flags & AV_PIX_FMT_FLAG_RGB) == 0 && (plane == 1 || plane == 2))
+		{
+			outWidth = AV_CEIL_RSHIFT(frame->width, descriptor->log2_chroma_w);
+			outHeight = AV_CEIL_RSHIFT(frame->height, descriptor->log2_chroma_h);
+		}
+	}
+
+	bool isPlaneCopyable(const AVFrame * frame, const int plane)
+	{
+		const AVPixFmtDescriptor* descriptor = av_pix_fmt_desc_get(static_cast<AVPixelFormat>(frame->format));
+		if (descriptor == nullptr
+			|| plane < 0 || plane >= 4 || frame->data[plane] == nullptr
+			|| (descriptor->flags & (AV_PIX_FMT_FLAG_PAL | AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_BITSTREAM)) != 0)
+		{
+			return false;
+		}
+		int components = 0;
+		for (int i = 0; i < descriptor->nb_components; i++)
+		{
+			const AVComponentDescriptor& component = descriptor->comp[i];
+			if (component.plane != plane)
+			{
+				continue;
+			}
+			if (component.depth != 8 || component.step != 1 || component.shift != 0 || component.offset != 0)
+			{
+				return false;
+			}
+			components++;
+		}
+		return components == 1;
+	}
+
+	ks::PixelBuffer * newPlaneCopy(const AVFrame * frame, const int plane, const int decimation)
+	{
+		if ((decimation != 1 && decimation != 2 && decimation != 4) || isPlaneCopyable(frame, plane) == false)
+		{
+			return nullptr;
+		}
+		int width = 0;
+		int height = 0;
+		planeSize(frame, plane, width, height);
+		const int targetWidth = (width + decimation - 1) / decimation;
+		const int targetHeight = (height + decimation - 1) / decimation;
+		ks::PixelBuffer* pixelBuffer = new ks::PixelBuffer(targetWidth, targetHeight, ks::PixelBuffer::FormatType::gray8);
+		copyPlaneDecimated(frame->data[plane], frame->linesize[plane], width, height, decimation,
+			pixelBuffer->getMutableData()[0], targetWidth);
+		return pixelBuffer;
+	}
+}
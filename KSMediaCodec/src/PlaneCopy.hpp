@@ -0,0 +1,27 @@
+#ifndef KSMediaCodec_PlaneCopy_hpp
+#define KSMediaCodec_PlaneCopy_hpp
+
+#include <Foundation/Foundation.hpp>
+#include "FFmpeg.h"
+
+namespace ks
+{
+	/**
+	 * Size in pixels of plane of frame, with the chroma subsampling of its pixel format applied.
+	 */
+	void planeSize(const AVFrame* frame, const int plane, int& outWidth, int& outHeight);
+
+	/**
+	 * Whether plane of frame holds exactly one 8-bit component per byte, e.g. Y, U or V of yuv420p but not
+	 * the interleaved UV plane of nv12, packed RGB or high bit depth formats.
+	 */
+	bool isPlaneCopyable(const AVFrame* frame, const int plane);
+
+	/**
+	 * Copies plane of frame into a gray8 PixelBuffer, keeping every decimation-th pixel of every decimation-th row.
+	 * nullptr if the plane is not copyable or decimation is not 1, 2 or 4.
+	 */
+	ks::PixelBuffer* newPlaneCopy(const AVFrame* frame, const int plane, const int decimation);
+}
+
+#endif // KSMediaCodec_PlaneCopy_hpp
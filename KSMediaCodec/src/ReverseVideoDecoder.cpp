@@ -0,0 +1,179 @@
+#include "ReverseVideoDecoder.hpp"
+#include <algorithm>
+
+namespace ks
+{
+	namespace
+	{
+		// Seeking just before a segment's first frame lands on the keyframe of the GOP before it.
+		const MediaTime seekMargin = MediaTime(1, 1000);
+		const MediaTime seekStep = MediaTime(1, 1);
+	}
+
+	ReverseVideoDecoder * ReverseVideoDecoder::New(const std::string & filePath,
+		const ks::PixelBuffer::FormatType & formatType,
+		const MediaTime & startTime,
+		const long long maxMemoryBytes)
+	{
+		std::unique_ptr<VideoDecoder> decoder = std::unique_ptr<VideoDecoder>(VideoDecoder::New(filePath, formatType));
+		if (decoder == nullptr)
+		{
+			return nullptr;
+		}
+
+		ReverseVideoDecoder* reverseDecoder = new ReverseVideoDecoder();
+		const long long frameBytes = std::max(av_image_get_buffer_size(VideoDecoder::getAVPixelFormat(formatType), decoder->getWidth(), decoder->getHeight(), 1), 1);
+		reverseDecoder->segmentFrameCount = (size_t)std::max(maxMemoryBytes / (frameBytes * 2), 1LL);
+		reverseDecoder->width = decoder->getWidth();
+		reverseDecoder->height = decoder->getHeight();
+		reverseDecoder->startTime = startTime;
+		reverseDecoder->streamStartTime = decoder->startTime();
+		reverseDecoder->decoder = std::move(decoder);
+		reverseDecoder->decodeThread = std::thread(&ReverseVideoDecoder::decodeLoop, reverseDecoder);
+		return reverseDecoder;
+	}
+
+	ReverseVideoDecoder::~ReverseVideoDecoder()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			isStopping = true;
+		}
+		condition.notify_all();
+		if (decodeThread.joinable())
+		{
+			decodeThread.join();
+		}
+	}
+
+	ks::PixelBuffer * ReverseVideoDecoder::newFrame(MediaTime & outPts)
+	{
+		if (currentSegment.empty())
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			if (readySegment == nullptr && isFinished == false)
+			{
+				_statistics.waits += 1;
+			}
+			condition.wait(lock, [this]() { return readySegment || isFinished; });
+			if (readySegment == nullptr)
+			{
+				return nullptr;
+			}
+			currentSegment = std::move(*readySegment);
+			readySegment.reset();
+			condition.notify_all();
+		}
+
+		Frame& frame = currentSegment.back();
+		ks::PixelBuffer* pixelBuffer = frame.pixelBuffer.release();
+		outPts = frame.pts;
+		currentSegment.pop_back();
+		std::lock_guard<std::mutex> lock(mutex);
+		_statistics.returnedFrames += 1;
+		return pixelBuffer;
+	}
+
+	int ReverseVideoDecoder::getWidth() const
+	{
+		return width;
+	}
+
+	int ReverseVideoDecoder::getHeight() const
+	{
+		return height;
+	}
+
+	ReverseVideoDecoder::Statistics ReverseVideoDecoder::statistics()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return _statistics;
+	}
+
+	bool ReverseVideoDecoder::decodeSegment(const MediaTime & endTime, const bool isEndIncluded, std::deque<Frame>& outFrames)
+	{
+		MediaTime seekTime = isEndIncluded ? endTime : endTime - seekMargin;
+		while (true)
+		{
+			// Streams may start far from zero, e.g. MPEG-TS offsets or mp4 edit lists; nothing lies before their start.
+			seekTime = std::max(seekTime, streamStartTime);
+			const bool isAtStreamStart = seekTime <= streamStartTime;
+			if (decoder->seek(seekTime) == false)
+			{
+				return false;
+			}
+
+			// Only the last segmentFrameCount frames before endTime are kept when the GOP is longer than that.
+			bool isFirstDecodedFrame = true;
+			while (true)
+			{
+				Frame frame;
+				frame.pixelBuffer = std::unique_ptr<ks::PixelBuffer>(decoder->newFrame(frame.pts));
+				if (frame.pixelBuffer && isAtStreamStart && isFirstDecodedFrame)
+				{
+					firstFramePts = frame.pts;
+					isFirstFrameKnown = true;
+				}
+				isFirstDecodedFrame = false;
+				if (frame.pixelBuffer == nullptr || (isEndIncluded ? frame.pts > endTime : frame.pts >= endTime))
+				{
+					break;
+				}
+				outFrames.push_back(std::move(frame));
+				if (outFrames.size() > segmentFrameCount)
+				{
+					outFrames.pop_front();
+				}
+
+				std::lock_guard<std::mutex> lock(mutex);
+				_statistics.decodedFrames += 1;
+				if (isStopping)
+				{
+					return false;
+				}
+			}
+
+			if (outFrames.empty() == false)
+			{
+				return true;
+			}
+			// The seek landed after endTime, e.g. with a sparse index, so step further back.
+			if (isAtStreamStart)
+			{
+				return false;
+			}
+			seekTime = seekTime - seekStep;
+		}
+	}
+
+	void ReverseVideoDecoder::decodeLoop()
+	{
+		MediaTime endTime = startTime;
+		bool isEndIncluded = true;
+		while (true)
+		{
+			std::unique_ptr<std::deque<Frame>> segment = std::make_unique<std::deque<Frame>>();
+			// Nothing precedes the first frame, so the last segment ends the file without another seek.
+			const bool isBeforeFirstFrame = isEndIncluded == false && isFirstFrameKnown && endTime <= firstFramePts;
+			const bool isDecoded = isBeforeFirstFrame == false && decodeSegment(endTime, isEndIncluded, *segment);
+
+			std::unique_lock<std::mutex> lock(mutex);
+			if (isDecoded == false)
+			{
+				isFinished = true;
+				condition.notify_all();
+				return;
+			}
+			endTime = segment->front().pts;
+			isEndIncluded = false;
+			_statistics.segments += 1;
+			readySegment = std::move(segment);
+			condition.notify_all();
+			condition.wait(lock, [this]() { return isStopping || readySegment == nullptr; });
+			if (isStopping)
+			{
+				return;
+			}
+		}
+	}
+}
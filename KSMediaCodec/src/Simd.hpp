@@ -0,0 +1,12 @@
+#ifndef KSMediaCodec_Simd_hpp
+#define KSMediaCodec_Simd_hpp
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define KSMediaCodec_SIMD_SSE2 1
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define KSMediaCodec_SIMD_NEON 1
+#include <arm_neon.h>
+#endif
+
+#endif // KSMediaCodec_Simd_hpp
@@ -0,0 +1,72 @@
+#include "ThreadPool.hpp"
+#include <algorithm>
+
+namespace ks
+{
+	ThreadPool::ThreadPool(const unsigned int threadCount)
+	{
+		const unsigned int count = threadCount == 0 ? defaultThreadCount() : threadCount;
+		threads.reserve(count);
+		for (unsigned int i = 0; i < count; i++)
+		{
+			threads.emplace_back([this]()
+			{
+				workerLoop();
+			});
+		}
+	}
+
+	ThreadPool::~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			isStopping = true;
+		}
+		condition.notify_all();
+		for (std::thread& thread : threads)
+		{
+			thread.join();
+		}
+	}
+
+	unsigned int ThreadPool::threadCount() const
+	{
+		return (unsigned int)threads.size();
+	}
+
+	unsigned int ThreadPool::defaultThreadCount()
+	{
+		return std::max(std::thread::hardware_concurrency(), 1u);
+	}
+
+	void ThreadPool::post(std::function<void()> task)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			tasks.push_back(std::move(task));
+		}
+		condition.notify_one();
+	}
+
+	void ThreadPool::workerLoop()
+	{
+		while (true)
+		{
+			std::function<void()> task;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				condition.wait(lock, [this]()
+				{
+					return isStopping || tasks.empty() == false;
+				});
+				if (tasks.empty())
+				{
+					return;
+				}
+				task = std::move(tasks.front());
+				tasks.pop_front();
+			}
+			task();
+		}
+	}
+}
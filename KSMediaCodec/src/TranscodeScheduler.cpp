@@ -0,0 +1,343 @@
+#include "TranscodeScheduler.hpp"
+#include "WorkStealingPool.hpp"
+#include "VideoDecoder.hpp"
+#include "AudioDecoder.hpp"
+#include <vector>
+#include <algorithm>
+
+namespace ks
+{
+	namespace
+	{
+		constexpr int chunkFrameCount = 8;
+		constexpr size_t maxQueuedChunks = 2;
+		constexpr int referenceFrameCount = 8;
+		constexpr int filesPerJob = 3;
+	}
+
+	struct TranscodeScheduler::JobState
+	{
+		struct Item
+		{
+			std::unique_ptr<ks::PixelBuffer> pixelBuffer;
+			std::unique_ptr<ks::AudioPCMBuffer> pcmBuffer;
+			MediaTime pts;
+		};
+
+		struct Chunk
+		{
+			std::vector<Item> items;
+			bool isLast = false;
+		};
+
+		Job job;
+		long long reservedMemory = 0;
+
+		std::unique_ptr<VideoDecoder> videoDecoder;
+		std::unique_ptr<AudioDecoder> audioDecoder;
+		std::unique_ptr<VideoFileEncoder> encoder;
+		bool isVideoFinished = false;
+		bool isAudioFinished = false;
+		MediaTime lastVideoPts = MediaTime::zero;
+
+		/**
+		 * Output audio clock in samples. Audio is read in blocks of the encoder's frame size.
+		 */
+		int64_t nextAudioSample = 0;
+
+		std::mutex mutex;
+		std::deque<std::unique_ptr<Chunk>> chunks;
+		bool isDecoding = false;
+		bool isEncoding = false;
+		bool isDecodeFinished = false;
+	};
+
+	TranscodeScheduler::TranscodeScheduler(const unsigned int threadCount, const long long maxMemoryBytes, const int maxOpenFiles)
+		: pool(std::make_unique<WorkStealingPool>(threadCount)), maxMemoryBytes(maxMemoryBytes), maxOpenFiles(maxOpenFiles)
+	{
+	}
+
+	TranscodeScheduler::~TranscodeScheduler()
+	{
+		waitAll();
+		pool.reset();
+	}
+
+	void TranscodeScheduler::submit(const Job & job)
+	{
+		std::shared_ptr<JobState> state = std::make_shared<JobState>();
+		state->job = job;
+		state->reservedMemory = job.estimatedMemoryBytes;
+		if (state->reservedMemory <= 0)
+		{
+			const long long frameBytes = (long long)job.videoEncodeAttribute.videoWidth * job.videoEncodeAttribute.videoHeight * 4;
+			state->reservedMemory = frameBytes * (chunkFrameCount * (long long)maxQueuedChunks + referenceFrameCount);
+		}
+
+		std::lock_guard<std::mutex> lock(mutex);
+		if (runningJobs == 0 && pendingJobs.empty())
+		{
+			busyStartTime = av_gettime_relative();
+		}
+		pendingJobs.push_back(state);
+		admitJobs();
+	}
+
+	void TranscodeScheduler::waitAll()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		idleCondition.wait(lock, [this]()
+		{
+			return runningJobs == 0 && pendingJobs.empty();
+		});
+	}
+
+	TranscodeScheduler::Statistics TranscodeScheduler::statistics()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		Statistics statistics = _statistics;
+		statistics.pendingJobs = pendingJobs.size();
+		statistics.runningJobs = runningJobs;
+		int64_t time = busyTime;
+		if (runningJobs > 0 || pendingJobs.empty() == false)
+		{
+			time += av_gettime_relative() - busyStartTime;
+		}
+		statistics.busySeconds = time / (double)AV_TIME_BASE;
+		if (statistics.busySeconds > 0.0)
+		{
+			statistics.videoFramesPerSecond = statistics.encodedVideoFrames / statistics.busySeconds;
+			statistics.jobsPerSecond = (statistics.completedJobs + statistics.failedJobs) / statistics.busySeconds;
+		}
+		return statistics;
+	}
+
+	void TranscodeScheduler::admitJobs()
+	{
+		while (pendingJobs.empty() == false)
+		{
+			std::shared_ptr<JobState> state = pendingJobs.front();
+			const bool isWithinBudget = _statistics.reservedMemory + state->reservedMemory <= maxMemoryBytes
+				&& _statistics.openFiles + filesPerJob <= maxOpenFiles;
+			if (runningJobs > 0 && isWithinBudget == false)
+			{
+				break;
+			}
+			pendingJobs.pop_front();
+			runningJobs++;
+			_statistics.reservedMemory += state->reservedMemory;
+			_statistics.openFiles += filesPerJob;
+			pool->post([this, state]()
+			{
+				openJob(state);
+			});
+		}
+	}
+
+	void TranscodeScheduler::openJob(std::shared_ptr<JobState> state)
+	{
+		const Job& job = state->job;
+		state->videoDecoder = std::unique_ptr<VideoDecoder>(VideoDecoder::New(job.inputPath, job.videoEncodeAttribute.pixelBufferFormatType));
+		if (state->videoDecoder == nullptr)
+		{
+			finishJob(state, false);
+			return;
+		}
+		state->audioDecoder = std::unique_ptr<AudioDecoder>(AudioDecoder::New(job.inputPath, job.audioFormat));
+		state->isAudioFinished = state->audioDecoder == nullptr;
+		state->encoder = std::unique_ptr<VideoFileEncoder>(VideoFileEncoder::New(job.outputPath,
+			job.videoEncodeAttribute,
+			job.audioEncodeAttribute,
+			job.audioFormat,
+			nullptr));
+		if (state->encoder == nullptr)
+		{
+			finishJob(state, false);
+			return;
+		}
+		state->isDecoding = true;
+		decodeChunk(state);
+	}
+
+	void TranscodeScheduler::decodeChunk(std::shared_ptr<JobState> state)
+	{
+		std::unique_ptr<JobState::Chunk> chunk = std::make_unique<JobState::Chunk>();
+		chunk->items.reserve(chunkFrameCount * 2);
+		const ks::AudioFormat& audioFormat = state->job.audioFormat;
+		const int audioBlockSamples = (int)state->encoder->getAudioSamples();
+		for (int i = 0; i < chunkFrameCount && (state->isVideoFinished == false || state->isAudioFinished == false); i++)
+		{
+			if (state->isVideoFinished == false)
+			{
+				JobState::Item item;
+				item.pixelBuffer = std::unique_ptr<ks::PixelBuffer>(state->videoDecoder->newFrame(item.pts));
+				if (item.pixelBuffer)
+				{
+					state->lastVideoPts = item.pts;
+					chunk->items.push_back(std::move(item));
+				}
+				else
+				{
+					state->isVideoFinished = true;
+				}
+			}
+			// Audio follows the video clock, one encoder frame at a time, so both streams reach the muxer together.
+			while (state->isAudioFinished == false
+				&& (state->isVideoFinished || MediaTime((int)state->nextAudioSample, (int)audioFormat.sampleRate) <= state->lastVideoPts))
+			{
+				const MediaTime start = MediaTime((int)state->nextAudioSample, (int)audioFormat.sampleRate);
+				const MediaTime end = MediaTime((int)(state->nextAudioSample + audioBlockSamples), (int)audioFormat.sampleRate);
+				JobState::Item item;
+				item.pcmBuffer = std::make_unique<ks::AudioPCMBuffer>(audioFormat, audioBlockSamples);
+				const int readSamples = state->audioDecoder->readSamples(MediaTimeRange(start, end), *item.pcmBuffer);
+				if (readSamples <= 0)
+				{
+					state->isAudioFinished = true;
+					break;
+				}
+				if (readSamples < audioBlockSamples)
+				{
+					av_samples_set_silence(item.pcmBuffer->channelData(), readSamples, audioBlockSamples - readSamples,
+						audioFormat.channelsPerFrame, AudioDecoder::getAVSampleFormat(audioFormat));
+					state->isAudioFinished = true;
+				}
+				item.pts = start;
+				state->nextAudioSample += audioBlockSamples;
+				chunk->items.push_back(std::move(item));
+				if (state->isVideoFinished)
+				{
+					break;
+				}
+			}
+		}
+		chunk->isLast = state->isVideoFinished && state->isAudioFinished;
+
+		bool shouldEncode = false;
+		bool shouldDecode = false;
+		{
+			std::lock_guard<std::mutex> lock(state->mutex);
+			state->chunks.push_back(std::move(chunk));
+			if (state->isEncoding == false)
+			{
+				state->isEncoding = true;
+				shouldEncode = true;
+			}
+			if (state->chunks.back()->isLast)
+			{
+				state->isDecodeFinished = true;
+			}
+			shouldDecode = state->isDecodeFinished == false && state->chunks.size() < maxQueuedChunks;
+			state->isDecoding = shouldDecode;
+		}
+		if (shouldEncode)
+		{
+			pool->post([this, state]()
+			{
+				encodeChunk(state);
+			});
+		}
+		if (shouldDecode)
+		{
+			pool->post([this, state]()
+			{
+				decodeChunk(state);
+			});
+		}
+	}
+
+	void TranscodeScheduler::encodeChunk(std::shared_ptr<JobState> state)
+	{
+		std::unique_ptr<JobState::Chunk> chunk;
+		bool shouldDecode = false;
+		{
+			std::lock_guard<std::mutex> lock(state->mutex);
+			chunk = std::move(state->chunks.front());
+			state->chunks.pop_front();
+			if (state->isDecoding == false && state->isDecodeFinished == false && state->chunks.size() < maxQueuedChunks)
+			{
+				state->isDecoding = true;
+				shouldDecode = true;
+			}
+		}
+		if (shouldDecode)
+		{
+			pool->post([this, state]()
+			{
+				decodeChunk(state);
+			});
+		}
+
+		unsigned long long encodedVideoFrames = 0;
+		unsigned long long encodedAudioFrames = 0;
+		for (JobState::Item& item : chunk->items)
+		{
+			if (item.pixelBuffer)
+			{
+				state->encoder->encode(*item.pixelBuffer, item.pts);
+				encodedVideoFrames++;
+			}
+			else
+			{
+				state->encoder->encode(*item.pcmBuffer, item.pts);
+				encodedAudioFrames++;
+			}
+		}
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			_statistics.encodedVideoFrames += encodedVideoFrames;
+			_statistics.encodedAudioFrames += encodedAudioFrames;
+		}
+		chunk.reset();
+
+		bool isLast = false;
+		bool shouldEncode = false;
+		{
+			std::lock_guard<std::mutex> lock(state->mutex);
+			isLast = state->isDecodeFinished && state->chunks.empty();
+			shouldEncode = state->chunks.empty() == false;
+			state->isEncoding = shouldEncode;
+		}
+		if (isLast)
+		{
+			state->encoder->encodeTail();
+			finishJob(state, true);
+		}
+		else if (shouldEncode)
+		{
+			pool->post([this, state]()
+			{
+				encodeChunk(state);
+			});
+		}
+	}
+
+	void TranscodeScheduler::finishJob(std::shared_ptr<JobState> state, const bool isSucceeded)
+	{
+		state->encoder.reset();
+		state->audioDecoder.reset();
+		state->videoDecoder.reset();
+		if (state->job.completion)
+		{
+			state->job.completion(isSucceeded);
+		}
+
+		std::lock_guard<std::mutex> lock(mutex);
+		runningJobs--;
+		_statistics.reservedMemory -= state->reservedMemory;
+		_statistics.openFiles -= filesPerJob;
+		if (isSucceeded)
+		{
+			_statistics.completedJobs++;
+		}
+		else
+		{
+			_statistics.failedJobs++;
+		}
+		admitJobs();
+		if (runningJobs == 0 && pendingJobs.empty())
+		{
+			busyTime += av_gettime_relative() - busyStartTime;
+			idleCondition.notify_all();
+		}
+	}
+}
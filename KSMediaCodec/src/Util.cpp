@@ -9,4 +9,14 @@ namespace ks
 		av_strerror(errorCode, errStr, sizeof(errStr));
 		return std::string(errStr);
 	}
+
+	std::string KSMediaCodec_API imageSequenceFilePath(const std::string & filePattern, const int number) noexcept
+	{
+		char filePath[4096] = { 0 };
+		if (av_get_frame_filename(filePath, sizeof(filePath), filePattern.c_str(), number) < 0)
+		{
+			return "";
+		}
+		return std::string(filePath);
+	}
 }
\ No newline at end of file
@@ -1,20 +1,71 @@
 #include "VideoDecoder.hpp"
+#include "DecoderOpen.hpp"
+#include "PlaneCopy.hpp"
+#include "ThreadPool.hpp"
+#include "FramePool.hpp"
+#include "VideoKernels.hpp"
 #include <unordered_map>
+#include <algorithm>
 #include <assert.h>
 #include <functional>
+#include <string.h>
 
 namespace ks
 {
-	VideoDecoder * VideoDecoder::New(const std::string & filePath, const ks::PixelBuffer::FormatType& formatType)
+	namespace
 	{
+		/**
+		 * Whether a frame slot holds a decoded picture. av_frame_unref and av_frame_move_ref reset the
+		 * format of an emptied slot, independently of who owns the picture's buffers.
+		 */
+		bool hasPicture(const AVFrame* frame)
+		{
+			return frame->format != -1;
+		}
+	}
+
+	struct VideoDecoder::SceneAnalysis
+	{
+		double sceneCutThreshold = 0.3;
+		AVFrame* previousFrame = nullptr;
+		struct SwsContext* graySwsContext = nullptr;
+		std::vector<uint8_t> grayPlanes[2];
+		int grayPlaneIndex = 0;
+		const uint8_t* previousLuma = nullptr;
+		int previousStride = 0;
+		int previousWidth = 0;
+		int previousHeight = 0;
+		uint32_t previousHistogram[256];
+		std::vector<FrameDifference> differences;
+
+		~SceneAnalysis()
+		{
+			av_frame_free(&previousFrame);
+			sws_freeContext(graySwsContext);
+		}
+
+		void reset()
+		{
+			av_frame_unref(previousFrame);
+			previousLuma = nullptr;
+		}
+	};
+
+	VideoDecoder * VideoDecoder::New(const std::string & filePath, const ks::PixelBuffer::FormatType& formatType, const DecoderOpenOptions& options)
+	{
+		const int64_t openStartTime = av_gettime_relative();
 		AVFormatContext *formatContext = nullptr;
 		AVStream *videoStream = nullptr;
 		AVCodecContext *videoCodecCtx = nullptr;
 		AVCodec *codec = nullptr;
 		int videoStreamIndex = -1;
 		struct SwsContext *imageSwsContext = nullptr;
+		AVFrame *currentFrame = nullptr;
+		AVFrame *lookaheadFrame = nullptr;
 		std::function<void()> cleanClosure = [&]()
 		{
+			av_frame_free(&currentFrame);
+			av_frame_free(&lookaheadFrame);
 			if (imageSwsContext)
 			{
 				sws_freeContext(imageSwsContext);
@@ -41,29 +92,13 @@ namespace ks
 		{
 			return nullptr;
 		}
-		if (avformat_open_input(&formatContext, filePath.c_str(), nullptr, nullptr) != 0)
-		{
-			return nullptr;
-		}
-
-		if (avformat_find_stream_info(formatContext, nullptr) < 0)
-		{
-			return nullptr;
-		}
 
-		for (unsigned int i = 0; i < formatContext->nb_streams; i++)
-		{
-			if (formatContext->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_VIDEO)
-			{
-				videoStreamIndex = i;
-				videoStream = formatContext->streams[i];
-				break;
-			}
-		}
-		if (videoStreamIndex == -1)
+		videoStreamIndex = openDecoderInput(formatContext, filePath, AVMEDIA_TYPE_VIDEO, options);
+		if (videoStreamIndex < 0)
 		{
 			return nullptr;
 		}
+		videoStream = formatContext->streams[videoStreamIndex];
 
 		codec = avcodec_find_decoder(videoStream->codecpar->codec_id);
 		if (codec == nullptr)
@@ -76,19 +111,35 @@ namespace ks
 			return nullptr;
 		}
 		avcodec_parameters_to_context(videoCodecCtx, videoStream->codecpar);
+		// currentFrame and lookaheadFrame hold decoded pictures across decode calls, so each must own a reference.
+		videoCodecCtx->refcounted_frames = 1;
+		if (options.framePool)
+		{
+			options.framePool->attach(videoCodecCtx);
+		}
 
 		if (avcodec_open2(videoCodecCtx, codec, nullptr) < 0)
 		{
 			return nullptr;
 		}
 
-		imageSwsContext = sws_getContext(videoCodecCtx->width, videoCodecCtx->height, videoCodecCtx->pix_fmt,
-			videoCodecCtx->width, videoCodecCtx->height, getAVPixelFormat(formatType), SWS_FAST_BILINEAR, nullptr, nullptr, nullptr);
-		if (imageSwsContext == nullptr)
+		if (videoCodecCtx->pix_fmt != AV_PIX_FMT_NONE)
+		{
+			imageSwsContext = sws_getContext(videoCodecCtx->width, videoCodecCtx->height, videoCodecCtx->pix_fmt,
+				videoCodecCtx->width, videoCodecCtx->height, getAVPixelFormat(formatType), SWS_FAST_BILINEAR, nullptr, nullptr, nullptr);
+			if (imageSwsContext == nullptr)
+			{
+				return nullptr;
+			}
+		}
+
+		currentFrame = av_frame_alloc();
+		lookaheadFrame = av_frame_alloc();
+		if (currentFrame == nullptr || lookaheadFrame == nullptr)
 		{
 			return nullptr;
 		}
-		
+
 		VideoDecoder * decoder = new VideoDecoder();
 		decoder->filePath = filePath;
 		decoder->videoCodecCtx = videoCodecCtx;
@@ -98,17 +149,24 @@ namespace ks
 		decoder->videoStream = videoStream;
 		decoder->videoStreamIndex = videoStreamIndex;
 		decoder->outputFormatType = formatType;
+		decoder->currentFrame = currentFrame;
+		decoder->lookaheadFrame = lookaheadFrame;
+		decoder->openStartTime = openStartTime;
+		decoder->openEndTime = av_gettime_relative();
 		cleanClosure = []() {};
 		return decoder;
 	}
 
 	VideoDecoder::~VideoDecoder()
 	{
-		assert(imageSwsContext);
 		assert(videoCodecCtx);
 		assert(formatContext);
 
+		av_frame_free(&currentFrame);
+		av_frame_free(&lookaheadFrame);
+
 		sws_freeContext(imageSwsContext);
+		sws_freeContext(lumaSwsContext);
 
 		avcodec_close(videoCodecCtx);
 		avcodec_free_context(&videoCodecCtx);
@@ -117,76 +175,319 @@ namespace ks
 		avformat_free_context(formatContext);
 	}
 
-	ks::PixelBuffer * VideoDecoder::newDecodedFrame(AVCodecContext * videoCodecCtx, AVFrame* frame, AVPacket* packet, MediaTime& outTime)
+	int VideoDecoder::decodeNextFrame(AVFrame * frame)
+	{
+		av_frame_unref(frame);
+		AVPacket *packet = av_packet_alloc();
+		defer
+		{
+			av_packet_free(&packet);
+		};
+
+		while (true)
+		{
+			if (isDraining == false)
+			{
+				if (av_read_frame(formatContext, packet) < 0)
+				{
+					av_packet_unref(packet);
+					isDraining = true;
+				}
+				else if (packet->stream_index != videoStreamIndex)
+				{
+					av_packet_unref(packet);
+					continue;
+				}
+			}
+
+			int gotPicture = 0;
+			avcodec_decode_video2(videoCodecCtx, frame, &gotPicture, packet);
+			av_packet_unref(packet);
+			if (gotPicture)
+			{
+				if (sceneAnalysis)
+				{
+					analyzeFrame(frame);
+				}
+				return 0;
+			}
+			if (isDraining)
+			{
+				return AVERROR_EOF;
+			}
+		}
+	}
+
+	bool VideoDecoder::takeNextFrame(AVFrame * frame)
 	{
-		int gotPicture;
-		int status = avcodec_decode_video2(videoCodecCtx, frame, &gotPicture, packet);
+		if (hasPicture(lookaheadFrame))
+		{
+			av_frame_move_ref(frame, lookaheadFrame);
+		}
+		else if (decodeNextFrame(frame) < 0)
+		{
+			return false;
+		}
+		isCurrentFrameFirstAfterSeek = hasTakenFrameAfterSeek == false;
+		hasTakenFrameAfterSeek = true;
+		return true;
+	}
 
+	ks::PixelBuffer * VideoDecoder::newConvertedFrame(const AVFrame * frame, MediaTime & outTime)
+	{
+		int linesizes[4];
+		int status = av_image_fill_linesizes(linesizes, getAVPixelFormat(outputFormatType), frame->width);
 		if (status < 0)
 		{
 			return nullptr;
 		}
-		else
+		imageSwsContext = sws_getCachedContext(imageSwsContext, frame->width, frame->height, static_cast<AVPixelFormat>(frame->format),
+			frame->width, frame->height, getAVPixelFormat(outputFormatType), SWS_FAST_BILINEAR, nullptr, nullptr, nullptr);
+		if (imageSwsContext == nullptr)
+		{
+			return nullptr;
+		}
+		ks::PixelBuffer* outPixelBuffer = new ks::PixelBuffer(frame->width, frame->height, outputFormatType);
+		unsigned char **outImageData = outPixelBuffer->getMutableData();
+
+		sws_scale(imageSwsContext, frame->data,
+			frame->linesize, 0, frame->height,
+			outImageData, linesizes);
+
+		outTime = frameTime(frame);
+		if (firstFrameTime == AV_NOPTS_VALUE)
+		{
+			firstFrameTime = av_gettime_relative();
+		}
+		return outPixelBuffer;
+	}
+
+	ks::PixelBuffer * VideoDecoder::newLumaBuffer(const AVFrame * frame, const int decimation, MediaTime & outTime)
+	{
+		if (decimation != 1 && decimation != 2 && decimation != 4)
 		{
-			int linesizes[4];
-			status = av_image_fill_linesizes(linesizes, getAVPixelFormat(outputFormatType), frame->width);
-			if (status < 0)
+			return nullptr;
+		}
+		ks::PixelBuffer* outPixelBuffer = nullptr;
+		const AVPixFmtDescriptor* descriptor = av_pix_fmt_desc_get(static_cast<AVPixelFormat>(frame->format));
+		if (descriptor && (descriptor->flags & AV_PIX_FMT_FLAG_RGB) == 0)
+		{
+			outPixelBuffer = newPlaneCopy(frame, 0, decimation);
+		}
+		if (outPixelBuffer == nullptr)
+		{
+			const int width = (frame->width + decimation - 1) / decimation;
+			const int height = (frame->height + decimation - 1) / decimation;
+			lumaSwsContext = sws_getCachedContext(lumaSwsContext, frame->width, frame->height, static_cast<AVPixelFormat>(frame->format),
+				width, height, AV_PIX_FMT_GRAY8, SWS_FAST_BILINEAR, nullptr, nullptr, nullptr);
+			if (lumaSwsContext == nullptr)
 			{
 				return nullptr;
 			}
-			ks::PixelBuffer* outPixelBuffer = new ks::PixelBuffer(videoCodecCtx->width, videoCodecCtx->height, outputFormatType);
-			unsigned char **outImageData = outPixelBuffer->getMutableData();
+			outPixelBuffer = new ks::PixelBuffer(width, height, ks::PixelBuffer::FormatType::gray8);
+			uint8_t* outData[4] = { outPixelBuffer->getMutableData()[0], nullptr, nullptr, nullptr };
+			int outLinesizes[4] = { width, 0, 0, 0 };
+			sws_scale(lumaSwsContext, frame->data, frame->linesize, 0, frame->height, outData, outLinesizes);
+		}
+
+		outTime = frameTime(frame);
+		if (firstFrameTime == AV_NOPTS_VALUE)
+		{
+			firstFrameTime = av_gettime_relative();
+		}
+		return outPixelBuffer;
+	}
+
+	MediaTime VideoDecoder::frameTime(const AVFrame * frame) const
+	{
+		int64_t timestamp = frame->best_effort_timestamp == AV_NOPTS_VALUE ? frame->pts : frame->best_effort_timestamp;
+		return MediaTime((int)(timestamp * videoStream->time_base.num), videoStream->time_base.den);
+	}
 
-			sws_scale(imageSwsContext, frame->data,
-				frame->linesize, 0, videoCodecCtx->height,
-				outImageData, linesizes);
+	MediaTime VideoDecoder::keyframeTimeAtOrBefore(const MediaTime & time) const
+	{
+		int64_t timestamp = av_rescale_q(time.timeValue(), MediaTime(1, time.timeScale()).getRational(), videoStream->time_base);
+		int index = av_index_search_timestamp(videoStream, timestamp, AVSEEK_FLAG_BACKWARD);
+		if (index < 0)
+		{
+			return MediaTime::zero;
+		}
+		return MediaTime((int)(videoStream->index_entries[index].timestamp * videoStream->time_base.num), videoStream->time_base.den);
+	}
+
+	std::string VideoDecoder::getFilePath() const
+	{
+		return filePath;
+	}
+
+	ks::PixelBuffer::FormatType VideoDecoder::getOutputFormatType() const
+	{
+		return outputFormatType;
+	}
 
-			outTime = MediaTime((int)frame->pts, videoStream->time_base.den);
-			return outPixelBuffer;
+	int VideoDecoder::getWidth() const
+	{
+		return videoCodecCtx->width;
+	}
+
+	int VideoDecoder::getHeight() const
+	{
+		return videoCodecCtx->height;
+	}
+
+	long long VideoDecoder::estimatedMemoryUsage() const
+	{
+		int frameSize = av_image_get_buffer_size(videoCodecCtx->pix_fmt, videoCodecCtx->width, videoCodecCtx->height, 1);
+		if (frameSize < 0)
+		{
+			return 0;
 		}
+		const int referenceFrames = std::max(videoCodecCtx->has_b_frames, 0) + std::max(videoCodecCtx->thread_count, 1) + 2;
+		return (long long)frameSize * referenceFrames;
 	}
 
 	ks::PixelBuffer* VideoDecoder::newFrame(MediaTime& outPts)
 	{
-		AVFrame *frame = av_frame_alloc();
-		AVPacket *packet = av_packet_alloc();
-		defer
+		av_frame_unref(currentFrame);
+		if (takeNextFrame(currentFrame) == false)
 		{
-			av_packet_free(&packet);
-			av_frame_free(&frame);
-		};
+			return nullptr;
+		}
+		ks::PixelBuffer* pixelBuffer = newConvertedFrame(currentFrame, outPts);
+		if (pixelBuffer)
+		{
+			_lastDecodedImageDisplayTime = outPts;
+		}
+		return pixelBuffer;
+	}
 
-		while (true)
+	ks::PixelBuffer * VideoDecoder::newLumaFrame(const int decimation, MediaTime & outPts)
+	{
+		av_frame_unref(currentFrame);
+		if (takeNextFrame(currentFrame) == false)
+		{
+			return nullptr;
+		}
+		ks::PixelBuffer* pixelBuffer = newLumaBuffer(currentFrame, decimation, outPts);
+		if (pixelBuffer)
+		{
+			_lastDecodedImageDisplayTime = outPts;
+		}
+		return pixelBuffer;
+	}
+
+	ks::PixelBuffer * VideoDecoder::newLumaFrameAt(const MediaTime & time, const int decimation, MediaTime & outPts)
+	{
+		if (prepareFrameAt(time) == false)
+		{
+			return nullptr;
+		}
+		ks::PixelBuffer* pixelBuffer = newLumaBuffer(currentFrame, decimation, outPts);
+		if (pixelBuffer)
+		{
+			_lastDecodedImageDisplayTime = outPts;
+		}
+		return pixelBuffer;
+	}
+
+	ks::PixelBuffer * VideoDecoder::newFrameAt(const MediaTime & time, MediaTime & outPts)
+	{
+		if (prepareFrameAt(time) == false)
+		{
+			return nullptr;
+		}
+		ks::PixelBuffer* pixelBuffer = newConvertedFrame(currentFrame, outPts);
+		if (pixelBuffer)
 		{
-			defer
+			_lastDecodedImageDisplayTime = outPts;
+		}
+		return pixelBuffer;
+	}
+
+	DecodedVideoFrame * VideoDecoder::newDecodedFrameAt(const MediaTime & time)
+	{
+		if (prepareFrameAt(time) == false)
+		{
+			return nullptr;
+		}
+		const MediaTime pts = frameTime(currentFrame);
+		_lastDecodedImageDisplayTime = pts;
+		return DecodedVideoFrame::New(currentFrame, pts);
+	}
+
+	bool VideoDecoder::prepareFrameAt(const MediaTime & time)
+	{
+		isLookaheadFrameNearest = false;
+		bool isSeekNeeded = false;
+		if (hasPicture(currentFrame))
+		{
+			const MediaTime currentTime = frameTime(currentFrame);
+			if (time < currentTime)
+			{
+				isSeekNeeded = (isCurrentFrameFirstAfterSeek && lastSeekTime <= time) == false;
+			}
+			else
 			{
-				av_packet_unref(packet);
-				av_frame_unref(frame);
-			};
+				isSeekNeeded = keyframeTimeAtOrBefore(time) > currentTime;
+			}
+		}
+		else
+		{
+			isSeekNeeded = time < lastSeekTime || keyframeTimeAtOrBefore(time) > keyframeTimeAtOrBefore(lastSeekTime);
+		}
 
-			if (av_read_frame(formatContext, packet) < 0)
+		if (isSeekNeeded && seek(time) == false)
+		{
+			return false;
+		}
+
+		if (hasPicture(currentFrame) == false && takeNextFrame(currentFrame) == false)
+		{
+			return false;
+		}
+
+		while (true)
+		{
+			if (hasPicture(lookaheadFrame) == false && decodeNextFrame(lookaheadFrame) < 0)
 			{
 				break;
 			}
-			else
+			if (frameTime(lookaheadFrame) > time)
 			{
-				if (packet->stream_index == videoStreamIndex)
-				{
-					ks::PixelBuffer* pixelBuffer = newDecodedFrame(videoCodecCtx, frame, packet, outPts);
-					if (pixelBuffer)
-					{
-						_lastDecodedImageDisplayTime = outPts;
-					}
-					return pixelBuffer;
-				}
-				else
-				{
-					continue;
-				}
+				break;
 			}
+			av_frame_unref(currentFrame);
+			av_frame_move_ref(currentFrame, lookaheadFrame);
+			isCurrentFrameFirstAfterSeek = false;
 		}
+		return true;
+	}
 
-		return nullptr;
+	bool VideoDecoder::prepareNearestFrameAt(const MediaTime & time, MediaTime & outPts)
+	{
+		if (prepareFrameAt(time) == false)
+		{
+			return false;
+		}
+		// The later frame stays in lookaheadFrame so that following times before it do not seek back.
+		isLookaheadFrameNearest = hasPicture(lookaheadFrame) && frameTime(lookaheadFrame) - time < time - frameTime(currentFrame);
+		outPts = frameTime(isLookaheadFrameNearest ? lookaheadFrame : currentFrame);
+		return true;
+	}
+
+	ks::PixelBuffer * VideoDecoder::newPreparedFrame(MediaTime & outPts)
+	{
+		const AVFrame* frame = isLookaheadFrameNearest ? lookaheadFrame : currentFrame;
+		if (hasPicture(frame) == false)
+		{
+			return nullptr;
+		}
+		ks::PixelBuffer* pixelBuffer = newConvertedFrame(frame, outPts);
+		if (pixelBuffer)
+		{
+			_lastDecodedImageDisplayTime = outPts;
+		}
+		return pixelBuffer;
 	}
 
 	bool VideoDecoder::seek(const MediaTime& time)
@@ -199,9 +500,276 @@ namespace ks
 			return false;
 		}
 		avcodec_flush_buffers(videoCodecCtx);
+		av_frame_unref(currentFrame);
+		av_frame_unref(lookaheadFrame);
+		isLookaheadFrameNearest = false;
+		isDraining = false;
+		isCurrentFrameFirstAfterSeek = false;
+		hasTakenFrameAfterSeek = false;
+		lastSeekTime = time;
+		if (sceneAnalysis)
+		{
+			sceneAnalysis->reset();
+		}
 		return true;
 	}
 
+	std::vector<ks::PixelBuffer*> VideoDecoder::extractFrames(const std::vector<MediaTime>& times, std::vector<MediaTime>& outPts)
+	{
+		std::vector<size_t> order(times.size());
+		for (size_t index = 0; index < order.size(); index++)
+		{
+			order[index] = index;
+		}
+		std::stable_sort(order.begin(), order.end(), [&times](const size_t lhs, const size_t rhs)
+		{
+			return times[lhs] < times[rhs];
+		});
+
+		std::vector<ks::PixelBuffer*> pixelBuffers(times.size(), nullptr);
+		outPts.assign(times.size(), MediaTime::zero);
+		for (const size_t index : order)
+		{
+			if (prepareFrameAt(times[index]) == false)
+			{
+				continue;
+			}
+			pixelBuffers[index] = newConvertedFrame(currentFrame, outPts[index]);
+			if (pixelBuffers[index])
+			{
+				_lastDecodedImageDisplayTime = outPts[index];
+			}
+		}
+		return pixelBuffers;
+	}
+
+	std::vector<ks::PixelBuffer*> VideoDecoder::extractFramesParallel(const std::string & filePath,
+		const ks::PixelBuffer::FormatType & formatType,
+		const std::vector<MediaTime>& times,
+		std::vector<MediaTime>& outPts,
+		const unsigned int decoderCount)
+	{
+		std::vector<ks::PixelBuffer*> pixelBuffers(times.size(), nullptr);
+		outPts.assign(times.size(), MediaTime::zero);
+		std::unique_ptr<VideoDecoder> firstDecoder = std::unique_ptr<VideoDecoder>(VideoDecoder::New(filePath, formatType));
+		if (firstDecoder == nullptr || times.empty())
+		{
+			return pixelBuffers;
+		}
+
+		std::vector<size_t> order(times.size());
+		for (size_t index = 0; index < order.size(); index++)
+		{
+			order[index] = index;
+		}
+		std::stable_sort(order.begin(), order.end(), [&times](const size_t lhs, const size_t rhs)
+		{
+			return times[lhs] < times[rhs];
+		});
+
+		const unsigned int maxDecoders = decoderCount == 0 ? ThreadPool::defaultThreadCount() : decoderCount;
+		const size_t requestsPerDecoder = (order.size() + maxDecoders - 1) / maxDecoders;
+		std::vector<std::vector<size_t>> batches(1);
+		MediaTime batchKeyframeTime = firstDecoder->keyframeTimeAtOrBefore(times[order.front()]);
+		for (const size_t index : order)
+		{
+			const MediaTime keyframeTime = firstDecoder->keyframeTimeAtOrBefore(times[index]);
+			if (batches.back().size() >= requestsPerDecoder && keyframeTime != batchKeyframeTime)
+			{
+				batches.emplace_back();
+			}
+			batchKeyframeTime = keyframeTime;
+			batches.back().push_back(index);
+		}
+
+		ThreadPool threadPool((unsigned int)batches.size());
+		std::vector<std::future<void>> tasks;
+		for (size_t batchIndex = 0; batchIndex < batches.size(); batchIndex++)
+		{
+			VideoDecoder* batchDecoder = batchIndex == 0 ? firstDecoder.get() : nullptr;
+			const std::vector<size_t>* batch = &batches[batchIndex];
+			tasks.push_back(threadPool.submit([&filePath, &formatType, &times, &pixelBuffers, &outPts, batchDecoder, batch]()
+			{
+				std::unique_ptr<VideoDecoder> ownedDecoder;
+				VideoDecoder* decoder = batchDecoder;
+				if (decoder == nullptr)
+				{
+					ownedDecoder = std::unique_ptr<VideoDecoder>(VideoDecoder::New(filePath, formatType));
+					decoder = ownedDecoder.get();
+				}
+				if (decoder == nullptr)
+				{
+					return;
+				}
+				std::vector<MediaTime> batchTimes;
+				for (const size_t index : *batch)
+				{
+					batchTimes.push_back(times[index]);
+				}
+				std::vector<MediaTime> batchPts;
+				std::vector<ks::PixelBuffer*> batchPixelBuffers = decoder->extractFrames(batchTimes, batchPts);
+				for (size_t position = 0; position < batch->size(); position++)
+				{
+					pixelBuffers[(*batch)[position]] = batchPixelBuffers[position];
+					outPts[(*batch)[position]] = batchPts[position];
+				}
+			}));
+		}
+		for (std::future<void>& task : tasks)
+		{
+			task.wait();
+		}
+		return pixelBuffers;
+	}
+
+	void VideoDecoder::setSceneAnalysisEnabled(const bool isEnabled, const double sceneCutThreshold)
+	{
+		if (isEnabled == false)
+		{
+			sceneAnalysis.reset();
+			return;
+		}
+		if (sceneAnalysis == nullptr)
+		{
+			sceneAnalysis = std::make_unique<SceneAnalysis>();
+			sceneAnalysis->previousFrame = av_frame_alloc();
+		}
+		sceneAnalysis->sceneCutThreshold = sceneCutThreshold;
+	}
+
+	std::vector<VideoDecoder::FrameDifference> VideoDecoder::takeFrameDifferences()
+	{
+		std::vector<FrameDifference> differences;
+		if (sceneAnalysis)
+		{
+			differences.swap(sceneAnalysis->differences);
+		}
+		return differences;
+	}
+
+	bool VideoDecoder::decodeThrough(const MediaTime & time)
+	{
+		if (hasPicture(currentFrame) == false && takeNextFrame(currentFrame) == false)
+		{
+			return false;
+		}
+		while (true)
+		{
+			if (hasPicture(lookaheadFrame) == false && decodeNextFrame(lookaheadFrame) < 0)
+			{
+				break;
+			}
+			if (frameTime(lookaheadFrame) > time)
+			{
+				break;
+			}
+			av_frame_unref(currentFrame);
+			av_frame_move_ref(currentFrame, lookaheadFrame);
+			isCurrentFrameFirstAfterSeek = false;
+		}
+		return true;
+	}
+
+	void VideoDecoder::analyzeFrame(const AVFrame * frame)
+	{
+		SceneAnalysis& analysis = *sceneAnalysis;
+		const AVPixFmtDescriptor* descriptor = av_pix_fmt_desc_get(static_cast<AVPixelFormat>(frame->format));
+		if (descriptor == nullptr || (descriptor->flags & AV_PIX_FMT_FLAG_HWACCEL))
+		{
+			return;
+		}
+
+		const uint8_t* luma = nullptr;
+		int stride = 0;
+		const bool isLumaPlane = (descriptor->flags & (AV_PIX_FMT_FLAG_RGB | AV_PIX_FMT_FLAG_PAL)) == 0
+			&& descriptor->comp[0].plane == 0
+			&& descriptor->comp[0].step == 1
+			&& descriptor->comp[0].depth == 8;
+		if (isLumaPlane)
+		{
+			luma = frame->data[0];
+			stride = frame->linesize[0];
+		}
+		else
+		{
+			// Packed, RGB and high bit depth frames are reduced to 8-bit gray; the two buffers alternate so the previous one stays valid.
+			analysis.graySwsContext = sws_getCachedContext(analysis.graySwsContext, frame->width, frame->height, static_cast<AVPixelFormat>(frame->format),
+				frame->width, frame->height, AV_PIX_FMT_GRAY8, SWS_POINT, nullptr, nullptr, nullptr);
+			if (analysis.graySwsContext == nullptr)
+			{
+				return;
+			}
+			std::vector<uint8_t>& grayPlane = analysis.grayPlanes[analysis.grayPlaneIndex];
+			grayPlane.resize((size_t)frame->width * frame->height);
+			uint8_t* grayData[4] = { grayPlane.data(), nullptr, nullptr, nullptr };
+			int grayLinesizes[4] = { frame->width, 0, 0, 0 };
+			sws_scale(analysis.graySwsContext, frame->data, frame->linesize, 0, frame->height, grayData, grayLinesizes);
+			luma = grayPlane.data();
+			stride = frame->width;
+		}
+
+		uint32_t histogram[256];
+		planeHistogram(luma, stride, frame->width, frame->height, histogram);
+
+		if (analysis.previousLuma && analysis.previousWidth == frame->width && analysis.previousHeight == frame->height)
+		{
+			const double pixelCount = (double)frame->width * frame->height;
+			uint64_t histogramDistance = 0;
+			for (int value = 0; value < 256; value++)
+			{
+				histogramDistance += histogram[value] > analysis.previousHistogram[value]
+					? histogram[value] - analysis.previousHistogram[value]
+					: analysis.previousHistogram[value] - histogram[value];
+			}
+			FrameDifference difference;
+			difference.pts = frameTime(frame);
+			difference.lumaDifference = sumAbsoluteDifferences(luma, stride, analysis.previousLuma, analysis.previousStride, frame->width, frame->height) / (pixelCount * 255.0);
+			difference.histogramDifference = histogramDistance / (2.0 * pixelCount);
+			difference.score = (difference.lumaDifference + difference.histogramDifference) * 0.5;
+			difference.isSceneCut = difference.score >= analysis.sceneCutThreshold;
+			analysis.differences.push_back(difference);
+		}
+
+		if (isLumaPlane)
+		{
+			av_frame_unref(analysis.previousFrame);
+			av_frame_ref(analysis.previousFrame, frame);
+			analysis.previousLuma = analysis.previousFrame->data[0];
+		}
+		else
+		{
+			analysis.previousLuma = luma;
+			analysis.grayPlaneIndex ^= 1;
+		}
+		analysis.previousStride = stride;
+		analysis.previousWidth = frame->width;
+		analysis.previousHeight = frame->height;
+		memcpy(analysis.previousHistogram, histogram, sizeof(histogram));
+	}
+
+	MediaTime VideoDecoder::openDuration() const
+	{
+		return MediaTime((int)(openEndTime - openStartTime), AV_TIME_BASE);
+	}
+
+	MediaTime VideoDecoder::startTime() const
+	{
+		if (videoStream == nullptr || videoStream->start_time == AV_NOPTS_VALUE)
+		{
+			return MediaTime::zero;
+		}
+		return MediaTime((int)(videoStream->start_time * videoStream->time_base.num), videoStream->time_base.den);
+	}
+
+	MediaTime VideoDecoder::timeToFirstFrame() const
+	{
+		if (firstFrameTime == AV_NOPTS_VALUE)
+		{
+			return MediaTime(-1.0, 600);
+		}
+		return MediaTime((int)(firstFrameTime - openStartTime), AV_TIME_BASE);
+	}
+
 	MediaTime VideoDecoder::lastDecodedImageDisplayTime()
 	{
 		return _lastDecodedImageDisplayTime;
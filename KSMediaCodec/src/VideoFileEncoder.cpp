@@ -2,6 +2,9 @@
 #include <iostream>
 #include <assert.h>
 #include <functional>
+#include <string>
+#include <algorithm>
+#include <memory>
 #include "AudioDecoder.hpp"
 #include "VideoDecoder.hpp"
 #include "Util.hpp"
@@ -12,6 +15,15 @@ namespace ks
 		const VideoEncodeAttribute& videoEncodeAttribute,
 		const ks::AudioFormat& outputAudioFormat,
 		VideoFileEncoder::Error* error)
+	{
+		return New(outputPath, videoEncodeAttribute, AudioEncodeAttribute(), outputAudioFormat, error);
+	}
+
+	VideoFileEncoder * VideoFileEncoder::New(const std::string& outputPath,
+		const VideoEncodeAttribute& videoEncodeAttribute,
+		const AudioEncodeAttribute& audioEncodeAttribute,
+		const ks::AudioFormat& outputAudioFormat,
+		VideoFileEncoder::Error* error)
 	{
 		const AVOutputFormat *outputFormat = nullptr;
 		AVFormatContext *outputFormatContext = nullptr;
@@ -23,7 +35,16 @@ namespace ks
 		const AVCodec *videoCodec = nullptr;
 		AVStream *videoStream = nullptr;
 		AVCodecContext *videoCodecContext = nullptr;
+		AVDictionary *videoOptions = nullptr;
+		AVDictionary *audioOptions = nullptr;
+		AVDictionary *formatOptions = nullptr;
 		VideoFileEncoder::Error _error;
+		defer
+		{
+			av_dict_free(&videoOptions);
+			av_dict_free(&audioOptions);
+			av_dict_free(&formatOptions);
+		};
 		std::function<void()> cleanClosure = [&]()
 		{
 			if (error)
@@ -67,7 +88,10 @@ namespace ks
 			assert(outputFormat);
 		}
 
-		if (videoCodec = avcodec_find_encoder(outputFormat->video_codec))
+		videoCodec = videoEncodeAttribute.codecName.empty()
+			? avcodec_find_encoder(outputFormat->video_codec)
+			: avcodec_find_encoder_by_name(videoEncodeAttribute.codecName.c_str());
+		if (videoCodec)
 		{
 			videoStream = avformat_new_stream(outputFormatContext, videoCodec);
 			videoCodecContext = avcodec_alloc_context3(videoCodec);
@@ -83,7 +107,25 @@ namespace ks
 			return nullptr;
 		}
 
-		if (audioCodec = avcodec_find_encoder(outputFormat->audio_codec))
+		if (audioEncodeAttribute.streamCopyParameters)
+		{
+			audioStream = avformat_new_stream(outputFormatContext, nullptr);
+			if (audioStream == nullptr)
+			{
+				_error = Error::avformat_new_stream_audio;
+				return nullptr;
+			}
+			if (avcodec_parameters_copy(audioStream->codecpar, audioEncodeAttribute.streamCopyParameters) < 0)
+			{
+				_error = Error::avcodec_parameters_copy_audio;
+				return nullptr;
+			}
+			audioStream->codecpar->codec_tag = 0;
+			audioStream->time_base = audioEncodeAttribute.streamCopyTimeBase;
+		}
+		else if ((audioCodec = audioEncodeAttribute.codecName.empty()
+			? avcodec_find_encoder(outputFormat->audio_codec)
+			: avcodec_find_encoder_by_name(audioEncodeAttribute.codecName.c_str())))
 		{
 			audioStream = avformat_new_stream(outputFormatContext, audioCodec);
 			audioCodecContext = avcodec_alloc_context3(audioCodec);
@@ -114,13 +156,65 @@ namespace ks
 		{
 			videoCodecContext->mb_decision = 2;
 		}
+		if (videoEncodeAttribute.maxBFrames >= 0)
+		{
+			videoCodecContext->max_b_frames = videoEncodeAttribute.maxBFrames;
+		}
+		if (videoEncodeAttribute.threadCount > 0)
+		{
+			videoCodecContext->thread_count = videoEncodeAttribute.threadCount;
+		}
+		if (videoEncodeAttribute.threadType != 0)
+		{
+			videoCodecContext->thread_type = videoEncodeAttribute.threadType;
+		}
+		if (videoEncodeAttribute.preset.empty() == false)
+		{
+			av_dict_set(&videoOptions, "preset", videoEncodeAttribute.preset.c_str(), 0);
+		}
+		if (videoEncodeAttribute.tune.empty() == false)
+		{
+			av_dict_set(&videoOptions, "tune", videoEncodeAttribute.tune.c_str(), 0);
+		}
+		if (videoEncodeAttribute.rateControlMode == RateControlMode::constantQuality)
+		{
+			videoCodecContext->bit_rate = 0;
+			if (videoCodecContext->priv_data && av_opt_find(videoCodecContext->priv_data, "crf", nullptr, 0, 0))
+			{
+				av_dict_set(&videoOptions, "crf", std::to_string(videoEncodeAttribute.quality).c_str(), 0);
+			}
+			else
+			{
+				videoCodecContext->flags |= AV_CODEC_FLAG_QSCALE;
+				videoCodecContext->global_quality = (int)(FF_QP2LAMBDA * videoEncodeAttribute.quality);
+			}
+		}
+		if (videoEncodeAttribute.lowLatency)
+		{
+			videoCodecContext->max_b_frames = 0;
+			videoCodecContext->thread_type = FF_THREAD_SLICE;
+			if (videoEncodeAttribute.tune.empty())
+			{
+				av_dict_set(&videoOptions, "tune", "zerolatency", 0);
+			}
+			outputFormatContext->flags |= AVFMT_FLAG_FLUSH_PACKETS;
+			outputFormatContext->max_interleave_delta = 0;
+			const std::string formatName = outputFormat->name ? outputFormat->name : "";
+			if (formatName == "mp4" || formatName == "mov" || formatName == "ismv")
+			{
+				const MediaTime frameDuration = videoEncodeAttribute.fps.invert();
+				av_dict_set(&formatOptions, "movflags", "frag_keyframe+empty_moov+default_base_moof", 0);
+				av_dict_set_int(&formatOptions, "frag_duration", std::max<int64_t>(av_rescale(frameDuration.timeValue(), AV_TIME_BASE, frameDuration.timeScale()), 1), 0);
+			}
+		}
+		av_dict_copy(&videoOptions, videoEncodeAttribute.codecOptions, 0);
 		if (outputFormat->flags & AVFMT_GLOBALHEADER)
 		{
 			videoCodecContext->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
 		}
 		videoStream->time_base = videoCodecContext->time_base;
 
-		if ((status = avcodec_open2(videoCodecContext, videoCodec, nullptr)) != 0)
+		if ((status = avcodec_open2(videoCodecContext, videoCodec, &videoOptions)) != 0)
 		{
 			_error = Error::avcodec_open2_video;
 			return nullptr;
@@ -131,26 +225,34 @@ namespace ks
 			return nullptr;
 		}
 
-		audioCodecContext->sample_fmt = AudioDecoder::getAVSampleFormat(outputAudioFormat);
-		audioCodecContext->bit_rate = 128000;
-		audioCodecContext->sample_rate = outputAudioFormat.sampleRate;
-		audioCodecContext->channel_layout = av_get_default_channel_layout(outputAudioFormat.channelsPerFrame);
-		audioCodecContext->channels = av_get_channel_layout_nb_channels(audioCodecContext->channel_layout);
-		audioCodecContext->time_base = MediaTime(1, audioCodecContext->sample_rate).getRational();
-		if (outputFormat->flags & AVFMT_GLOBALHEADER)
+		if (audioCodecContext)
 		{
-			audioCodecContext->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
-		}
-		audioStream->time_base = audioCodecContext->time_base;
-		if ((status = avcodec_open2(audioCodecContext, audioCodec, nullptr)) != 0)
-		{
-			_error = Error::avcodec_open2_audio;
-			return nullptr;
-		}
-		if ((status = avcodec_parameters_from_context(audioStream->codecpar, audioCodecContext)) < 0)
-		{
-			_error = Error::avcodec_parameters_from_context_audio;
-			return nullptr;
+			audioCodecContext->sample_fmt = AudioDecoder::getAVSampleFormat(outputAudioFormat);
+			audioCodecContext->bit_rate = audioEncodeAttribute.bitRate;
+			audioCodecContext->sample_rate = outputAudioFormat.sampleRate;
+			audioCodecContext->channel_layout = av_get_default_channel_layout(outputAudioFormat.channelsPerFrame);
+			audioCodecContext->channels = av_get_channel_layout_nb_channels(audioCodecContext->channel_layout);
+			audioCodecContext->time_base = MediaTime(1, audioCodecContext->sample_rate).getRational();
+			if (outputFormat->flags & AVFMT_GLOBALHEADER)
+			{
+				audioCodecContext->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+			}
+			if (audioEncodeAttribute.threadCount > 0)
+			{
+				audioCodecContext->thread_count = audioEncodeAttribute.threadCount;
+			}
+			audioStream->time_base = audioCodecContext->time_base;
+			av_dict_copy(&audioOptions, audioEncodeAttribute.codecOptions, 0);
+			if ((status = avcodec_open2(audioCodecContext, audioCodec, &audioOptions)) != 0)
+			{
+				_error = Error::avcodec_open2_audio;
+				return nullptr;
+			}
+			if ((status = avcodec_parameters_from_context(audioStream->codecpar, audioCodecContext)) < 0)
+			{
+				_error = Error::avcodec_parameters_from_context_audio;
+				return nullptr;
+			}
 		}
 
 		if (!(outputFormat->flags & AVFMT_NOFILE))
@@ -161,7 +263,7 @@ namespace ks
 				return nullptr;
 			}
 		}
-		if ((status = avformat_write_header(outputFormatContext, nullptr)) < 0)
+		if ((status = avformat_write_header(outputFormatContext, &formatOptions)) < 0)
 		{
 			_error = Error::avformat_write_header;
 			return nullptr;
@@ -177,16 +279,129 @@ namespace ks
 		videoFileEncoder->outputFormatContext = outputFormatContext;
 		videoFileEncoder->outputFormat = outputFormat;
 		videoFileEncoder->videoEncodeAttribute = videoEncodeAttribute;
+		videoFileEncoder->audioEncodeAttribute = audioEncodeAttribute;
 		videoFileEncoder->outputPath = outputPath;
 		videoFileEncoder->outputAudioFormat = outputAudioFormat;
 		cleanClosure = []() {};
 		return videoFileEncoder;
 	}
 
+	VideoFileEncoder * VideoFileEncoder::NewStreamCopy(const std::string & outputPath,
+		const AVCodecParameters * videoCodecParameters,
+		const AVRational videoTimeBase,
+		const AVCodecParameters * audioCodecParameters,
+		const AVRational audioTimeBase,
+		VideoFileEncoder::Error * error)
+	{
+		const AVOutputFormat *outputFormat = nullptr;
+		AVFormatContext *outputFormatContext = nullptr;
+		AVStream *videoStream = nullptr;
+		AVStream *audioStream = nullptr;
+		VideoFileEncoder::Error _error;
+		std::function<void()> cleanClosure = [&]()
+		{
+			if (error)
+			{
+				*error = _error;
+			}
+			if (outputFormatContext)
+			{
+				if (!(outputFormat->flags & AVFMT_NOFILE))
+				{
+					avio_closep(&outputFormatContext->pb);
+				}
+				avformat_free_context(outputFormatContext);
+			}
+		};
+
+		defer
+		{
+			cleanClosure();
+		};
+
+		if (avformat_alloc_output_context2(&outputFormatContext, nullptr, nullptr, outputPath.c_str()) < 0)
+		{
+			_error = Error::avformat_alloc_output_context2;
+			return nullptr;
+		}
+		outputFormat = outputFormatContext->oformat;
+		assert(outputFormat);
+
+		auto newCopyStream = [&](const AVCodecParameters* codecParameters, const AVRational timeBase, const Error newStreamError, const Error copyError) -> AVStream*
+		{
+			AVStream* stream = avformat_new_stream(outputFormatContext, nullptr);
+			if (stream == nullptr)
+			{
+				_error = newStreamError;
+				return nullptr;
+			}
+			if (avcodec_parameters_copy(stream->codecpar, codecParameters) < 0)
+			{
+				_error = copyError;
+				return nullptr;
+			}
+			// The source container's codec tag may not be valid in the output container; let the muxer choose.
+			stream->codecpar->codec_tag = 0;
+			stream->time_base = timeBase;
+			return stream;
+		};
+
+		if (videoCodecParameters == nullptr && audioCodecParameters == nullptr)
+		{
+			_error = Error::avformat_new_stream_video;
+			return nullptr;
+		}
+		if (videoCodecParameters)
+		{
+			videoStream = newCopyStream(videoCodecParameters, videoTimeBase, Error::avformat_new_stream_video, Error::avcodec_parameters_copy_video);
+			if (videoStream == nullptr)
+			{
+				return nullptr;
+			}
+		}
+		if (audioCodecParameters)
+		{
+			audioStream = newCopyStream(audioCodecParameters, audioTimeBase, Error::avformat_new_stream_audio, Error::avcodec_parameters_copy_audio);
+			if (audioStream == nullptr)
+			{
+				return nullptr;
+			}
+		}
+
+		if (!(outputFormat->flags & AVFMT_NOFILE))
+		{
+			if (avio_open(&outputFormatContext->pb, outputPath.c_str(), AVIO_FLAG_WRITE) < 0)
+			{
+				_error = Error::avio_open;
+				return nullptr;
+			}
+		}
+		if (avformat_write_header(outputFormatContext, nullptr) < 0)
+		{
+			_error = Error::avformat_write_header;
+			return nullptr;
+		}
+
+		VideoFileEncoder * videoFileEncoder = new VideoFileEncoder();
+		videoFileEncoder->videoStream = videoStream;
+		videoFileEncoder->audioStream = audioStream;
+		videoFileEncoder->outputFormatContext = outputFormatContext;
+		videoFileEncoder->outputFormat = outputFormat;
+		videoFileEncoder->videoEncodeAttribute = VideoEncodeAttribute{};
+		videoFileEncoder->outputPath = outputPath;
+		cleanClosure = []() {};
+		return videoFileEncoder;
+	}
+
 	VideoFileEncoder::~VideoFileEncoder()
 	{
-		assert(videoCodecContext);
-		assert(audioCodecContext);
+		for (std::deque<AVPacket*>& queue : interleaveQueues)
+		{
+			for (AVPacket* packet : queue)
+			{
+				av_packet_free(&packet);
+			}
+		}
 		assert(outputFormatContext);
 		avcodec_free_context(&videoCodecContext);
 		avcodec_free_context(&audioCodecContext);
@@ -200,6 +415,10 @@ namespace ks
 
 	void VideoFileEncoder::encode(const ks::PixelBuffer & pixelBuffer, const ks::MediaTime & pts)
 	{
+		if (videoCodecContext == nullptr)
+		{
+			return;
+		}
 		AVFrame *frame = av_frame_alloc();
 		defer{ av_frame_unref(frame); av_frame_free(&frame); };
 		assert(frame);
@@ -223,12 +442,18 @@ namespace ks
 			frame->data, frame->linesize);
 
 		frame->pts = pts.convertScale(videoCodecContext->time_base.den).timeValue();
+		videoFrameSubmitTimes[frame->pts] = av_gettime_relative();
+		_latencyStatistics.maxFramesInFlight = std::max(_latencyStatistics.maxFramesInFlight, videoFrameSubmitTimes.size());
 
 		encodeFrame(frame, videoCodecContext, videoStream);
 	}
 
 	void VideoFileEncoder::encode(const ks::AudioPCMBuffer & pcmBuffer, const ks::MediaTime & pts)
 	{
+		if (audioCodecContext == nullptr)
+		{
+			return;
+		}
 		struct SwrContext *audioSwrContext = swr_alloc_set_opts(nullptr,
 			audioCodecContext->channel_layout, audioCodecContext->sample_fmt, audioCodecContext->sample_rate,
 			av_get_default_channel_layout(pcmBuffer.audioFormat().channelsPerFrame), ks::AudioDecoder::getAVSampleFormat(pcmBuffer.audioFormat()), pcmBuffer.audioFormat().sampleRate,
@@ -257,18 +482,181 @@ namespace ks
 
 	void VideoFileEncoder::encodeTail()
 	{
-		encodeFrame(nullptr, videoCodecContext, videoStream);
-		encodeFrame(nullptr, audioCodecContext, audioStream);
+		if (videoCodecContext)
+		{
+			encodeFrame(nullptr, videoCodecContext, videoStream);
+		}
+		if (audioCodecContext)
+		{
+			encodeFrame(nullptr, audioCodecContext, audioStream);
+		}
+		writeInterleavedPackets(true);
 		int status = av_write_trailer(outputFormatContext);
 		assert(status == 0);
 	}
 
+	int VideoFileEncoder::writePacket(const MediaPacket & packet, const AVMediaType mediaType)
+	{
+		AVStream* stream = mediaType == AVMEDIA_TYPE_VIDEO ? videoStream : audioStream;
+		if (stream == nullptr || (mediaType != AVMEDIA_TYPE_VIDEO && mediaType != AVMEDIA_TYPE_AUDIO))
+		{
+			return AVERROR(EINVAL);
+		}
+		AVPacket *pkt = av_packet_clone(packet.getAVPacket());
+		if (pkt == nullptr)
+		{
+			return AVERROR(ENOMEM);
+		}
+		defer
+		{
+			av_packet_free(&pkt);
+		};
+		av_packet_rescale_ts(pkt, packet.getTimeBase(), stream->time_base);
+		pkt->stream_index = stream->index;
+		pkt->pos = -1;
+		return writeMuxedPacket(pkt);
+	}
+
+	VideoFileEncoder::LatencyStatistics VideoFileEncoder::latencyStatistics() const
+	{
+		return _latencyStatistics;
+	}
+
+	VideoFileEncoder::InterleaveStatistics VideoFileEncoder::interleaveStatistics() const
+	{
+		InterleaveStatistics statistics = _interleaveStatistics;
+		statistics.queuedVideoPackets = interleaveQueues[0].size();
+		statistics.queuedAudioPackets = interleaveQueues[1].size();
+		statistics.queuedBytes = interleaveQueueBytes;
+		statistics.queuedSeconds = std::max(queuedSeconds(0), queuedSeconds(1));
+		return statistics;
+	}
+
+	bool VideoFileEncoder::isBackpressured(const AVMediaType mediaType) const
+	{
+		const int queueIndex = mediaType == AVMEDIA_TYPE_VIDEO ? 0 : 1;
+		if (interleaveQueues[queueIndex].empty() || interleaveQueues[1 - queueIndex].empty() == false)
+		{
+			return false;
+		}
+		return interleaveQueueBytes * 2 > videoEncodeAttribute.interleaveMaxBytes
+			|| queuedSeconds(queueIndex) * 2 > videoEncodeAttribute.interleaveMaxSeconds;
+	}
+
+	void VideoFileEncoder::setPacketHandler(std::function<void(const MediaPacket& packet, const AVMediaType mediaType)> packetHandler)
+	{
+		this->packetHandler = packetHandler;
+	}
+
 	unsigned int ks::VideoFileEncoder::getAudioSamples()
 	{
-		assert(audioCodecContext);
+		if (audioCodecContext == nullptr)
+		{
+			return 0;
+		}
 		return audioCodecContext->frame_size == 0 ? 1024 : audioCodecContext->frame_size;
 	}
 
+	const AVCodecParameters * VideoFileEncoder::getAudioCodecParameters() const
+	{
+		return audioStream ? audioStream->codecpar : nullptr;
+	}
+
+	AVRational VideoFileEncoder::getAudioTimeBase() const
+	{
+		return audioStream ? audioStream->time_base : AVRational{ 0, 1 };
+	}
+
+	int VideoFileEncoder::writeMuxedPacket(AVPacket * packet) noexcept
+	{
+		if (videoEncodeAttribute.lowLatency)
+		{
+			int ret = av_write_frame(outputFormatContext, packet);
+			av_write_frame(outputFormatContext, nullptr);
+			return ret;
+		}
+		if (videoEncodeAttribute.interleaveMaxBytes <= 0 || videoStream == nullptr || audioStream == nullptr)
+		{
+			return av_interleaved_write_frame(outputFormatContext, packet);
+		}
+
+		AVPacket* queuedPacket = av_packet_clone(packet);
+		if (queuedPacket == nullptr)
+		{
+			return AVERROR(ENOMEM);
+		}
+		const int queueIndex = packet->stream_index == videoStream->index ? 0 : 1;
+		interleaveQueues[queueIndex].push_back(queuedPacket);
+		interleaveQueueBytes += queuedPacket->size;
+		_interleaveStatistics.maxQueuedBytes = std::max(_interleaveStatistics.maxQueuedBytes, interleaveQueueBytes);
+		_interleaveStatistics.maxQueuedSeconds = std::max(_interleaveStatistics.maxQueuedSeconds, queuedSeconds(queueIndex));
+		return writeInterleavedPackets(false);
+	}
+
+	int VideoFileEncoder::writeInterleavedPackets(const bool isFlushing) noexcept
+	{
+		auto packetTime = [](const AVPacket* packet)
+		{
+			return packet->dts == AV_NOPTS_VALUE ? packet->pts : packet->dts;
+		};
+
+		int ret = 0;
+		while (true)
+		{
+			std::deque<AVPacket*>& videoQueue = interleaveQueues[0];
+			std::deque<AVPacket*>& audioQueue = interleaveQueues[1];
+			int queueIndex = -1;
+			if (videoQueue.empty() == false && audioQueue.empty() == false)
+			{
+				const int order = av_compare_ts(packetTime(videoQueue.front()), videoStream->time_base,
+					packetTime(audioQueue.front()), audioStream->time_base);
+				queueIndex = order <= 0 ? 0 : 1;
+			}
+			else if (videoQueue.empty() == false || audioQueue.empty() == false)
+			{
+				const int waitingIndex = videoQueue.empty() ? 1 : 0;
+				const bool isOverCap = interleaveQueueBytes > videoEncodeAttribute.interleaveMaxBytes
+					|| queuedSeconds(waitingIndex) > videoEncodeAttribute.interleaveMaxSeconds;
+				if (isFlushing || isOverCap)
+				{
+					queueIndex = waitingIndex;
+					if (isFlushing == false)
+					{
+						_interleaveStatistics.forcedWrites += 1;
+					}
+				}
+			}
+			if (queueIndex < 0)
+			{
+				break;
+			}
+
+			AVPacket* packet = interleaveQueues[queueIndex].front();
+			interleaveQueues[queueIndex].pop_front();
+			interleaveQueueBytes -= packet->size;
+			const int status = av_write_frame(outputFormatContext, packet);
+			av_packet_free(&packet);
+			if (status < 0)
+			{
+				ret = status;
+			}
+		}
+		return ret;
+	}
+
+	double VideoFileEncoder::queuedSeconds(const int queueIndex) const
+	{
+		const std::deque<AVPacket*>& queue = interleaveQueues[queueIndex];
+		if (queue.size() < 2)
+		{
+			return 0.0;
+		}
+		const AVStream* stream = queueIndex == 0 ? videoStream : audioStream;
+		const int64_t first = queue.front()->dts == AV_NOPTS_VALUE ? queue.front()->pts : queue.front()->dts;
+		const int64_t last = queue.back()->dts == AV_NOPTS_VALUE ? queue.back()->pts : queue.back()->dts;
+		return (last - first) * av_q2d(stream->time_base);
+	}
+
 	int VideoFileEncoder::encodeFrame(AVFrame * frame, AVCodecContext * codecContext, AVStream * steam) noexcept
 	{
 		int ret = 0;
@@ -292,11 +680,34 @@ namespace ks
 				assert(false);
 			}
 
+			const int64_t codecPts = pkt.pts;
 			av_packet_rescale_ts(&pkt, codecContext->time_base, steam->time_base);
 
 			pkt.stream_index = steam->index;
-			ret = av_interleaved_write_frame(outputFormatContext, &pkt);
+			if (packetHandler)
+			{
+				std::unique_ptr<MediaPacket> packet = std::unique_ptr<MediaPacket>(MediaPacket::New(&pkt, steam->time_base));
+				if (packet)
+				{
+					packetHandler(*packet, codecContext == videoCodecContext ? AVMEDIA_TYPE_VIDEO : AVMEDIA_TYPE_AUDIO);
+				}
+			}
+			ret = writeMuxedPacket(&pkt);
 			av_packet_unref(&pkt);
+
+			if (codecContext == videoCodecContext)
+			{
+				std::map<int64_t, int64_t>::iterator submitTime = videoFrameSubmitTimes.find(codecPts);
+				if (submitTime != videoFrameSubmitTimes.end())
+				{
+					const long long latency = av_gettime_relative() - submitTime->second;
+					videoFrameSubmitTimes.erase(submitTime);
+					_latencyStatistics.packets += 1;
+					_latencyStatistics.lastMicroseconds = latency;
+					_latencyStatistics.maxMicroseconds = std::max(_latencyStatistics.maxMicroseconds, latency);
+					_latencyStatistics.averageMicroseconds += (latency - _latencyStatistics.averageMicroseconds) / _latencyStatistics.packets;
+				}
+			}
 		}
 		return ret;
 	}
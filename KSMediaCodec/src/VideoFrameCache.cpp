@@ -0,0 +1,252 @@
+#include "VideoFrameCache.hpp"
+#include <assert.h>
+#include <vector>
+
+namespace ks
+{
+	VideoFrameCache * VideoFrameCache::New(const std::string & filePath,
+		const ks::PixelBuffer::FormatType & formatType,
+		const long long maxMemoryBytes,
+		const unsigned int prefetchFrameCount)
+	{
+		std::unique_ptr<VideoDecoder> decoder = std::unique_ptr<VideoDecoder>(VideoDecoder::New(filePath, formatType));
+		if (decoder == nullptr)
+		{
+			return nullptr;
+		}
+		std::unique_ptr<VideoDecoder> prefetchDecoder;
+		if (prefetchFrameCount > 0)
+		{
+			prefetchDecoder = std::unique_ptr<VideoDecoder>(VideoDecoder::New(filePath, formatType));
+			if (prefetchDecoder == nullptr)
+			{
+				return nullptr;
+			}
+		}
+
+		VideoFrameCache* cache = new VideoFrameCache();
+		const MediaTime fps = decoder->fps();
+		cache->frameDuration = fps.seconds() > 0.0 ? fps.invert() : MediaTime(1, 30);
+		cache->frameBytes = std::max(av_image_get_buffer_size(VideoDecoder::getAVPixelFormat(formatType), decoder->getWidth(), decoder->getHeight(), 1), 0);
+		cache->maxMemoryBytes = maxMemoryBytes;
+		cache->prefetchFrameCount = prefetchFrameCount;
+		cache->decoder = std::move(decoder);
+		cache->prefetchDecoder = std::move(prefetchDecoder);
+		if (cache->prefetchDecoder)
+		{
+			cache->prefetchThread = std::thread(&VideoFrameCache::prefetchLoop, cache);
+		}
+		return cache;
+	}
+
+	VideoFrameCache::~VideoFrameCache()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			isStopping = true;
+			prefetchGeneration += 1;
+		}
+		prefetchCondition.notify_all();
+		if (prefetchThread.joinable())
+		{
+			prefetchThread.join();
+		}
+	}
+
+	std::shared_ptr<const ks::PixelBuffer> VideoFrameCache::frameAt(const MediaTime & time, MediaTime & outPts)
+	{
+		std::shared_ptr<const ks::PixelBuffer> pixelBuffer = lookup(time, outPts);
+		if (pixelBuffer)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			_statistics.hits += 1;
+		}
+		else
+		{
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				_statistics.misses += 1;
+			}
+			std::lock_guard<std::mutex> decoderLock(decoderMutex);
+			pixelBuffer = std::shared_ptr<const ks::PixelBuffer>(decoder->newFrameAt(time, outPts));
+			if (pixelBuffer)
+			{
+				insert(outPts, pixelBuffer);
+			}
+		}
+
+		if (pixelBuffer && prefetchDecoder)
+		{
+			requestPrefetch(outPts);
+		}
+		return pixelBuffer;
+	}
+
+	void VideoFrameCache::clear()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		entries.clear();
+		recentlyUsed.clear();
+		memoryUsage = 0;
+		prefetchGeneration += 1;
+	}
+
+	VideoFrameCache::Statistics VideoFrameCache::statistics()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		Statistics statistics = _statistics;
+		statistics.frameCount = entries.size();
+		statistics.memoryUsage = memoryUsage;
+		return statistics;
+	}
+
+	std::shared_ptr<const ks::PixelBuffer> VideoFrameCache::lookup(const MediaTime & time, MediaTime & outPts)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		std::map<MediaTime, Entry>::iterator iter = entries.upper_bound(time);
+		if (iter == entries.begin())
+		{
+			return nullptr;
+		}
+		--iter;
+		if (time >= iter->second.endTime)
+		{
+			return nullptr;
+		}
+		recentlyUsed.splice(recentlyUsed.begin(), recentlyUsed, iter->second.recentlyUsedPosition);
+		outPts = iter->first;
+		return iter->second.pixelBuffer;
+	}
+
+	bool VideoFrameCache::contains(const MediaTime & time)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		std::map<MediaTime, Entry>::iterator iter = entries.upper_bound(time);
+		if (iter == entries.begin())
+		{
+			return false;
+		}
+		--iter;
+		return time < iter->second.endTime;
+	}
+
+	void VideoFrameCache::insert(const MediaTime & pts, std::shared_ptr<const ks::PixelBuffer> pixelBuffer)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (frameBytes > maxMemoryBytes || entries.find(pts) != entries.end())
+		{
+			return;
+		}
+
+		while (memoryUsage + frameBytes > maxMemoryBytes && recentlyUsed.empty() == false)
+		{
+			entries.erase(recentlyUsed.back());
+			recentlyUsed.pop_back();
+			memoryUsage -= frameBytes;
+			_statistics.evictions += 1;
+		}
+
+		Entry entry;
+		entry.pixelBuffer = pixelBuffer;
+		entry.endTime = pts + frameDuration;
+		std::map<MediaTime, Entry>::iterator next = entries.upper_bound(pts);
+		if (next != entries.end() && next->first < entry.endTime)
+		{
+			entry.endTime = next->first;
+		}
+		if (next != entries.begin())
+		{
+			std::map<MediaTime, Entry>::iterator previous = std::prev(next);
+			if (previous->second.endTime > pts)
+			{
+				previous->second.endTime = pts;
+			}
+		}
+		recentlyUsed.push_front(pts);
+		entry.recentlyUsedPosition = recentlyUsed.begin();
+		entries.emplace(pts, std::move(entry));
+		memoryUsage += frameBytes;
+	}
+
+	void VideoFrameCache::requestPrefetch(const MediaTime & anchor)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (hasLastRequest && anchor != lastRequestTime)
+			{
+				scrubDirection = anchor < lastRequestTime ? -1 : 1;
+			}
+			if (hasLastRequest && anchor == lastRequestTime)
+			{
+				return;
+			}
+			lastRequestTime = anchor;
+			hasLastRequest = true;
+			prefetchAnchor = anchor;
+			hasPrefetchRequest = true;
+			prefetchGeneration += 1;
+		}
+		prefetchCondition.notify_one();
+	}
+
+	void VideoFrameCache::prefetchLoop()
+	{
+		while (true)
+		{
+			MediaTime anchor;
+			int direction = 1;
+			unsigned long long generation = 0;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				prefetchCondition.wait(lock, [this]() { return isStopping || hasPrefetchRequest; });
+				if (isStopping)
+				{
+					return;
+				}
+				hasPrefetchRequest = false;
+				anchor = prefetchAnchor;
+				direction = scrubDirection;
+				generation = prefetchGeneration;
+			}
+
+			// Backwards scrubs decode the window in display order so the decoder seeks once instead of once per frame.
+			std::vector<MediaTime> times;
+			for (unsigned int index = 1; index <= prefetchFrameCount; index++)
+			{
+				const MediaTime offset = frameDuration * MediaTime((int)index, 1);
+				if (direction > 0)
+				{
+					times.push_back(anchor + offset);
+				}
+				else if (anchor - offset >= MediaTime::zero)
+				{
+					times.insert(times.begin(), anchor - offset);
+				}
+			}
+
+			for (const MediaTime& time : times)
+			{
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					if (generation != prefetchGeneration)
+					{
+						break;
+					}
+				}
+				if (contains(time))
+				{
+					continue;
+				}
+				MediaTime pts;
+				std::shared_ptr<const ks::PixelBuffer> pixelBuffer = std::shared_ptr<const ks::PixelBuffer>(prefetchDecoder->newFrameAt(time, pts));
+				if (pixelBuffer == nullptr)
+				{
+					break;
+				}
+				insert(pts, pixelBuffer);
+				std::lock_guard<std::mutex> lock(mutex);
+				_statistics.prefetchedFrames += 1;
+			}
+		}
+	}
+}
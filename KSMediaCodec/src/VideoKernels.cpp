@@ -0,0 +1,133 @@
+#include "VideoKernels.hpp"
+#include <string.h>
+#include <stdlib.h>
+#include "Simd.hpp"
+
+namespace ks
+{
+	uint64_t sumAbsoluteDifferences(const uint8_t * lhs, const int lhsStride, const uint8_t * rhs, const int rhsStride, const int width, const int height) noexcept
+	{
+		uint64_t sum = 0;
+		for (int y = 0; y < height; y++)
+		{
+			const uint8_t* lhsRow = lhs + (ptrdiff_t)y * lhsStride;
+			const uint8_t* rhsRow = rhs + (ptrdiff_t)y * rhsStride;
+			int x = 0;
+#if defined(KSMediaCodec_SIMD_SSE2)
+			__m128i rowSum = _mm_setzero_si128();
+			for (; x + 16 <= width; x += 16)
+			{
+				const __m128i lhsValue = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lhsRow + x));
+				const __m128i rhsValue = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rhsRow + x));
+				rowSum = _mm_add_epi64(rowSum, _mm_sad_epu8(lhsValue, rhsValue));
+			}
+			sum += (uint64_t)_mm_cvtsi128_si32(rowSum) + (uint64_t)_mm_cvtsi128_si32(_mm_srli_si128(rowSum, 8));
+#elif defined(KSMediaCodec_SIMD_NEON)
+			uint32x4_t rowSum = vdupq_n_u32(0);
+			for (; x + 16 <= width; x += 16)
+			{
+				const uint8x16_t difference = vabdq_u8(vld1q_u8(lhsRow + x), vld1q_u8(rhsRow + x));
+				rowSum = vpadalq_u16(rowSum, vpaddlq_u8(difference));
+			}
+			uint32_t lanes[4];
+			vst1q_u32(lanes, rowSum);
+			sum += (uint64_t)lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#endif
+			for (; x < width; x++)
+			{
+				sum += (uint64_t)abs((int)lhsRow[x] - (int)rhsRow[x]);
+			}
+		}
+		return sum;
+	}
+
+	void planeHistogram(const uint8_t * plane, const int stride, const int width, const int height, uint32_t outHistogram[256]) noexcept
+	{
+		// Four partial histograms break the store-to-load dependency on runs of equal values.
+		uint32_t partial[4][256];
+		memset(partial, 0, sizeof(partial));
+		for (int y = 0; y < height; y++)
+		{
+			const uint8_t* row = plane + (ptrdiff_t)y * stride;
+			int x = 0;
+			for (; x + 4 <= width; x += 4)
+			{
+				partial[0][row[x]] += 1;
+				partial[1][row[x + 1]] += 1;
+				partial[2][row[x + 2]] += 1;
+				partial[3][row[x + 3]] += 1;
+			}
+			for (; x < width; x++)
+			{
+				partial[0][row[x]] += 1;
+			}
+		}
+		for (int value = 0; value < 256; value++)
+		{
+			outHistogram[value] = partial[0][value] + partial[1][value] + partial[2][value] + partial[3][value];
+		}
+	}
+
+	void copyPlaneDecimated(const uint8_t * source, const int sourceStride, const int width, const int height, const int decimation,
+		uint8_t * target, const int targetStride) noexcept
+	{
+		if (decimation <= 1)
+		{
+			for (int y = 0; y < height; y++)
+			{
+				memcpy(target + (size_t)y * targetStride, source + (size_t)y * sourceStride, width);
+			}
+			return;
+		}
+
+		const int targetWidth = (width + decimation - 1) / decimation;
+		const int targetHeight = (height + decimation - 1) / decimation;
+		for (int y = 0; y < targetHeight; y++)
+		{
+			const uint8_t* row = source + (size_t)y * decimation * sourceStride;
+			uint8_t* targetRow = target + (size_t)y * targetStride;
+			int x = 0;
+#if defined(KSMediaCodec_SIMD_SSE2)
+			if (decimation == 2)
+			{
+				const __m128i mask = _mm_set1_epi16(0x00FF);
+				for (; x + 16 <= targetWidth && (x + 16) * 2 <= width; x += 16)
+				{
+					const __m128i low = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row + x * 2)), mask);
+					const __m128i high = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row + x * 2 + 16)), mask);
+					_mm_storeu_si128(reinterpret_cast<__m128i*>(targetRow + x), _mm_packus_epi16(low, high));
+				}
+			}
+			else if (decimation == 4)
+			{
+				const __m128i mask = _mm_set1_epi32(0x000000FF);
+				for (; x + 8 <= targetWidth && (x + 8) * 4 <= width; x += 8)
+				{
+					const __m128i low = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row + x * 4)), mask);
+					const __m128i high = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row + x * 4 + 16)), mask);
+					_mm_storel_epi64(reinterpret_cast<__m128i*>(targetRow + x), _mm_packus_epi16(_mm_packs_epi32(low, high), _mm_setzero_si128()));
+				}
+			}
+#elif defined(KSMediaCodec_SIMD_NEON)
+			if (decimation == 2)
+			{
+				for (; x + 16 <= targetWidth && (x + 16) * 2 <= width; x += 16)
+				{
+					vst1q_u8(targetRow + x, vld2q_u8(row + x * 2).val[0]);
+				}
+			}
+			else if (decimation == 4)
+			{
+				for (; x + 16 <= targetWidth && (x + 16) * 4 <= width; x += 16)
+				{
+					vst1q_u8(targetRow + x, vld4q_u8(row + x * 4).val[0]);
+				}
+			}
+#endif
+			for (; x < targetWidth; x++)
+			{
+				targetRow[x] = row[x * decimation];
+			}
+		}
+	}
+}
@@ -0,0 +1,27 @@
+#ifndef KSMediaCodec_VideoKernels_hpp
+#define KSMediaCodec_VideoKernels_hpp
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace ks
+{
+	/**
+	 * Sum of absolute differences of two 8-bit planes of width by height.
+	 */
+	uint64_t sumAbsoluteDifferences(const uint8_t* lhs, const int lhsStride, const uint8_t* rhs, const int rhsStride, const int width, const int height) noexcept;
+
+	/**
+	 * Counts the values of an 8-bit plane into outHistogram, which is cleared first.
+	 */
+	void planeHistogram(const uint8_t* plane, const int stride, const int width, const int height, uint32_t outHistogram[256]) noexcept;
+
+	/**
+	 * Copies every decimation-th pixel of every decimation-th row of an 8-bit plane of width by height,
+	 * producing a plane of ceil(width / decimation) by ceil(height / decimation). decimation is 1, 2 or 4.
+	 */
+	void copyPlaneDecimated(const uint8_t* source, const int sourceStride, const int width, const int height, const int decimation,
+		uint8_t* target, const int targetStride) noexcept;
+}
+
+#endif // KSMediaCodec_VideoKernels_hpp
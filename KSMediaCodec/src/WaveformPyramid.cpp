@@ -0,0 +1,425 @@
+#include "WaveformPyramid.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <filesystem>
+#include <assert.h>
+#include "AudioDecoder.hpp"
+#include "ThreadPool.hpp"
+#include "AudioKernels.hpp"
+
+namespace ks
+{
+	namespace
+	{
+		const char fileMagic[8] = { 'K', 'S', 'W', 'A', 'V', 'P', 'Y', 'R' };
+		const uint32_t fileVersion = 1;
+		const unsigned int binsPerBlock = 4096;
+
+		struct FileHeader
+		{
+			char magic[8];
+			uint32_t version;
+			uint32_t channels;
+			uint32_t sampleRate;
+			uint32_t samplesPerBin;
+			uint64_t sampleCount;
+			uint64_t sourceFileSize;
+			int64_t sourceModificationTime;
+			uint32_t levelCount;
+			uint32_t reserved;
+		};
+
+		struct LevelEntry
+		{
+			uint64_t binCount;
+			uint64_t offset;
+		};
+
+		struct Bin
+		{
+			float min;
+			float max;
+			float sumSquares;
+		};
+
+		const FileHeader& fileHeader(const unsigned char* bytes)
+		{
+			return *reinterpret_cast<const FileHeader*>(bytes);
+		}
+
+		const LevelEntry& levelEntry(const unsigned char* bytes, const unsigned int level)
+		{
+			return reinterpret_cast<const LevelEntry*>(bytes + sizeof(FileHeader))[level];
+		}
+
+		const Bin* levelBins(const unsigned char* bytes, const unsigned int level, const unsigned int channel)
+		{
+			const LevelEntry& entry = levelEntry(bytes, level);
+			return reinterpret_cast<const Bin*>(bytes + entry.offset) + entry.binCount * channel;
+		}
+
+		bool sourceFileStamp(const std::string& filePath, uint64_t& outFileSize, int64_t& outModificationTime)
+		{
+			std::error_code errorCode;
+			const std::filesystem::path path = std::filesystem::u8path(filePath);
+			outFileSize = std::filesystem::file_size(path, errorCode);
+			if (errorCode)
+			{
+				return false;
+			}
+			outModificationTime = std::filesystem::last_write_time(path, errorCode).time_since_epoch().count();
+			return !errorCode;
+		}
+
+		/**
+		 * Whether the coarsest level's bin size, samplesPerBin << (levelCount - 1), fits in a long long.
+		 */
+		bool isBinSizeRepresentable(const uint32_t samplesPerBin, const uint32_t levelCount)
+		{
+			unsigned int bits = 0;
+			while ((samplesPerBin >> bits) > 1)
+			{
+				bits++;
+			}
+			return bits + levelCount - 1 < 63;
+		}
+
+		Bin mergeBins(const Bin& lhs, const Bin& rhs)
+		{
+			return Bin{ std::min(lhs.min, rhs.min), std::max(lhs.max, rhs.max), lhs.sumSquares + rhs.sumSquares };
+		}
+	}
+
+	WaveformPyramid * WaveformPyramid::New(const std::string & filePath,
+		const unsigned int sampleRate,
+		const unsigned int channels,
+		const unsigned int samplesPerBin,
+		const unsigned int threadCount)
+	{
+		if (sampleRate == 0 || channels == 0 || samplesPerBin == 0 || (samplesPerBin & (samplesPerBin - 1)) != 0)
+		{
+			return nullptr;
+		}
+
+		ks::AudioFormat format;
+		format.bitsPerChannel = 32;
+		format.bytesPerFrame = 4;
+		format.bytesPerPacket = 4;
+		format.formatFlags = ks::AudioFormatFlag::isFloat | ks::AudioFormatFlag::isNonInterleaved;
+		format.formatType = ks::AudioFormatIdentifiersType::pcm;
+		format.sampleRate = sampleRate;
+		format.framesPerPacket = 1;
+		format.channelsPerFrame = channels;
+
+		std::unique_ptr<AudioDecoder> decoder = std::unique_ptr<AudioDecoder>(AudioDecoder::New(filePath, format));
+		if (decoder == nullptr)
+		{
+			return nullptr;
+		}
+
+		ThreadPool threadPool(threadCount);
+		const unsigned int tasksPerChannel = std::max(threadPool.threadCount() / channels, 1u);
+		const int blockSamples = (int)(samplesPerBin * binsPerBlock);
+		ks::AudioPCMBuffer pcmBuffer(format, blockSamples);
+		std::vector<std::vector<Bin>> levels0(channels);
+		long long sampleCount = 0;
+
+		while (true)
+		{
+			const MediaTimeRange timeRange = MediaTimeRange(MediaTime((int)sampleCount, (int)sampleRate),
+				MediaTime((int)(sampleCount + blockSamples), (int)sampleRate));
+			const int readSamples = decoder->readSamples(timeRange, pcmBuffer);
+			if (readSamples <= 0)
+			{
+				break;
+			}
+
+			const size_t blockBins = (readSamples + samplesPerBin - 1) / samplesPerBin;
+			const size_t firstBin = levels0[0].size();
+			const size_t binsPerTask = (blockBins + tasksPerChannel - 1) / tasksPerChannel;
+			std::vector<std::future<void>> tasks;
+			for (unsigned int channel = 0; channel < channels; channel++)
+			{
+				levels0[channel].resize(firstBin + blockBins);
+				const float* samples = reinterpret_cast<const float*>(pcmBuffer.channelData()[channel]);
+				Bin* bins = levels0[channel].data() + firstBin;
+				for (size_t taskBin = 0; taskBin < blockBins; taskBin += binsPerTask)
+				{
+					const size_t taskEndBin = std::min(taskBin + binsPerTask, blockBins);
+					tasks.push_back(threadPool.submit([=]()
+					{
+						for (size_t bin = taskBin; bin < taskEndBin; bin++)
+						{
+							const size_t start = bin * samplesPerBin;
+							const size_t count = std::min<size_t>(samplesPerBin, readSamples - start);
+							reduceSamplePeaks(samples + start, count, bins[bin].min, bins[bin].max, bins[bin].sumSquares);
+						}
+					}));
+				}
+			}
+			for (std::future<void>& task : tasks)
+			{
+				task.wait();
+			}
+
+			sampleCount += readSamples;
+			if (readSamples < blockSamples)
+			{
+				break;
+			}
+		}
+
+		if (sampleCount == 0)
+		{
+			return nullptr;
+		}
+
+		std::vector<uint64_t> binCounts = { levels0[0].size() };
+		while (binCounts.back() > 1)
+		{
+			binCounts.push_back((binCounts.back() + 1) / 2);
+		}
+
+		size_t byteCount = sizeof(FileHeader) + sizeof(LevelEntry) * binCounts.size();
+		std::vector<LevelEntry> levelEntries;
+		for (const uint64_t binCount : binCounts)
+		{
+			levelEntries.push_back(LevelEntry{ binCount, byteCount });
+			byteCount += (size_t)binCount * channels * sizeof(Bin);
+		}
+
+		std::vector<unsigned char> storage(byteCount);
+		FileHeader header;
+		memset(&header, 0, sizeof(header));
+		memcpy(header.magic, fileMagic, sizeof(fileMagic));
+		header.version = fileVersion;
+		header.channels = channels;
+		header.sampleRate = sampleRate;
+		header.samplesPerBin = samplesPerBin;
+		header.sampleCount = sampleCount;
+		header.levelCount = (uint32_t)binCounts.size();
+		sourceFileStamp(filePath, header.sourceFileSize, header.sourceModificationTime);
+		memcpy(storage.data(), &header, sizeof(header));
+		memcpy(storage.data() + sizeof(FileHeader), levelEntries.data(), sizeof(LevelEntry) * levelEntries.size());
+
+		std::vector<std::future<void>> tasks;
+		for (unsigned int channel = 0; channel < channels; channel++)
+		{
+			tasks.push_back(threadPool.submit([&storage, &levels0, &levelEntries, channel]()
+			{
+				const LevelEntry& finestEntry = levelEntries[0];
+				Bin* finestBins = reinterpret_cast<Bin*>(storage.data() + finestEntry.offset) + finestEntry.binCount * channel;
+				std::copy(levels0[channel].begin(), levels0[channel].end(), finestBins);
+				for (size_t level = 1; level < levelEntries.size(); level++)
+				{
+					const LevelEntry& sourceEntry = levelEntries[level - 1];
+					const LevelEntry& entry = levelEntries[level];
+					const Bin* sourceBins = reinterpret_cast<const Bin*>(storage.data() + sourceEntry.offset) + sourceEntry.binCount * channel;
+					Bin* bins = reinterpret_cast<Bin*>(storage.data() + entry.offset) + entry.binCount * channel;
+					for (uint64_t bin = 0; bin < entry.binCount; bin++)
+					{
+						const uint64_t sourceBin = bin * 2;
+						bins[bin] = sourceBin + 1 < sourceEntry.binCount
+							? mergeBins(sourceBins[sourceBin], sourceBins[sourceBin + 1])
+							: sourceBins[sourceBin];
+					}
+				}
+			}));
+		}
+		for (std::future<void>& task : tasks)
+		{
+			task.wait();
+		}
+
+		WaveformPyramid* pyramid = new WaveformPyramid();
+		pyramid->storage = std::move(storage);
+		pyramid->bytes = pyramid->storage.data();
+		pyramid->byteCount = pyramid->storage.size();
+		return pyramid;
+	}
+
+	WaveformPyramid * WaveformPyramid::Open(const std::string & cachePath)
+	{
+		std::unique_ptr<MappedFile> mappedFile = std::unique_ptr<MappedFile>(MappedFile::Open(cachePath));
+		if (mappedFile == nullptr || mappedFile->size() < sizeof(FileHeader))
+		{
+			return nullptr;
+		}
+		const unsigned char* bytes = mappedFile->data();
+		const FileHeader& header = fileHeader(bytes);
+		if (memcmp(header.magic, fileMagic, sizeof(fileMagic)) != 0
+			|| header.version != fileVersion
+			|| header.channels == 0
+			|| header.sampleRate == 0
+			|| header.samplesPerBin == 0
+			|| (header.samplesPerBin & (header.samplesPerBin - 1)) != 0
+			|| header.sampleCount == 0
+			|| header.levelCount == 0
+			|| isBinSizeRepresentable(header.samplesPerBin, header.levelCount) == false
+			|| header.levelCount > (mappedFile->size() - sizeof(FileHeader)) / sizeof(LevelEntry))
+		{
+			return nullptr;
+		}
+		// The level sizes follow from sampleCount exactly as New lays them out; sizes are checked by division so they cannot wrap.
+		const uint64_t channelBytes = (uint64_t)header.channels * sizeof(Bin);
+		uint64_t expectedBinCount = header.sampleCount / header.samplesPerBin + (header.sampleCount % header.samplesPerBin != 0 ? 1 : 0);
+		for (unsigned int level = 0; level < header.levelCount; level++)
+		{
+			const LevelEntry& entry = levelEntry(bytes, level);
+			if (entry.binCount != expectedBinCount
+				|| entry.offset > mappedFile->size()
+				|| entry.binCount > (mappedFile->size() - entry.offset) / channelBytes)
+			{
+				return nullptr;
+			}
+			expectedBinCount = (expectedBinCount + 1) / 2;
+		}
+
+		WaveformPyramid* pyramid = new WaveformPyramid();
+		pyramid->bytes = bytes;
+		pyramid->byteCount = mappedFile->size();
+		pyramid->mappedFile = std::move(mappedFile);
+		return pyramid;
+	}
+
+	WaveformPyramid * WaveformPyramid::NewCached(const std::string & filePath,
+		const std::string & cachePath,
+		const unsigned int sampleRate,
+		const unsigned int channels,
+		const unsigned int samplesPerBin,
+		const unsigned int threadCount)
+	{
+		if (WaveformPyramid* pyramid = Open(cachePath))
+		{
+			const FileHeader& header = fileHeader(pyramid->bytes);
+			uint64_t sourceFileSize = 0;
+			int64_t sourceModificationTime = 0;
+			if (sourceFileStamp(filePath, sourceFileSize, sourceModificationTime)
+				&& header.sourceFileSize == sourceFileSize
+				&& header.sourceModificationTime == sourceModificationTime
+				&& header.sampleRate == sampleRate
+				&& header.channels == channels
+				&& header.samplesPerBin == samplesPerBin)
+			{
+				return pyramid;
+			}
+			delete pyramid;
+		}
+
+		WaveformPyramid* pyramid = New(filePath, sampleRate, channels, samplesPerBin, threadCount);
+		if (pyramid)
+		{
+			pyramid->save(cachePath);
+		}
+		return pyramid;
+	}
+
+	WaveformPyramid::~WaveformPyramid()
+	{
+	}
+
+	bool WaveformPyramid::save(const std::string & cachePath) const
+	{
+		assert(bytes);
+		const std::string temporaryPath = cachePath + ".tmp";
+		{
+			std::ofstream stream(std::filesystem::u8path(temporaryPath), std::ios::binary | std::ios::trunc);
+			if (stream.is_open() == false)
+			{
+				return false;
+			}
+			stream.write(reinterpret_cast<const char*>(bytes), byteCount);
+			if (stream.good() == false)
+			{
+				return false;
+			}
+		}
+		std::error_code errorCode;
+		std::filesystem::rename(std::filesystem::u8path(temporaryPath), std::filesystem::u8path(cachePath), errorCode);
+		if (errorCode)
+		{
+			std::filesystem::remove(std::filesystem::u8path(temporaryPath), errorCode);
+			return false;
+		}
+		return true;
+	}
+
+	unsigned int WaveformPyramid::getSampleRate() const
+	{
+		return fileHeader(bytes).sampleRate;
+	}
+
+	unsigned int WaveformPyramid::channelCount() const
+	{
+		return fileHeader(bytes).channels;
+	}
+
+	long long WaveformPyramid::sampleCount() const
+	{
+		return (long long)fileHeader(bytes).sampleCount;
+	}
+
+	unsigned int WaveformPyramid::getSamplesPerBin() const
+	{
+		return fileHeader(bytes).samplesPerBin;
+	}
+
+	unsigned int WaveformPyramid::levelCount() const
+	{
+		return fileHeader(bytes).levelCount;
+	}
+
+	void WaveformPyramid::peaks(const unsigned int channel,
+		const long long startSample,
+		const long long endSample,
+		const unsigned int pixelCount,
+		std::vector<Peak>& outPeaks) const
+	{
+		outPeaks.assign(pixelCount, Peak());
+		const FileHeader& header = fileHeader(bytes);
+		const long long start = std::max(startSample, 0LL);
+		const long long end = std::min(endSample, (long long)header.sampleCount);
+		if (channel >= header.channels || pixelCount == 0 || end <= start)
+		{
+			return;
+		}
+
+		const double samplesPerPixel = double(endSample - startSample) / pixelCount;
+		unsigned int level = 0;
+		while (level + 1 < header.levelCount && double((long long)header.samplesPerBin << (level + 1)) <= samplesPerPixel)
+		{
+			level++;
+		}
+		const long long binSize = (long long)header.samplesPerBin << level;
+		const long long binCount = (long long)levelEntry(bytes, level).binCount;
+		const Bin* bins = levelBins(bytes, level, channel);
+
+		for (unsigned int pixel = 0; pixel < pixelCount; pixel++)
+		{
+			const long long pixelStart = startSample + (long long)(pixel * samplesPerPixel);
+			const long long pixelEnd = std::max(startSample + (long long)((pixel + 1) * samplesPerPixel), pixelStart + 1);
+			if (pixelEnd <= start || pixelStart >= end)
+			{
+				continue;
+			}
+			const long long firstBin = std::max(pixelStart, start) / binSize;
+			if (firstBin >= binCount)
+			{
+				continue;
+			}
+			const long long lastBin = std::min((std::min(pixelEnd, end) + binSize - 1) / binSize, binCount);
+			Bin bin = bins[firstBin];
+			for (long long index = firstBin + 1; index < lastBin; index++)
+			{
+				bin = mergeBins(bin, bins[index]);
+			}
+			const long long coveredSamples = std::min(lastBin * binSize, (long long)header.sampleCount) - firstBin * binSize;
+			Peak& peak = outPeaks[pixel];
+			peak.min = bin.min;
+			peak.max = bin.max;
+			peak.rms = coveredSamples > 0 ? std::sqrt(bin.sumSquares / coveredSamples) : 0.0f;
+		}
+	}
+}
@@ -0,0 +1,135 @@
+#include "WorkStealingPool.hpp"
+#include "ThreadPool.hpp"
+
+namespace ks
+{
+	namespace
+	{
+		thread_local const WorkStealingPool* currentPool = nullptr;
+		thread_local size_t currentWorkerIndex = 0;
+	}
+
+	WorkStealingPool::WorkStealingPool(const unsigned int threadCount)
+	{
+		const unsigned int count = threadCount == 0 ? ThreadPool::defaultThreadCount() : threadCount;
+		workers.reserve(count);
+		for (unsigned int i = 0; i < count; i++)
+		{
+			workers.push_back(std::make_unique<Worker>());
+		}
+		threads.reserve(count);
+		for (unsigned int i = 0; i < count; i++)
+		{
+			threads.emplace_back([this, i]()
+			{
+				workerLoop(i);
+			});
+		}
+	}
+
+	WorkStealingPool::~WorkStealingPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			isStopping = true;
+		}
+		condition.notify_all();
+		for (std::thread& thread : threads)
+		{
+			thread.join();
+		}
+	}
+
+	void WorkStealingPool::post(std::function<void()> task)
+	{
+		// Counted before it is visible, so a thief can never decrement the count below zero.
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			queuedTaskCount++;
+			if (currentPool != this)
+			{
+				sharedTasks.push_back(std::move(task));
+			}
+		}
+		if (currentPool == this)
+		{
+			Worker& worker = *workers[currentWorkerIndex];
+			std::lock_guard<std::mutex> lock(worker.mutex);
+			worker.tasks.push_back(std::move(task));
+		}
+		condition.notify_one();
+	}
+
+	unsigned int WorkStealingPool::threadCount() const
+	{
+		return (unsigned int)threads.size();
+	}
+
+	bool WorkStealingPool::takeTask(const size_t workerIndex, std::function<void()>& outTask)
+	{
+		{
+			Worker& worker = *workers[workerIndex];
+			std::lock_guard<std::mutex> lock(worker.mutex);
+			if (worker.tasks.empty() == false)
+			{
+				outTask = std::move(worker.tasks.back());
+				worker.tasks.pop_back();
+				return true;
+			}
+		}
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (sharedTasks.empty() == false)
+			{
+				outTask = std::move(sharedTasks.front());
+				sharedTasks.pop_front();
+				return true;
+			}
+		}
+		for (size_t i = 1; i < workers.size(); i++)
+		{
+			Worker& victim = *workers[(workerIndex + i) % workers.size()];
+			std::lock_guard<std::mutex> lock(victim.mutex);
+			if (victim.tasks.empty() == false)
+			{
+				outTask = std::move(victim.tasks.front());
+				victim.tasks.pop_front();
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void WorkStealingPool::workerLoop(const size_t workerIndex)
+	{
+		currentPool = this;
+		currentWorkerIndex = workerIndex;
+		while (true)
+		{
+			std::function<void()> task;
+			if (takeTask(workerIndex, task))
+			{
+				queuedTaskCount--;
+				task();
+				continue;
+			}
+
+			std::unique_lock<std::mutex> lock(mutex);
+			if (queuedTaskCount > 0)
+			{
+				// A task is being pushed or taken elsewhere; look again rather than sleep.
+				lock.unlock();
+				std::this_thread::yield();
+				continue;
+			}
+			if (isStopping)
+			{
+				return;
+			}
+			condition.wait(lock, [this]()
+			{
+				return isStopping || queuedTaskCount > 0;
+			});
+		}
+	}
+}
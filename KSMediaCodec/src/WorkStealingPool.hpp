@@ -0,0 +1,51 @@
+#ifndef KSMediaCodec_WorkStealingPool_hpp
+#define KSMediaCodec_WorkStealingPool_hpp
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <condition_variable>
+#include <functional>
+#include <Foundation/Foundation.hpp>
+
+namespace ks
+{
+	/**
+	 * Thread pool with one task deque per worker. Tasks posted from a worker go to the back of its own
+	 * deque and are taken newest first; idle workers steal the oldest task from the others. Tasks posted
+	 * from other threads go to a shared queue. The destructor runs every queued task before joining.
+	 */
+	class WorkStealingPool : public noncopyable
+	{
+	public:
+		explicit WorkStealingPool(const unsigned int threadCount = 0);
+		~WorkStealingPool();
+
+		void post(std::function<void()> task);
+		unsigned int threadCount() const;
+
+	private:
+		struct Worker
+		{
+			std::mutex mutex;
+			std::deque<std::function<void()>> tasks;
+		};
+
+		std::vector<std::unique_ptr<Worker>> workers;
+		std::vector<std::thread> threads;
+		std::mutex mutex;
+		std::condition_variable condition;
+		std::deque<std::function<void()>> sharedTasks;
+		std::atomic<size_t> queuedTaskCount{ 0 };
+		bool isStopping = false;
+
+	private:
+		bool takeTask(const size_t workerIndex, std::function<void()>& outTask);
+		void workerLoop(const size_t workerIndex);
+	};
+}
+
+#endif // KSMediaCodec_WorkStealingPool_hpp
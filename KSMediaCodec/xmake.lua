@@ -32,9 +32,19 @@ rule("KSMediaCodec.deps")
         os.cd(previous)
     end)
 
+option("coroutine")
+    set_default(false)
+    set_showmenu(true)
+    set_description("Build the C++20 coroutine API (AsyncExecutor, AsyncVideoDecoder, AsyncVideoFileEncoder); consumers must build as C++20 to use it")
+
 target("KSMediaCodec")
     set_kind("$(kind)")
-    set_languages("c++17")
+    if has_config("coroutine") then
+        set_languages("c++20")
+        add_defines("KSMediaCodec_ENABLE_COROUTINE", {public = true})
+    else
+        set_languages("c++17")
+    end
     add_files("src/**.cpp")
     add_headerfiles("include/**.hpp", "include/**.h")
     add_includedirs("include/KSMediaCodec")